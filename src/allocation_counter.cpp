@@ -0,0 +1,34 @@
+#include "allocation_counter.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+static thread_local uint32_t counter_depth = 0;
+static thread_local size_t allocation_count = 0;
+
+void *operator new(std::size_t size)
+{
+    if (counter_depth > 0)
+        allocation_count++;
+    if (void *ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+FR_NAMESPACE_BEGIN
+
+AllocationCounter::AllocationCounter() : m_start(allocation_count) { counter_depth++; }
+
+AllocationCounter::~AllocationCounter() { counter_depth--; }
+
+size_t AllocationCounter::count() const { return allocation_count - m_start; }
+
+FR_NAMESPACE_END
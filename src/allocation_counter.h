@@ -0,0 +1,32 @@
+#pragma once
+
+#include "core/defs.h"
+
+#include <cstddef>
+
+FR_NAMESPACE_BEGIN
+
+/**
+ * Counter of the heap allocations (global operator new) of the calling thread.
+ *
+ * Only linked into fotorite_allocation_tests, which replaces the global allocation functions in
+ * allocation_counter.cpp. Keeping the replacement out of the other binaries and out of the translation units
+ * that allocate avoids mismatched new/delete diagnostics when the replaced functions get inlined.
+ */
+class AllocationCounter {
+public:
+    /// Start counting, allocations of other threads are never counted.
+    AllocationCounter();
+    ~AllocationCounter();
+
+    /// Number of allocations since construction.
+    size_t count() const;
+
+private:
+    AllocationCounter(const AllocationCounter &) = delete;
+    AllocationCounter &operator=(const AllocationCounter &) = delete;
+
+    size_t m_start;
+};
+
+FR_NAMESPACE_END
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "defs.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+FR_NAMESPACE_BEGIN
+
+/**
+ * Linear allocator for scratch memory that is released all at once.
+ *
+ * Allocations bump an offset into the current block and a new block is allocated when it is full. reset() frees all
+ * allocations and merges the blocks into a single one of their combined size, so an arena that is reset regularly
+ * (e.g. per submission) stops allocating once it has grown to its peak usage. Not thread-safe.
+ */
+class Arena {
+public:
+    Arena() = default;
+    explicit Arena(size_t block_size) : m_block_size(block_size) {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    Arena(Arena &&) = default;
+    Arena &operator=(Arena &&) = default;
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        if (!m_blocks.empty()) {
+            Block &block = m_blocks.back();
+            const uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            const size_t offset = ((base + m_offset + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+            if (offset + size <= block.size) {
+                m_offset = offset + size;
+                return block.data.get() + offset;
+            }
+        }
+
+        // new blocks are aligned for max_align_t, larger alignments are padded
+        const size_t padding = alignment > alignof(std::max_align_t) ? alignment : 0;
+        add_block(std::max(m_block_size, size + padding));
+        return allocate(size, alignment);
+    }
+
+    /// Uninitialized storage for count objects of a trivially destructible type.
+    template <typename T>
+    T *allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    /// Free all allocations.
+    void reset()
+    {
+        if (m_blocks.size() > 1) {
+            size_t size = 0;
+            for (const Block &block : m_blocks)
+                size += block.size;
+            m_blocks.clear();
+            add_block(size);
+        }
+        m_offset = 0;
+    }
+
+    /// Total size of the blocks.
+    size_t capacity() const
+    {
+        size_t size = 0;
+        for (const Block &block : m_blocks)
+            size += block.size;
+        return size;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    void add_block(size_t size)
+    {
+        m_blocks.push_back({std::unique_ptr<std::byte[]>(new std::byte[size]), size});
+        m_offset = 0;
+    }
+
+    size_t m_block_size{64 * 1024};  ///< Minimum size of new blocks.
+    std::vector<Block> m_blocks;
+    size_t m_offset{0};  ///< Offset of the first free byte in the last block.
+};
+
+FR_NAMESPACE_END
@@ -0,0 +1,47 @@
+#include "arena.h"
+
+#include <doctest/doctest.h>
+
+#include <cstdint>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("arena");
+
+TEST_CASE("Arena")
+{
+    Arena arena(1024);
+    CHECK_EQ(arena.capacity(), 0);
+
+    SUBCASE("alignment")
+    {
+        arena.allocate(1, 1);
+        void *a = arena.allocate(8, 8);
+        void *b = arena.allocate(16, 256);
+        CHECK_EQ(reinterpret_cast<uintptr_t>(a) % 8, 0);
+        CHECK_EQ(reinterpret_cast<uintptr_t>(b) % 256, 0);
+        uint64_t *c = arena.allocate<uint64_t>(4);
+        CHECK_EQ(reinterpret_cast<uintptr_t>(c) % alignof(uint64_t), 0);
+        CHECK_EQ(arena.capacity(), 1024);
+    }
+
+    SUBCASE("reset merges blocks")
+    {
+        // more than a block, and an allocation larger than the block size
+        for (int i = 0; i < 10; ++i)
+            arena.allocate(256);
+        arena.allocate(4096);
+        const size_t capacity = arena.capacity();
+        CHECK_GT(capacity, 1024);
+
+        // the same allocations fit in the merged block
+        arena.reset();
+        CHECK_EQ(arena.capacity(), capacity);
+        for (int i = 0; i < 10; ++i)
+            arena.allocate(256);
+        arena.allocate(4096);
+        CHECK_EQ(arena.capacity(), capacity);
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,110 @@
+#include "buddy_allocator.h"
+
+#include <algorithm>
+#include <bit>
+
+FR_NAMESPACE_BEGIN
+
+BuddyAllocator::BuddyAllocator(size_t size, size_t min_block_size)
+{
+    FR_ASSERT(std::has_single_bit(min_block_size));
+    FR_ASSERT(size >= min_block_size);
+
+    m_min_block_size = min_block_size;
+    m_min_block_shift = uint32_t(std::countr_zero(min_block_size));
+    m_size = std::bit_floor(size / min_block_size) * min_block_size;
+    m_max_order = uint32_t(std::countr_zero(m_size >> m_min_block_shift));
+
+    const size_t block_count = m_size >> m_min_block_shift;
+    m_free_lists.resize(m_max_order + 1);
+    m_free_order.assign(block_count, 0);
+    m_allocated_order.assign(block_count, 0);
+
+    m_free_lists[m_max_order].insert(0);
+    m_free_order[0] = uint8_t(m_max_order + 1);
+}
+
+uint32_t BuddyAllocator::order_for_size(size_t size) const
+{
+    size_t blocks = (std::max(size, size_t(1)) + m_min_block_size - 1) >> m_min_block_shift;
+    return uint32_t(std::countr_zero(std::bit_ceil(blocks)));
+}
+
+size_t BuddyAllocator::allocate(size_t size, size_t alignment)
+{
+    FR_ASSERT(alignment == 0 || std::has_single_bit(alignment));
+    if (size == 0 || size > m_size || alignment > m_size)
+        return INVALID_OFFSET;
+
+    // Blocks are aligned to their size, so alignment just raises the minimum block size.
+    const uint32_t order = order_for_size(std::max(size, alignment));
+
+    uint32_t free_order = order;
+    while (free_order <= m_max_order && m_free_lists[free_order].empty())
+        ++free_order;
+    if (free_order > m_max_order)
+        return INVALID_OFFSET;
+
+    auto it = m_free_lists[free_order].begin();
+    size_t block = *it;
+    m_free_lists[free_order].erase(it);
+    m_free_order[block] = 0;
+
+    // Split down to the requested order, keeping the lower half.
+    while (free_order > order) {
+        --free_order;
+        size_t buddy = block + (size_t(1) << free_order);
+        m_free_lists[free_order].insert(buddy);
+        m_free_order[buddy] = uint8_t(free_order + 1);
+    }
+
+    m_allocated_order[block] = uint8_t(order + 1);
+    m_used_bytes += m_min_block_size << order;
+    m_allocation_count++;
+
+    return block << m_min_block_shift;
+}
+
+void BuddyAllocator::free(size_t offset)
+{
+    size_t block = offset >> m_min_block_shift;
+    FR_ASSERT((offset & (m_min_block_size - 1)) == 0 && block < m_allocated_order.size());
+    FR_ASSERT(m_allocated_order[block] != 0);
+
+    uint32_t order = m_allocated_order[block] - 1u;
+    m_allocated_order[block] = 0;
+    m_used_bytes -= m_min_block_size << order;
+    m_allocation_count--;
+
+    // Merge with free buddies.
+    while (order < m_max_order) {
+        size_t buddy = block ^ (size_t(1) << order);
+        if (m_free_order[buddy] != order + 1)
+            break;
+        m_free_lists[order].erase(buddy);
+        m_free_order[buddy] = 0;
+        block = std::min(block, buddy);
+        ++order;
+    }
+
+    m_free_lists[order].insert(block);
+    m_free_order[block] = uint8_t(order + 1);
+}
+
+size_t BuddyAllocator::block_size(size_t offset) const
+{
+    size_t block = offset >> m_min_block_shift;
+    FR_ASSERT(block < m_allocated_order.size() && m_allocated_order[block] != 0);
+    return m_min_block_size << (m_allocated_order[block] - 1u);
+}
+
+size_t BuddyAllocator::largest_free_block() const
+{
+    for (uint32_t order = m_max_order + 1; order-- > 0;) {
+        if (!m_free_lists[order].empty())
+            return m_min_block_size << order;
+    }
+    return 0;
+}
+
+FR_NAMESPACE_END
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "defs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+FR_NAMESPACE_BEGIN
+
+/**
+ * Buddy allocator for sub-allocating ranges of a larger memory block.
+ *
+ * Only manages offsets, the memory itself is owned by the caller (e.g. a VkDeviceMemory).
+ * Blocks are powers of two in size and naturally aligned, so any power of two alignment
+ * up to the block size is satisfied. Free neighbouring buddies are merged on free().
+ */
+class BuddyAllocator {
+public:
+    static constexpr size_t INVALID_OFFSET = ~size_t(0);
+
+    /**
+     * Constructor.
+     * @param size Size of the managed range, rounded down to a power of two multiple of min_block_size.
+     * @param min_block_size Smallest block size (power of two).
+     */
+    BuddyAllocator(size_t size, size_t min_block_size = 256);
+
+    /**
+     * Allocate a range.
+     * @param size Size in bytes.
+     * @param alignment Required alignment (power of two).
+     * @return Offset of the range or INVALID_OFFSET if there is no free block large enough.
+     */
+    size_t allocate(size_t size, size_t alignment = 1);
+
+    /// Free a range returned by allocate().
+    void free(size_t offset);
+
+    /// Size of the block that backs an allocation.
+    size_t block_size(size_t offset) const;
+
+    size_t size() const { return m_size; }
+    size_t min_block_size() const { return m_min_block_size; }
+
+    /// Number of bytes in allocated blocks (including internal fragmentation).
+    size_t used_bytes() const { return m_used_bytes; }
+    size_t free_bytes() const { return m_size - m_used_bytes; }
+    size_t allocation_count() const { return m_allocation_count; }
+    bool empty() const { return m_allocation_count == 0; }
+
+    /// Size of the largest free block, i.e. the largest allocation that will currently succeed.
+    size_t largest_free_block() const;
+
+private:
+    uint32_t order_for_size(size_t size) const;
+
+    size_t m_size;
+    size_t m_min_block_size;
+    uint32_t m_min_block_shift;
+    uint32_t m_max_order;
+
+    // Free blocks per order (block size = min_block_size << order), as offsets in min blocks.
+    // Sorted sets prefer low addresses which keeps the upper part of the range free.
+    std::vector<std::set<size_t>> m_free_lists;
+    // Per min block: order + 1 of a free block starting there, 0 otherwise.
+    std::vector<uint8_t> m_free_order;
+    // Per min block: order + 1 of an allocated block starting there, 0 otherwise.
+    std::vector<uint8_t> m_allocated_order;
+
+    size_t m_used_bytes{0};
+    size_t m_allocation_count{0};
+};
+
+FR_NAMESPACE_END
@@ -0,0 +1,102 @@
+#include "buddy_allocator.h"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("buddy_allocator");
+
+TEST_CASE("BuddyAllocator")
+{
+    SUBCASE("allocate and merge")
+    {
+        BuddyAllocator allocator(1024, 64);
+        CHECK_EQ(allocator.size(), 1024);
+        CHECK_EQ(allocator.largest_free_block(), 1024);
+
+        size_t a = allocator.allocate(100);
+        size_t b = allocator.allocate(64);
+        size_t c = allocator.allocate(64);
+        CHECK_EQ(a, 0);
+        CHECK_EQ(allocator.block_size(a), 128);
+        CHECK_EQ(b, 128);
+        CHECK_EQ(c, 192);
+        CHECK_EQ(allocator.used_bytes(), 256);
+        CHECK_EQ(allocator.allocation_count(), 3);
+        CHECK_EQ(allocator.largest_free_block(), 512);
+
+        allocator.free(b);
+        allocator.free(a);
+        CHECK_EQ(allocator.largest_free_block(), 512);
+        allocator.free(c);
+        CHECK(allocator.empty());
+        CHECK_EQ(allocator.used_bytes(), 0);
+        CHECK_EQ(allocator.largest_free_block(), 1024);
+    }
+
+    SUBCASE("alignment")
+    {
+        BuddyAllocator allocator(4096, 64);
+        size_t a = allocator.allocate(64);
+        size_t b = allocator.allocate(64, 1024);
+        CHECK_EQ(a, 0);
+        CHECK_EQ(b % 1024, 0);
+        CHECK_NE(b, 0);
+        CHECK_EQ(allocator.allocate(64, 8192), BuddyAllocator::INVALID_OFFSET);
+    }
+
+    SUBCASE("out of memory")
+    {
+        BuddyAllocator allocator(1000, 64);
+        CHECK_EQ(allocator.size(), 512);
+        CHECK_EQ(allocator.allocate(513), BuddyAllocator::INVALID_OFFSET);
+        CHECK_EQ(allocator.allocate(0), BuddyAllocator::INVALID_OFFSET);
+        CHECK_EQ(allocator.allocate(512), 0);
+        CHECK_EQ(allocator.allocate(1), BuddyAllocator::INVALID_OFFSET);
+    }
+
+    SUBCASE("random")
+    {
+        struct Range {
+            size_t offset;
+            size_t size;
+        };
+
+        BuddyAllocator allocator(1 << 20, 256);
+        std::vector<Range> ranges;
+        std::mt19937 rng(42);
+
+        for (int i = 0; i < 10000; ++i) {
+            if (ranges.empty() || rng() % 3 != 0) {
+                size_t size = 1 + rng() % 20000;
+                size_t offset = allocator.allocate(size);
+                if (offset != BuddyAllocator::INVALID_OFFSET) {
+                    CHECK_LE(offset + size, allocator.size());
+                    ranges.push_back({offset, size});
+                }
+            } else {
+                size_t index = rng() % ranges.size();
+                allocator.free(ranges[index].offset);
+                ranges[index] = ranges.back();
+                ranges.pop_back();
+            }
+        }
+
+        // No overlapping ranges.
+        std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) { return a.offset < b.offset; });
+        for (size_t i = 1; i < ranges.size(); ++i)
+            CHECK_LE(ranges[i - 1].offset + ranges[i - 1].size, ranges[i].offset);
+        CHECK_EQ(allocator.allocation_count(), ranges.size());
+
+        for (const Range &range : ranges)
+            allocator.free(range.offset);
+        CHECK(allocator.empty());
+        CHECK_EQ(allocator.largest_free_block(), allocator.size());
+    }
+}
+
+TEST_SUITE_END();
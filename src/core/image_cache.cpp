@@ -0,0 +1,251 @@
+#include "image_cache.h"
+
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+FR_NAMESPACE_BEGIN
+
+size_t ImageCacheKeyHash::operator()(const ImageCacheKey &key) const
+{
+    size_t hash = std::hash<std::string>{}(key.path);
+    auto combine = [&hash](uint64_t value) {
+        hash ^= std::hash<uint64_t>{}(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    };
+    combine(key.file_size);
+    combine(static_cast<uint64_t>(key.modified_time));
+    combine(key.scale_denom);
+    return hash;
+}
+
+struct ImageCache::Shard {
+    struct Entry {
+        ImageCacheKey key;
+        DecodedImagePtr image;
+        size_t size;
+    };
+
+    std::mutex mutex;
+    // Most recently used entry at the front.
+    std::list<Entry> lru;
+    std::unordered_map<ImageCacheKey, std::list<Entry>::iterator, ImageCacheKeyHash> map;
+};
+
+ImageCacheKey ImageCacheKey::from_file(const std::filesystem::path &path, uint32_t scale_denom)
+{
+    ImageCacheKey key;
+    key.path = path.generic_string();
+    key.scale_denom = scale_denom;
+
+    std::error_code ec;
+    uint64_t file_size = std::filesystem::file_size(path, ec);
+    if (!ec)
+        key.file_size = file_size;
+    auto modified_time = std::filesystem::last_write_time(path, ec);
+    if (!ec)
+        key.modified_time = static_cast<int64_t>(modified_time.time_since_epoch().count());
+
+    return key;
+}
+
+ImageCache::ImageCache(size_t budget_bytes, uint32_t shard_count)
+    : m_budget(budget_bytes), m_shard_count(std::max(1u, shard_count))
+{
+    m_shards = std::make_unique<Shard[]>(m_shard_count);
+}
+
+ImageCache::~ImageCache() { set_memory_budget(nullptr); }
+
+void ImageCache::set_memory_budget(MemoryBudget *budget, MemoryPriority priority)
+{
+    if (m_memory_budget)
+        m_memory_budget->unregister_consumer(m_consumer_id);
+    m_memory_budget = budget;
+    if (m_memory_budget)
+        m_consumer_id = m_memory_budget->register_consumer("images", this, priority);
+}
+
+DecodedImagePtr ImageCache::get(const ImageCacheKey &key)
+{
+    Shard &shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+        m_misses++;
+        return nullptr;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    m_hits++;
+    return it->second->image;
+}
+
+DecodedImagePtr ImageCache::insert(const ImageCacheKey &key, DecodedImage image)
+{
+    size_t size = image.size_bytes();
+    DecodedImagePtr image_ptr = std::make_shared<const DecodedImage>(std::move(image));
+
+    uint32_t shard_index;
+    Shard &shard = shard_for(key, &shard_index);
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (auto it = shard.map.find(key); it != shard.map.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return it->second->image;
+        }
+    }
+
+    // Reserve budget without holding the shard lock, eviction might need to lock any shard (also when the global
+    // budget evicts from this cache).
+    if ((m_memory_budget && !m_memory_budget->request(size)) || !reserve(size, shard_index)) {
+        m_rejections++;
+        return image_ptr;
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // Another thread might have inserted the same key in the meantime.
+    if (auto it = shard.map.find(key); it != shard.map.end()) {
+        m_size -= size;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return it->second->image;
+    }
+
+    shard.lru.push_front({key, image_ptr, size});
+    shard.map.emplace(key, shard.lru.begin());
+
+    return image_ptr;
+}
+
+DecodedImagePtr ImageCache::get_or_load(const ImageCacheKey &key, const LoadFunc &load)
+{
+    if (DecodedImagePtr image = get(key))
+        return image;
+
+    std::optional<DecodedImage> image = load();
+    if (!image)
+        return nullptr;
+
+    return insert(key, std::move(*image));
+}
+
+DecodedImagePtr ImageCache::load(const std::filesystem::path &path, uint32_t scale_denom)
+{
+    return get_or_load(ImageCacheKey::from_file(path, scale_denom), [&]() -> std::optional<DecodedImage> {
+        auto input = ImageInput::open(path);
+        if (!input || !input->set_scale_denom(scale_denom))
+            return std::nullopt;
+
+        DecodedImage image;
+        image.spec = input->spec();
+        image.pixels.resize(size_t(image.spec.width) * image.spec.height * image.spec.component_count);
+        if (!input->read_image(image.pixels.data(), image.pixels.size()))
+            return std::nullopt;
+
+        return image;
+    });
+}
+
+bool ImageCache::erase(const ImageCacheKey &key)
+{
+    Shard &shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.map.find(key);
+    if (it == shard.map.end() || it->second->image.use_count() > 1)
+        return false;
+
+    m_size -= it->second->size;
+    shard.lru.erase(it->second);
+    shard.map.erase(it);
+
+    return true;
+}
+
+void ImageCache::clear() { evict(std::numeric_limits<size_t>::max()); }
+
+size_t ImageCache::evict(size_t bytes)
+{
+    size_t freed = 0;
+    for (uint32_t i = 0; i < m_shard_count && freed < bytes; ++i)
+        freed += evict_shard(m_shards[i], bytes - freed);
+    return freed;
+}
+
+ImageCacheStats ImageCache::stats() const
+{
+    ImageCacheStats stats;
+    stats.hits = m_hits.load();
+    stats.misses = m_misses.load();
+    stats.evictions = m_evictions.load();
+    stats.rejections = m_rejections.load();
+    stats.size_bytes = m_size.load();
+    for (uint32_t i = 0; i < m_shard_count; ++i) {
+        std::lock_guard<std::mutex> lock(m_shards[i].mutex);
+        stats.entry_count += m_shards[i].map.size();
+    }
+    return stats;
+}
+
+ImageCache::Shard &ImageCache::shard_for(const ImageCacheKey &key, uint32_t *index)
+{
+    uint32_t shard_index = static_cast<uint32_t>(ImageCacheKeyHash{}(key) % m_shard_count);
+    if (index)
+        *index = shard_index;
+    return m_shards[shard_index];
+}
+
+bool ImageCache::reserve(size_t bytes, uint32_t start_shard)
+{
+    if (bytes > m_budget)
+        return false;
+
+    size_t size = m_size.load();
+    while (true) {
+        if (size + bytes <= m_budget) {
+            if (m_size.compare_exchange_weak(size, size + bytes))
+                return true;
+            continue;
+        }
+
+        // Evict starting with the shard the entry goes into, then move on to the others.
+        size_t needed = size + bytes - m_budget;
+        size_t freed = 0;
+        for (uint32_t i = 0; i < m_shard_count && freed < needed; ++i)
+            freed += evict_shard(m_shards[(start_shard + i) % m_shard_count], needed - freed);
+
+        if (freed == 0)
+            return false;
+
+        size = m_size.load();
+    }
+}
+
+size_t ImageCache::evict_shard(Shard &shard, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    size_t freed = 0;
+    auto it = shard.lru.end();
+    while (it != shard.lru.begin() && freed < bytes) {
+        --it;
+        // Only the cache holds a reference to unpinned entries. As new references can only be
+        // handed out while holding the shard lock, the use count cannot increase concurrently.
+        if (it->image.use_count() > 1)
+            continue;
+
+        freed += it->size;
+        m_size -= it->size;
+        m_evictions++;
+        shard.map.erase(it->key);
+        it = shard.lru.erase(it);
+    }
+
+    return freed;
+}
+
+FR_NAMESPACE_END
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "defs.h"
+#include "imageio.h"
+#include "memory_budget.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+FR_NAMESPACE_BEGIN
+
+/// Decoded image pixels.
+struct DecodedImage {
+    ImageSpec spec;
+    std::vector<uint8_t> pixels;
+
+    size_t size_bytes() const { return pixels.size(); }
+};
+
+using DecodedImagePtr = std::shared_ptr<const DecodedImage>;
+
+/**
+ * Identifies a decoded image by file identity and decode parameters.
+ */
+struct ImageCacheKey {
+    std::string path;
+    uint64_t file_size{0};
+    int64_t modified_time{0};
+    uint32_t scale_denom{1};  ///< Image is decoded at 1/scale_denom of its original size.
+
+    /**
+     * Create a key for a file on disk.
+     * @param path Path to the image file.
+     * @param scale_denom Decode scale denominator.
+     * @return Key using the current file size and modification time.
+     */
+    static ImageCacheKey from_file(const std::filesystem::path &path, uint32_t scale_denom = 1);
+
+    bool operator==(const ImageCacheKey &other) const = default;
+};
+
+struct ImageCacheKeyHash {
+    size_t operator()(const ImageCacheKey &key) const;
+};
+
+struct ImageCacheStats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t evictions{0};
+    uint64_t rejections{0};  ///< Inserts that did not fit into the budget.
+    size_t size_bytes{0};
+    size_t entry_count{0};
+};
+
+/**
+ * Thread-safe LRU cache of decoded images with a hard byte budget.
+ *
+ * Entries are distributed over independently locked shards, each keeping its own LRU order.
+ * An entry is pinned while any DecodedImagePtr returned by the cache is alive; pinned entries
+ * are never evicted. If the budget cannot be met by evicting unpinned entries, the image is
+ * returned to the caller but not cached.
+ *
+ * With set_memory_budget() the cache takes part in a global MemoryBudget: it can be asked to evict by the budget,
+ * and inserts request room from the budget first, which might evict from other consumers.
+ */
+class ImageCache : public MemoryConsumer {
+public:
+    using LoadFunc = std::function<std::optional<DecodedImage>()>;
+
+    /**
+     * Constructor.
+     * @param budget_bytes Maximum number of bytes of pixel data held by the cache.
+     * @param shard_count Number of independently locked shards.
+     */
+    ImageCache(size_t budget_bytes, uint32_t shard_count = 8);
+    ~ImageCache();
+
+    /// Look up an image. Returns nullptr on a miss.
+    DecodedImagePtr get(const ImageCacheKey &key);
+
+    /**
+     * Insert an image. If the key is already present, the existing entry is returned.
+     * @param key Cache key.
+     * @param image Decoded image.
+     * @return Pointer to the cached image (or the uncached image if it did not fit the budget).
+     */
+    DecodedImagePtr insert(const ImageCacheKey &key, DecodedImage image);
+
+    /**
+     * Look up an image and call the load function on a miss.
+     * @return Pointer to the image or nullptr if loading failed.
+     */
+    DecodedImagePtr get_or_load(const ImageCacheKey &key, const LoadFunc &load);
+
+    /**
+     * Look up an image file and decode it on a miss.
+     * @param path Path to the image file.
+     * @param scale_denom Decode scale denominator (see ImageInput::set_scale_denom()).
+     * @return Pointer to the image or nullptr if decoding failed.
+     */
+    DecodedImagePtr load(const std::filesystem::path &path, uint32_t scale_denom = 1);
+
+    /// Remove an entry. Returns false if the entry does not exist or is pinned.
+    bool erase(const ImageCacheKey &key);
+
+    /// Remove all unpinned entries.
+    void clear();
+
+    /**
+     * Evict unpinned entries in LRU order.
+     * @param bytes Number of bytes to free.
+     * @return Number of bytes actually freed.
+     */
+    size_t evict(size_t bytes);
+
+    /**
+     * Register the cache as a consumer of a memory budget, replacing a previous one.
+     * Must not be called concurrently with insert().
+     * @param budget Budget, must outlive the cache or be detached with nullptr.
+     * @param priority Eviction priority.
+     */
+    void set_memory_budget(MemoryBudget *budget, MemoryPriority priority = MemoryPriority::Low);
+
+    size_t budget() const { return m_budget; }
+    size_t size_bytes() const { return m_size.load(); }
+
+    ImageCacheStats stats() const;
+
+    // MemoryConsumer
+    size_t memory_usage() const override { return size_bytes(); }
+    size_t evict_memory(size_t bytes) override { return evict(bytes); }
+
+private:
+    ImageCache(const ImageCache &) = delete;
+    ImageCache &operator=(const ImageCache &) = delete;
+
+    struct Shard;
+
+    Shard &shard_for(const ImageCacheKey &key, uint32_t *index = nullptr);
+    bool reserve(size_t bytes, uint32_t start_shard);
+    size_t evict_shard(Shard &shard, size_t bytes);
+
+    size_t m_budget;
+    uint32_t m_shard_count;
+    std::unique_ptr<Shard[]> m_shards;
+
+    MemoryBudget *m_memory_budget{nullptr};
+    MemoryBudget::ConsumerId m_consumer_id{0};
+
+    std::atomic<size_t> m_size{0};
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_evictions{0};
+    std::atomic<uint64_t> m_rejections{0};
+};
+
+FR_NAMESPACE_END
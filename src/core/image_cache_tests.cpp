@@ -0,0 +1,149 @@
+#include "image_cache.h"
+
+#include <doctest/doctest.h>
+
+#include <thread>
+#include <vector>
+
+using namespace fr;
+
+static ImageCacheKey make_key(const char *path, uint32_t scale_denom = 1)
+{
+    return {.path = path, .file_size = 1000, .modified_time = 1, .scale_denom = scale_denom};
+}
+
+static DecodedImage make_image(uint32_t width, uint32_t height, uint8_t value = 0)
+{
+    DecodedImage image;
+    image.spec = {.width = width, .height = height, .component_type = ComponentType::U8, .component_count = 1};
+    image.pixels.resize(width * height, value);
+    return image;
+}
+
+TEST_SUITE_BEGIN("image_cache");
+
+TEST_CASE("ImageCache")
+{
+    SUBCASE("hit and miss")
+    {
+        ImageCache cache(1000);
+
+        CHECK_EQ(cache.get(make_key("a")), nullptr);
+        cache.insert(make_key("a"), make_image(10, 10, 1));
+
+        DecodedImagePtr image = cache.get(make_key("a"));
+        REQUIRE(image);
+        CHECK_EQ(image->pixels[0], 1);
+
+        // Decode parameters are part of the key.
+        CHECK_EQ(cache.get(make_key("a", 2)), nullptr);
+
+        ImageCacheStats stats = cache.stats();
+        CHECK_EQ(stats.hits, 1);
+        CHECK_EQ(stats.misses, 2);
+        CHECK_EQ(stats.entry_count, 1);
+        CHECK_EQ(stats.size_bytes, 100);
+    }
+
+    SUBCASE("lru eviction")
+    {
+        // Single shard for deterministic LRU order.
+        ImageCache cache(300, 1);
+
+        cache.insert(make_key("a"), make_image(10, 10));
+        cache.insert(make_key("b"), make_image(10, 10));
+        cache.insert(make_key("c"), make_image(10, 10));
+        CHECK(cache.get(make_key("a")));
+
+        // "b" is the least recently used entry.
+        cache.insert(make_key("d"), make_image(10, 10));
+        CHECK(cache.get(make_key("a")));
+        CHECK_FALSE(cache.get(make_key("b")));
+        CHECK(cache.get(make_key("c")));
+        CHECK(cache.get(make_key("d")));
+
+        CHECK_EQ(cache.stats().evictions, 1);
+        CHECK_LE(cache.size_bytes(), cache.budget());
+    }
+
+    SUBCASE("pinning")
+    {
+        ImageCache cache(200, 1);
+
+        DecodedImagePtr a = cache.insert(make_key("a"), make_image(10, 10));
+        DecodedImagePtr b = cache.insert(make_key("b"), make_image(10, 10));
+
+        // All entries are pinned, the new image is not cached.
+        DecodedImagePtr c = cache.insert(make_key("c"), make_image(10, 10));
+        REQUIRE(c);
+        CHECK_FALSE(cache.get(make_key("c")));
+        CHECK_EQ(cache.stats().rejections, 1);
+        CHECK_FALSE(cache.erase(make_key("a")));
+
+        // Releasing the pin allows eviction.
+        a.reset();
+        cache.insert(make_key("c"), make_image(10, 10));
+        CHECK_FALSE(cache.get(make_key("a")));
+        CHECK(cache.get(make_key("b")));
+        CHECK(cache.get(make_key("c")));
+    }
+
+    SUBCASE("budget")
+    {
+        ImageCache cache(1000);
+
+        // Images larger than the budget are never cached.
+        DecodedImagePtr image = cache.insert(make_key("a"), make_image(100, 100));
+        REQUIRE(image);
+        CHECK_EQ(cache.size_bytes(), 0);
+
+        cache.insert(make_key("b"), make_image(10, 10));
+        cache.clear();
+        CHECK_EQ(cache.size_bytes(), 0);
+        CHECK_EQ(cache.stats().entry_count, 0);
+    }
+
+    SUBCASE("get_or_load")
+    {
+        ImageCache cache(1000);
+        int load_count = 0;
+        auto load = [&]() -> std::optional<DecodedImage> {
+            load_count++;
+            return make_image(10, 10);
+        };
+
+        CHECK(cache.get_or_load(make_key("a"), load));
+        CHECK(cache.get_or_load(make_key("a"), load));
+        CHECK_EQ(load_count, 1);
+
+        CHECK_FALSE(cache.get_or_load(make_key("b"), []() -> std::optional<DecodedImage> { return std::nullopt; }));
+    }
+
+    SUBCASE("multithreaded")
+    {
+        ImageCache cache(64 * 100);
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; ++t) {
+            threads.emplace_back([&cache, t]() {
+                for (int i = 0; i < 1000; ++i) {
+                    std::string path = std::to_string((i * 7 + t) % 100);
+                    ImageCacheKey key = make_key(path.c_str());
+                    DecodedImagePtr image = cache.get(key);
+                    if (!image)
+                        image = cache.insert(key, make_image(10, 10, uint8_t(i)));
+                    CHECK_EQ(image->pixels.size(), 100);
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+
+        ImageCacheStats stats = cache.stats();
+        CHECK_EQ(stats.hits + stats.misses, 8000);
+        CHECK_LE(stats.size_bytes, cache.budget());
+        CHECK_EQ(stats.size_bytes, stats.entry_count * 100);
+    }
+}
+
+TEST_SUITE_END();
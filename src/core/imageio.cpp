@@ -25,6 +25,7 @@ public:
 
     virtual bool open(const std::filesystem::path &path, ImageSpec &out_spec) = 0;
     virtual bool open(const void *buffer, size_t len, ImageSpec &out_spec) = 0;
+    virtual bool set_scale_denom(uint32_t scale_denom, ImageSpec &out_spec) { return scale_denom == 1; }
     virtual bool read_image(void *buffer, size_t len) = 0;
 };
 
@@ -91,6 +92,22 @@ public:
         }
     }
 
+    bool set_scale_denom(uint32_t scale_denom, ImageSpec &out_spec) override
+    {
+        // libjpeg scales in the DCT domain, which is much cheaper than decoding at full size.
+        if (scale_denom != 1 && scale_denom != 2 && scale_denom != 4 && scale_denom != 8)
+            return false;
+
+        m_info.scale_num = 1;
+        m_info.scale_denom = scale_denom;
+        jpeg_calc_output_dimensions(&m_info);
+
+        out_spec.width = m_info.output_width;
+        out_spec.height = m_info.output_height;
+
+        return true;
+    }
+
     bool read_image(void *buffer, size_t len) override
     {
         uint8_t *dst = reinterpret_cast<uint8_t *>(buffer);
@@ -240,6 +257,12 @@ std::unique_ptr<ImageInput> ImageInput::open(const std::filesystem::path &path)
 
 ImageInput::~ImageInput() {}
 
+bool ImageInput::set_scale_denom(uint32_t scale_denom)
+{
+    FR_ASSERT(m_reader);
+    return m_reader->set_scale_denom(scale_denom, m_spec);
+}
+
 bool ImageInput::read_image(void *buffer, size_t len)
 {
     FR_ASSERT(m_reader);
@@ -32,6 +32,13 @@ public:
 
     const ImageSpec &spec() const { return m_spec; }
 
+    /**
+     * Decode the image at a reduced size. Must be called before read_image().
+     * @param scale_denom Scale denominator, the image is decoded at 1/scale_denom of its original size.
+     * @return True if the scale is supported by the image format. spec() then reports the scaled size.
+     */
+    bool set_scale_denom(uint32_t scale_denom);
+
     bool read_image(void *buffer, size_t len);
 
 private:
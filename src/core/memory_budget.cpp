@@ -0,0 +1,186 @@
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <fstream>
+
+#if FR_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif FR_LINUX
+#include <unistd.h>
+#elif FR_MACOS
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#else
+#error "Unknown OS"
+#endif
+
+FR_NAMESPACE_BEGIN
+
+#if FR_LINUX
+/// Read a cgroup memory limit file. Returns 0 if the file does not exist or there is no limit.
+inline size_t read_cgroup_limit(const char *path)
+{
+    std::ifstream file(path);
+    std::string value;
+    if (!file || !(file >> value) || value == "max")
+        return 0;
+    try {
+        uint64_t limit = std::stoull(value);
+        // cgroup v1 reports "no limit" as a huge page aligned value.
+        return limit >= (uint64_t(1) << 60) ? 0 : size_t(limit);
+    } catch (const std::exception &) {
+        return 0;
+    }
+}
+#endif
+
+MemoryBudget::MemoryBudget(size_t limit_bytes) : m_limit(limit_bytes ? limit_bytes : system_memory_limit()) {}
+
+MemoryBudget::~MemoryBudget() {}
+
+MemoryBudget &MemoryBudget::global()
+{
+    static MemoryBudget budget;
+    return budget;
+}
+
+size_t MemoryBudget::system_memory_limit()
+{
+    size_t physical = 0;
+#if FR_WINDOWS
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status))
+        physical = size_t(status.ullTotalPhys);
+#elif FR_LINUX
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && page_size > 0)
+        physical = size_t(pages) * size_t(page_size);
+
+    size_t cgroup_limit = read_cgroup_limit("/sys/fs/cgroup/memory.max");
+    if (cgroup_limit == 0)
+        cgroup_limit = read_cgroup_limit("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+    if (cgroup_limit != 0)
+        physical = physical ? std::min(physical, cgroup_limit) : cgroup_limit;
+#elif FR_MACOS
+    uint64_t memsize = 0;
+    size_t length = sizeof(memsize);
+    if (sysctlbyname("hw.memsize", &memsize, &length, nullptr, 0) == 0)
+        physical = size_t(memsize);
+#endif
+    return physical;
+}
+
+MemoryBudget::ConsumerId MemoryBudget::register_consumer(std::string name, MemoryConsumer *consumer,
+                                                         MemoryPriority priority)
+{
+    FR_ASSERT(consumer);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ConsumerId id = m_next_id++;
+    // Keep consumers sorted by priority, most recently registered first within the same priority.
+    auto it = std::find_if(m_consumers.begin(), m_consumers.end(),
+                           [priority](const Consumer &c) { return c.priority >= priority; });
+    m_consumers.insert(it, Consumer{id, std::move(name), consumer, priority, 0});
+    return id;
+}
+
+void MemoryBudget::unregister_consumer(ConsumerId id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::erase_if(m_consumers, [id](const Consumer &c) { return c.id == id; });
+}
+
+size_t MemoryBudget::limit() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_limit;
+}
+
+void MemoryBudget::set_limit(size_t limit_bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_limit = limit_bytes;
+}
+
+void MemoryBudget::set_watermarks(float high, float low)
+{
+    FR_ASSERT(low >= 0.f && low <= high && high <= 1.f);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_high_watermark = high;
+    m_low_watermark = low;
+}
+
+size_t MemoryBudget::usage() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return usage_locked();
+}
+
+std::vector<MemoryConsumerUsage> MemoryBudget::usage_report() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<MemoryConsumerUsage> report;
+    report.reserve(m_consumers.size());
+    for (const Consumer &c : m_consumers)
+        report.push_back({c.name, c.priority, c.consumer->memory_usage(), c.evicted_bytes});
+    return report;
+}
+
+size_t MemoryBudget::enforce()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t usage = usage_locked();
+    if (m_limit == 0 || usage <= watermark_bytes(m_high_watermark))
+        return 0;
+    return evict_locked(usage, watermark_bytes(m_low_watermark));
+}
+
+bool MemoryBudget::request(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_limit == 0)
+        return true;
+    const size_t high = watermark_bytes(m_high_watermark);
+    if (bytes > high)
+        return false;
+    size_t usage = usage_locked();
+    if (usage + bytes <= high)
+        return true;
+    size_t target = std::min(high, watermark_bytes(m_low_watermark) + bytes) - bytes;
+    size_t freed = evict_locked(usage, target);
+    return usage - std::min(usage, freed) + bytes <= high;
+}
+
+size_t MemoryBudget::watermark_bytes(float watermark) const
+{
+    return size_t(double(m_limit) * watermark + 0.5);
+}
+
+size_t MemoryBudget::usage_locked() const
+{
+    size_t usage = 0;
+    for (const Consumer &c : m_consumers)
+        usage += c.consumer->memory_usage();
+    return usage;
+}
+
+size_t MemoryBudget::evict_locked(size_t usage, size_t target)
+{
+    size_t freed = 0;
+    for (Consumer &c : m_consumers) {
+        if (usage <= target)
+            break;
+        size_t bytes = c.consumer->evict_memory(usage - target);
+        c.evicted_bytes += bytes;
+        freed += bytes;
+        usage -= std::min(usage, bytes);
+    }
+    return freed;
+}
+
+FR_NAMESPACE_END
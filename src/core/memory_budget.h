@@ -0,0 +1,142 @@
+#pragma once
+
+#include "defs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+FR_NAMESPACE_BEGIN
+
+/**
+ * Interface for caches that hold evictable memory.
+ */
+class MemoryConsumer {
+public:
+    virtual ~MemoryConsumer() = default;
+
+    /// Number of bytes currently held by the consumer.
+    virtual size_t memory_usage() const = 0;
+
+    /**
+     * Release memory.
+     * Called by MemoryBudget with its lock held, implementations must not call back into the budget.
+     * @param bytes Number of bytes to free.
+     * @return Number of bytes actually freed.
+     */
+    virtual size_t evict_memory(size_t bytes) = 0;
+};
+
+/// Eviction priority, consumers with lower priority are asked to evict first.
+enum class MemoryPriority : uint32_t {
+    Low,     ///< Cheap to recreate (e.g. decoded previews).
+    Normal,  ///< E.g. thumbnails, staging memory.
+    High,    ///< Expensive to recreate (e.g. catalog metadata).
+};
+
+/// Usage report of a single consumer.
+struct MemoryConsumerUsage {
+    std::string name;
+    MemoryPriority priority{MemoryPriority::Normal};
+    size_t usage_bytes{0};
+    size_t evicted_bytes{0};  ///< Total number of bytes evicted on request of the budget.
+};
+
+/**
+ * Central memory budget shared by all caches.
+ *
+ * Consumers register with a priority and report their usage when polled. When the total usage
+ * exceeds the high watermark of the limit, consumers are asked to evict in priority order
+ * (lowest first, most recently registered first within a priority) until usage drops below the
+ * low watermark.
+ */
+class MemoryBudget {
+public:
+    using ConsumerId = uint32_t;
+
+    /**
+     * Constructor.
+     * @param limit_bytes Memory limit in bytes, 0 to use system_memory_limit().
+     */
+    MemoryBudget(size_t limit_bytes = 0);
+    ~MemoryBudget();
+
+    /// Global memory budget using the system memory limit.
+    static MemoryBudget &global();
+
+    /**
+     * Memory available to this process: the cgroup limit (v2 or v1) if set, the physical memory otherwise.
+     * @return Limit in bytes or 0 if it could not be determined.
+     */
+    static size_t system_memory_limit();
+
+    /**
+     * Register a consumer.
+     * @param name Name used in usage reports.
+     * @param consumer Consumer, must stay alive until unregistered.
+     * @param priority Eviction priority.
+     * @return Consumer id.
+     */
+    ConsumerId register_consumer(std::string name, MemoryConsumer *consumer,
+                                 MemoryPriority priority = MemoryPriority::Normal);
+
+    /// Unregister a consumer.
+    void unregister_consumer(ConsumerId id);
+
+    size_t limit() const;
+    void set_limit(size_t limit_bytes);
+
+    /**
+     * Set the watermarks as fractions of the limit.
+     * @param high Eviction starts when usage exceeds high * limit.
+     * @param low Eviction stops when usage drops below low * limit.
+     */
+    void set_watermarks(float high, float low);
+
+    /// Total usage of all consumers in bytes.
+    size_t usage() const;
+
+    /// Per-consumer usage, sorted by eviction order.
+    std::vector<MemoryConsumerUsage> usage_report() const;
+
+    /**
+     * Evict memory if usage exceeds the high watermark.
+     * @return Number of bytes freed.
+     */
+    size_t enforce();
+
+    /**
+     * Make room for an allocation, evicting as needed to keep usage + bytes below the high watermark.
+     * @param bytes Size of the upcoming allocation.
+     * @return True if the allocation fits into the budget.
+     */
+    bool request(size_t bytes);
+
+private:
+    MemoryBudget(const MemoryBudget &) = delete;
+    MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+    struct Consumer {
+        ConsumerId id;
+        std::string name;
+        MemoryConsumer *consumer;
+        MemoryPriority priority;
+        size_t evicted_bytes;
+    };
+
+    size_t watermark_bytes(float watermark) const;
+    size_t usage_locked() const;
+    size_t evict_locked(size_t usage, size_t target);
+
+    mutable std::mutex m_mutex;
+    // Sorted by eviction order.
+    std::vector<Consumer> m_consumers;
+    ConsumerId m_next_id{1};
+    size_t m_limit;
+    float m_high_watermark{0.9f};
+    float m_low_watermark{0.75f};
+};
+
+FR_NAMESPACE_END
@@ -0,0 +1,141 @@
+#include "image_cache.h"
+#include "memory_budget.h"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+
+using namespace fr;
+
+class TestConsumer : public MemoryConsumer {
+public:
+    TestConsumer(size_t usage) : m_usage(usage) {}
+
+    size_t memory_usage() const override { return m_usage; }
+    size_t evict_memory(size_t bytes) override
+    {
+        size_t freed = std::min(bytes, m_usage);
+        m_usage -= freed;
+        return freed;
+    }
+
+private:
+    size_t m_usage;
+};
+
+TEST_SUITE_BEGIN("memory_budget");
+
+TEST_CASE("MemoryBudget")
+{
+    SUBCASE("usage report")
+    {
+        MemoryBudget budget(1000);
+        TestConsumer a(100);
+        TestConsumer b(200);
+        budget.register_consumer("a", &a, MemoryPriority::High);
+        auto id = budget.register_consumer("b", &b, MemoryPriority::Low);
+
+        CHECK_EQ(budget.usage(), 300);
+        auto report = budget.usage_report();
+        REQUIRE_EQ(report.size(), 2);
+        CHECK_EQ(report[0].name, "b");
+        CHECK_EQ(report[0].usage_bytes, 200);
+        CHECK_EQ(report[1].name, "a");
+        CHECK_EQ(report[1].usage_bytes, 100);
+
+        budget.unregister_consumer(id);
+        CHECK_EQ(budget.usage(), 100);
+    }
+
+    SUBCASE("evict in priority order")
+    {
+        MemoryBudget budget(1000);
+        budget.set_watermarks(0.9f, 0.5f);
+        TestConsumer low(300);
+        TestConsumer normal(300);
+        TestConsumer high(300);
+        budget.register_consumer("high", &high, MemoryPriority::High);
+        budget.register_consumer("low", &low, MemoryPriority::Low);
+        budget.register_consumer("normal", &normal, MemoryPriority::Normal);
+
+        // Below the high watermark, nothing happens.
+        CHECK_EQ(budget.enforce(), 0);
+
+        TestConsumer extra(100);
+        budget.register_consumer("extra", &extra, MemoryPriority::High);
+        CHECK_EQ(budget.enforce(), 500);
+        CHECK_EQ(low.memory_usage(), 0);
+        CHECK_EQ(normal.memory_usage(), 100);
+        CHECK_EQ(high.memory_usage(), 300);
+        CHECK_EQ(extra.memory_usage(), 100);
+        CHECK_EQ(budget.usage(), 500);
+
+        auto report = budget.usage_report();
+        CHECK_EQ(report[0].evicted_bytes, 300);
+        CHECK_EQ(report[1].evicted_bytes, 200);
+    }
+
+    SUBCASE("request")
+    {
+        MemoryBudget budget(1000);
+        budget.set_watermarks(1.f, 0.5f);
+        TestConsumer a(800);
+        budget.register_consumer("a", &a);
+
+        CHECK(budget.request(200));
+        CHECK_EQ(a.memory_usage(), 800);
+        CHECK(budget.request(300));
+        CHECK_EQ(a.memory_usage(), 500);
+        CHECK_FALSE(budget.request(2000));
+    }
+
+    SUBCASE("image cache")
+    {
+        MemoryBudget budget(1000);
+        budget.set_watermarks(0.5f, 0.2f);
+        ImageCache cache(1000, 1);
+        budget.register_consumer("images", &cache);
+
+        for (const char *path : {"a", "b", "c"}) {
+            DecodedImage image;
+            image.pixels.resize(200);
+            cache.insert({.path = path}, std::move(image));
+        }
+        CHECK_EQ(budget.usage(), 600);
+        CHECK_EQ(budget.enforce(), 400);
+        CHECK_EQ(cache.size_bytes(), 200);
+        // Most recently used entry is kept.
+        CHECK(cache.get({.path = "c"}));
+    }
+
+    SUBCASE("image cache requests")
+    {
+        MemoryBudget budget(1000);
+        budget.set_watermarks(1.f, 0.5f);
+        TestConsumer other(600);
+        budget.register_consumer("other", &other, MemoryPriority::Normal);
+        ImageCache cache(1000, 1);
+        cache.set_memory_budget(&budget);
+
+        // Inserts make room in the global budget, evicting the low priority cache first.
+        for (const char *path : {"a", "b", "c"}) {
+            DecodedImage image;
+            image.pixels.resize(200);
+            cache.insert({.path = path}, std::move(image));
+        }
+        CHECK_EQ(cache.size_bytes(), 200);
+        CHECK_EQ(other.memory_usage(), 500);
+        CHECK(cache.get({.path = "c"}));
+
+        cache.set_memory_budget(nullptr);
+        CHECK_EQ(budget.usage(), 500);
+    }
+
+    SUBCASE("system memory limit")
+    {
+        CHECK_GT(MemoryBudget::system_memory_limit(), 0);
+        CHECK_EQ(MemoryBudget::global().limit(), MemoryBudget::system_memory_limit());
+    }
+}
+
+TEST_SUITE_END();
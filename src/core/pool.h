@@ -2,8 +2,11 @@
 
 #include "defs.h"
 
-#include <vector>
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <mutex>
 
 FR_NAMESPACE_BEGIN
 
@@ -20,6 +23,9 @@ public:
 
     bool is_null() const { return m_gen == 0; }
 
+    uint32_t id() const { return m_id; }
+    uint32_t gen() const { return m_gen; }
+
     operator bool() const { return !is_null(); }
 
     bool operator==(const Handle<Tag> &other) const { return m_id == other.m_id && m_gen == other.m_gen; }
@@ -33,70 +39,173 @@ private:
     friend class Pool;
 };
 
+/**
+ * Pool of objects addressed by generational handles.
+ *
+ * Objects are stored in fixed-size chunks that are never moved, so a pointer returned by get() stays valid until
+ * its handle is freed. alloc(), free() and lookups are thread-safe and lock-free except when a new chunk is
+ * allocated. Accessing the objects themselves is not synchronized, and freed objects are not reset.
+ *
+ * Generations are odd for live slots and even for free slots, so stale and null handles never validate.
+ */
 template <typename T, typename HandleType>
 class Pool {
 public:
-    HandleType alloc()
+    static constexpr uint32_t CHUNK_SIZE = 256;
+    static constexpr uint32_t MAX_CHUNK_COUNT = 4096;
+
+    Pool() = default;
+
+    ~Pool()
     {
-        FR_ASSERT(m_objects.size() == m_gens.size());
+        for (auto &chunk : m_chunks)
+            delete[] chunk.load(std::memory_order_relaxed);
+    }
 
-        if (!m_free_list.empty()) {
-            uint32_t id = m_free_list.back();
-            m_free_list.pop_back();
-            uint32_t gen = m_gens[id];
-            return HandleType(id, gen);
+    HandleType alloc()
+    {
+        // pop from the free list, the tag in the upper bits of the head prevents ABA
+        uint64_t head = m_free_head.load(std::memory_order_acquire);
+        while (uint32_t(head) != INVALID_ID) {
+            uint32_t id = uint32_t(head);
+            uint64_t next = (head & TAG_MASK) + TAG_ONE + slot(id).next_free.load(std::memory_order_relaxed);
+            if (m_free_head.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+                return activate(id);
         }
 
-        m_objects.emplace_back();
-        m_gens.emplace_back(1);
-        uint32_t id = (uint32_t)(m_objects.size() - 1);
-        uint32_t gen = m_gens[id];
-        return HandleType(id, gen);
+        // append a new slot
+        uint32_t id = m_slot_count.fetch_add(1, std::memory_order_relaxed);
+        if (id >= CHUNK_SIZE * MAX_CHUNK_COUNT) {
+            FR_ASSERT(false);
+            return HandleType::null();
+        }
+        std::atomic<Slot *> &chunk = m_chunks[id / CHUNK_SIZE];
+        if (!chunk.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(m_chunk_mutex);
+            if (!chunk.load(std::memory_order_relaxed))
+                chunk.store(new Slot[CHUNK_SIZE], std::memory_order_release);
+        }
+        return activate(id);
     }
 
     bool free(HandleType handle)
     {
-        if (!is_valid(handle))
+        Slot *s = find_slot(handle);
+        if (!s)
             return false;
 
-        m_free_list.push_back(handle.m_id);
-        m_gens[handle.m_id]++;
+        // invalidate the handle, fails if another thread freed it first
+        uint32_t gen = handle.m_gen;
+        if (!s->gen.compare_exchange_strong(gen, gen + 1, std::memory_order_acq_rel))
+            return false;
 
-        return true;
-    }
+        uint64_t head = m_free_head.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            s->next_free.store(uint32_t(head), std::memory_order_relaxed);
+            next = (head & TAG_MASK) + TAG_ONE + handle.m_id;
+        } while (!m_free_head.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
 
-    bool is_valid(HandleType handle) const
-    {
-        if (handle.m_id >= m_objects.size())
-            return false;
-        if (handle.m_gen != m_gens[handle.m_id])
-            return false;
+        m_live_count.fetch_sub(1, std::memory_order_relaxed);
         return true;
     }
 
+    bool is_valid(HandleType handle) const { return find_slot(handle) != nullptr; }
+
     T *get(HandleType handle)
     {
-        if (!is_valid(handle))
-            return nullptr;
-
-        return &m_objects[handle.m_id];
+        Slot *s = find_slot(handle);
+        return s ? &s->object : nullptr;
     }
 
     const T *get(HandleType handle) const
     {
-        if (!is_valid(handle))
-            return nullptr;
-
-        return &m_objects[handle.m_id];
+        const Slot *s = find_slot(handle);
+        return s ? &s->object : nullptr;
     }
 
     T *operator[](HandleType handle) { return get(handle); }
     const T *operator[](HandleType handle) const { return get(handle); }
 
+    /// Number of live objects.
+    size_t size() const { return m_live_count.load(std::memory_order_relaxed); }
+
+    /**
+     * Call func(handle, object) for every live object, in id order.
+     * Objects allocated or freed concurrently may or may not be visited.
+     */
+    template <typename Func>
+    void for_each(Func &&func)
+    {
+        const uint32_t slot_count =
+            std::min(m_slot_count.load(std::memory_order_acquire), CHUNK_SIZE * MAX_CHUNK_COUNT);
+        for (uint32_t chunk_index = 0; chunk_index * CHUNK_SIZE < slot_count; ++chunk_index) {
+            Slot *chunk = m_chunks[chunk_index].load(std::memory_order_acquire);
+            if (!chunk)
+                continue;
+            const uint32_t end = std::min(CHUNK_SIZE, slot_count - chunk_index * CHUNK_SIZE);
+            for (uint32_t i = 0; i < end; ++i) {
+                uint32_t gen = chunk[i].gen.load(std::memory_order_acquire);
+                if (gen & 1)
+                    func(HandleType(chunk_index * CHUNK_SIZE + i, gen), chunk[i].object);
+            }
+        }
+    }
+
 private:
-    std::vector<T> m_objects;
-    std::vector<uint32_t> m_gens;
-    std::vector<uint32_t> m_free_list;
+    Pool(const Pool &) = delete;
+    Pool &operator=(const Pool &) = delete;
+
+    static constexpr uint32_t INVALID_ID = ~uint32_t(0);
+    static constexpr uint64_t TAG_ONE = uint64_t(1) << 32;
+    static constexpr uint64_t TAG_MASK = ~uint64_t(0) << 32;
+
+    struct Slot {
+        T object;
+        std::atomic<uint32_t> gen{0};
+        std::atomic<uint32_t> next_free{INVALID_ID};
+    };
+
+    Slot &slot(uint32_t id) const
+    {
+        return m_chunks[id / CHUNK_SIZE].load(std::memory_order_acquire)[id % CHUNK_SIZE];
+    }
+
+    Slot *find_slot(HandleType handle) const
+    {
+        if (handle.m_id >= CHUNK_SIZE * MAX_CHUNK_COUNT || !(handle.m_gen & 1))
+            return nullptr;
+        Slot *chunk = m_chunks[handle.m_id / CHUNK_SIZE].load(std::memory_order_acquire);
+        if (!chunk)
+            return nullptr;
+        Slot &s = chunk[handle.m_id % CHUNK_SIZE];
+        if (s.gen.load(std::memory_order_acquire) != handle.m_gen)
+            return nullptr;
+        return &s;
+    }
+
+    HandleType activate(uint32_t id)
+    {
+        Slot &s = slot(id);
+        uint32_t gen = s.gen.load(std::memory_order_relaxed) + 1;
+        s.gen.store(gen, std::memory_order_release);
+        m_live_count.fetch_add(1, std::memory_order_relaxed);
+        return HandleType(id, gen);
+    }
+
+    std::atomic<Slot *> m_chunks[MAX_CHUNK_COUNT]{};
+    std::mutex m_chunk_mutex;  ///< Serializes chunk allocation.
+    std::atomic<uint32_t> m_slot_count{0};
+    std::atomic<uint64_t> m_free_head{INVALID_ID};  ///< Free list head: tag << 32 | id.
+    std::atomic<size_t> m_live_count{0};
 };
 
 FR_NAMESPACE_END
+
+template <typename Tag>
+struct std::hash<fr::Handle<Tag>> {
+    size_t operator()(const fr::Handle<Tag> &handle) const
+    {
+        return std::hash<uint64_t>{}((uint64_t(handle.gen()) << 32) | handle.id());
+    }
+};
@@ -1,8 +1,12 @@
 #include "pool.h"
+#include "timer.h"
 
 #include <doctest/doctest.h>
 
+#include <atomic>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace fr;
 
@@ -47,6 +51,209 @@ TEST_CASE("Pool")
     REQUIRE(pool.is_valid(b2));
     *pool.get(b2) = "world2";
 
+    CHECK_EQ(pool.size(), 2);
+    CHECK_FALSE(pool.free(b));
+    CHECK_FALSE(pool.is_valid(HandleType::null()));
+}
+
+TEST_CASE("Pool stable addresses")
+{
+    using HandleType = Handle<struct Tag>;
+    Pool<int, HandleType> pool;
+
+    auto first = pool.alloc();
+    int *first_ptr = pool.get(first);
+    std::vector<HandleType> handles;
+    for (int i = 0; i < 10000; ++i)
+        handles.push_back(pool.alloc());
+    CHECK_EQ(pool.get(first), first_ptr);
+}
+
+TEST_CASE("Pool for_each")
+{
+    using HandleType = Handle<struct Tag>;
+    Pool<int, HandleType> pool;
+
+    std::vector<HandleType> handles;
+    for (int i = 0; i < 1000; ++i) {
+        handles.push_back(pool.alloc());
+        *pool.get(handles.back()) = i;
+    }
+    for (int i = 0; i < 1000; i += 2)
+        pool.free(handles[i]);
+
+    int count = 0;
+    int sum = 0;
+    bool valid = true;
+    pool.for_each([&](HandleType handle, int &value) {
+        valid = valid && pool.is_valid(handle) && value % 2 == 1;
+        count++;
+        sum += value;
+    });
+    CHECK(valid);
+    CHECK_EQ(count, 500);
+    CHECK_EQ(sum, 500 * 500);
+    CHECK_EQ(pool.size(), 500);
+}
+
+TEST_CASE("Pool threads")
+{
+    using HandleType = Handle<struct Tag>;
+    static const int THREAD_COUNT = 8;
+    static const int ITERATION_COUNT = 20000;
+
+    Pool<int, HandleType> pool;
+    std::atomic<int> error_count{0};
+
+    // Every thread keeps a window of live objects and checks that no other thread touched them.
+    auto worker = [&](int index) {
+        std::vector<HandleType> handles;
+        for (int i = 0; i < ITERATION_COUNT; ++i) {
+            HandleType handle = pool.alloc();
+            *pool.get(handle) = index;
+            handles.push_back(handle);
+            if (handles.size() > 64 || (i % 7) == 0) {
+                HandleType freed = handles[i % handles.size()];
+                if (*pool.get(freed) != index || !pool.free(freed) || pool.is_valid(freed))
+                    error_count++;
+                handles.erase(handles.begin() + i % handles.size());
+            }
+        }
+        for (HandleType handle : handles) {
+            if (*pool.get(handle) != index || !pool.free(handle))
+                error_count++;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREAD_COUNT; ++i)
+        threads.emplace_back(worker, i);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    CHECK_EQ(error_count.load(), 0);
+    CHECK_EQ(pool.size(), 0);
+}
+
+TEST_CASE("Pool double free")
+{
+    using HandleType = Handle<struct Tag>;
+    static const int THREAD_COUNT = 8;
+
+    Pool<int, HandleType> pool;
+    std::vector<HandleType> handles;
+    for (int i = 0; i < 1000; ++i)
+        handles.push_back(pool.alloc());
+
+    // Concurrent frees of the same handles succeed exactly once.
+    std::atomic<int> free_count{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREAD_COUNT; ++i) {
+        threads.emplace_back([&] {
+            for (HandleType handle : handles)
+                free_count += pool.free(handle) ? 1 : 0;
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    CHECK_EQ(free_count.load(), 1000);
+    CHECK_EQ(pool.size(), 0);
+}
+
+// Previous vector-based pool for comparison.
+template <typename T, typename HandleType>
+class VectorPool {
+public:
+    HandleType alloc()
+    {
+        if (!m_free_list.empty()) {
+            uint32_t id = m_free_list.back();
+            m_free_list.pop_back();
+            return HandleType(id, m_gens[id]);
+        }
+        m_objects.emplace_back();
+        m_gens.emplace_back(1);
+        return HandleType(uint32_t(m_objects.size() - 1), 1);
+    }
+
+    bool free(HandleType handle)
+    {
+        if (!get(handle))
+            return false;
+        m_free_list.push_back(handle.id());
+        m_gens[handle.id()]++;
+        return true;
+    }
+
+    T *get(HandleType handle)
+    {
+        if (handle.id() >= m_objects.size() || handle.gen() != m_gens[handle.id()])
+            return nullptr;
+        return &m_objects[handle.id()];
+    }
+
+private:
+    std::vector<T> m_objects;
+    std::vector<uint32_t> m_gens;
+    std::vector<uint32_t> m_free_list;
+};
+
+template <typename PoolType, typename HandleType>
+double benchmark_pool(int object_count, int iterations)
+{
+    PoolType pool;
+    std::vector<HandleType> handles(object_count);
+    int64_t sum = 0;
+
+    Timer timer;
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        for (HandleType &handle : handles) {
+            handle = pool.alloc();
+            *pool.get(handle) = iteration;
+        }
+        for (HandleType handle : handles)
+            sum += *pool.get(handle);
+        for (HandleType handle : handles)
+            pool.free(handle);
+    }
+    double elapsed = timer.elapsed();
+    CHECK_GE(sum, 0);
+    return elapsed / (double(iterations) * object_count);
+}
+
+TEST_CASE("Pool benchmark" * doctest::skip(true))
+{
+    using HandleType = Handle<struct Tag>;
+    const int object_count = 10000;
+    const int iterations = 1000;
+
+    double vector_time = benchmark_pool<VectorPool<int, HandleType>, HandleType>(object_count, iterations);
+    double chunked_time = benchmark_pool<Pool<int, HandleType>, HandleType>(object_count, iterations);
+    MESSAGE("alloc + get + free: vector pool " << vector_time * 1e9 << "ns, chunked pool " << chunked_time * 1e9
+                                               << "ns");
+
+    // Contended allocation from several threads.
+    static const int THREAD_COUNT = 8;
+    Pool<int, HandleType> pool;
+    Timer timer;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREAD_COUNT; ++i) {
+        threads.emplace_back([&] {
+            std::vector<HandleType> handles(object_count);
+            for (int iteration = 0; iteration < iterations / 10; ++iteration) {
+                for (HandleType &handle : handles)
+                    handle = pool.alloc();
+                for (HandleType handle : handles)
+                    pool.free(handle);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    MESSAGE("alloc + free on " << THREAD_COUNT << " threads: "
+                               << timer.elapsed() / (double(iterations / 10) * object_count * THREAD_COUNT) * 1e9
+                               << "ns");
 }
 
 TEST_SUITE_END();
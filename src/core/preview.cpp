@@ -0,0 +1,119 @@
+#include "preview.h"
+#include "imageio.h"
+#include "resample.h"
+
+#include <algorithm>
+#include <cmath>
+
+FR_NAMESPACE_BEGIN
+
+inline void fit_size(uint32_t width, uint32_t height, uint32_t size, uint32_t &out_width, uint32_t &out_height)
+{
+    uint32_t long_edge = std::max(width, height);
+    if (long_edge <= size) {
+        out_width = width;
+        out_height = height;
+        return;
+    }
+    double scale = double(size) / double(long_edge);
+    out_width = std::max(1u, uint32_t(std::lround(width * scale)));
+    out_height = std::max(1u, uint32_t(std::lround(height * scale)));
+}
+
+size_t PreviewPyramid::find_level(uint32_t size) const
+{
+    FR_ASSERT(!levels.empty());
+    for (size_t i = levels.size(); i-- > 0;) {
+        if (std::max(levels[i].width, levels[i].height) >= size)
+            return i;
+    }
+    return 0;
+}
+
+PreviewPyramid build_preview_pyramid(const uint8_t *rgba, uint32_t width, uint32_t height,
+                                     std::span<const uint32_t> sizes)
+{
+    std::vector<uint32_t> sorted_sizes(sizes.begin(), sizes.end());
+    std::sort(sorted_sizes.begin(), sorted_sizes.end(), std::greater<uint32_t>());
+    sorted_sizes.erase(std::unique(sorted_sizes.begin(), sorted_sizes.end()), sorted_sizes.end());
+
+    PreviewPyramid pyramid;
+    size_t total_size = 0;
+    for (uint32_t size : sorted_sizes) {
+        PreviewLevel level;
+        fit_size(width, height, size, level.width, level.height);
+        level.offset = total_size;
+        total_size += size_t(level.width) * level.height * 4;
+        pyramid.levels.push_back(level);
+    }
+    pyramid.pixels.resize(total_size);
+
+    // Each level is derived from the previous (larger) one. Exact halving is done with the fast 2x2 filter,
+    // the remaining fractional scale with the area filter.
+    const uint8_t *src = rgba;
+    uint32_t src_width = width;
+    uint32_t src_height = height;
+    std::vector<uint8_t> scratch[2];
+    uint32_t scratch_index = 0;
+
+    for (const PreviewLevel &level : pyramid.levels) {
+        while (src_width >= 2 * level.width && src_height >= 2 * level.height) {
+            std::vector<uint8_t> &half = scratch[scratch_index];
+            scratch_index ^= 1;
+            half.resize(size_t(src_width / 2) * (src_height / 2) * 4);
+            downsample_2x_rgba8(src, src_width, src_height, size_t(src_width) * 4, half.data(),
+                                size_t(src_width / 2) * 4);
+            src = half.data();
+            src_width /= 2;
+            src_height /= 2;
+        }
+
+        uint8_t *dst = pyramid.pixels.data() + level.offset;
+        resample_area_rgba8(src, src_width, src_height, size_t(src_width) * 4, dst, level.width, level.height,
+                            size_t(level.width) * 4);
+
+        src = dst;
+        src_width = level.width;
+        src_height = level.height;
+    }
+
+    return pyramid;
+}
+
+std::optional<PreviewPyramid> generate_preview_pyramid(const std::filesystem::path &path,
+                                                       std::span<const uint32_t> sizes)
+{
+    if (sizes.empty())
+        return std::nullopt;
+
+    auto input = ImageInput::open(path);
+    if (!input)
+        return std::nullopt;
+
+    // Pick the smallest decode scale that still covers the largest preview.
+    const uint32_t max_size = *std::max_element(sizes.begin(), sizes.end());
+    const uint32_t long_edge = std::max(input->spec().width, input->spec().height);
+    for (uint32_t scale_denom : {8u, 4u, 2u}) {
+        if ((long_edge + scale_denom - 1) / scale_denom >= max_size && input->set_scale_denom(scale_denom))
+            break;
+    }
+
+    const ImageSpec &spec = input->spec();
+    if (spec.component_type != ComponentType::U8)
+        return std::nullopt;
+
+    const size_t pixel_count = size_t(spec.width) * spec.height;
+    std::vector<uint8_t> pixels(pixel_count * spec.component_count);
+    if (!input->read_image(pixels.data(), pixels.size()))
+        return std::nullopt;
+
+    if (spec.component_count != 4) {
+        std::vector<uint8_t> rgba(pixel_count * 4);
+        convert_to_rgba8(pixels.data(), spec.component_count, pixel_count, rgba.data());
+        pixels = std::move(rgba);
+    }
+
+    return build_preview_pyramid(pixels.data(), spec.width, spec.height, sizes);
+}
+
+FR_NAMESPACE_END
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "defs.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+FR_NAMESPACE_BEGIN
+
+/// Preview sizes (long edge in pixels) used by the UI: screen, filmstrip and grid.
+static constexpr uint32_t DEFAULT_PREVIEW_SIZES[] = {2560, 1024, 256};
+
+struct PreviewLevel {
+    uint32_t width{0};
+    uint32_t height{0};
+    size_t offset{0};  ///< Byte offset into PreviewPyramid::pixels.
+};
+
+/**
+ * Set of downsampled RGBA8 previews of a single image.
+ * All levels are stored together in one tightly packed buffer, sorted from largest to smallest.
+ */
+struct PreviewPyramid {
+    std::vector<PreviewLevel> levels;
+    std::vector<uint8_t> pixels;
+
+    const uint8_t *data(size_t level) const { return pixels.data() + levels[level].offset; }
+
+    /// Find the smallest level with a long edge of at least the given size (or the largest level).
+    size_t find_level(uint32_t size) const;
+};
+
+/**
+ * Build a preview pyramid from decoded RGBA8 pixels.
+ * Levels are derived from each other (largest first), so the cost is dominated by the first level.
+ * @param rgba Source pixels.
+ * @param width Source width.
+ * @param height Source height.
+ * @param sizes Long edge of each level in pixels. Images are never upscaled.
+ * @return Preview pyramid.
+ */
+PreviewPyramid build_preview_pyramid(const uint8_t *rgba, uint32_t width, uint32_t height,
+                                     std::span<const uint32_t> sizes = DEFAULT_PREVIEW_SIZES);
+
+/**
+ * Decode an image file once and build its preview pyramid.
+ * The image is decoded at the smallest scale (e.g. scaled DCT for JPEG) that still covers the largest level.
+ * @param path Image file path.
+ * @param sizes Long edge of each level in pixels.
+ * @return Preview pyramid or std::nullopt if the image could not be decoded.
+ */
+std::optional<PreviewPyramid> generate_preview_pyramid(const std::filesystem::path &path,
+                                                       std::span<const uint32_t> sizes = DEFAULT_PREVIEW_SIZES);
+
+FR_NAMESPACE_END
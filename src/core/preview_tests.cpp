@@ -0,0 +1,98 @@
+#include "preview.h"
+#include "imageio.h"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("preview");
+
+TEST_CASE("build_preview_pyramid")
+{
+    const uint32_t width = 3000;
+    const uint32_t height = 2000;
+    std::vector<uint8_t> rgba(size_t(width) * height * 4, 128);
+
+    const uint32_t sizes[] = {256, 2560, 1024};
+    PreviewPyramid pyramid = build_preview_pyramid(rgba.data(), width, height, sizes);
+
+    REQUIRE_EQ(pyramid.levels.size(), 3);
+    CHECK_EQ(pyramid.levels[0].width, 2560);
+    CHECK_EQ(pyramid.levels[0].height, 1707);
+    CHECK_EQ(pyramid.levels[1].width, 1024);
+    CHECK_EQ(pyramid.levels[1].height, 683);
+    CHECK_EQ(pyramid.levels[2].width, 256);
+    CHECK_EQ(pyramid.levels[2].height, 171);
+
+    size_t total_size = 0;
+    for (const PreviewLevel &level : pyramid.levels)
+        total_size += size_t(level.width) * level.height * 4;
+    CHECK_EQ(pyramid.pixels.size(), total_size);
+    CHECK(std::all_of(pyramid.pixels.begin(), pyramid.pixels.end(), [](uint8_t v) { return v == 128; }));
+
+    CHECK_EQ(pyramid.find_level(200), 2);
+    CHECK_EQ(pyramid.find_level(256), 2);
+    CHECK_EQ(pyramid.find_level(257), 1);
+    CHECK_EQ(pyramid.find_level(5000), 0);
+
+    // Small images are not upscaled.
+    PreviewPyramid small = build_preview_pyramid(rgba.data(), 100, 50, sizes);
+    REQUIRE_EQ(small.levels.size(), 3);
+    CHECK_EQ(small.levels[0].width, 100);
+    CHECK_EQ(small.levels[2].height, 50);
+}
+
+TEST_CASE("generate_preview_pyramid")
+{
+    const uint32_t width = 1024;
+    const uint32_t height = 512;
+    std::vector<uint8_t> rgb(width * height * 3);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint8_t *p = &rgb[(y * width + x) * 3];
+            p[0] = 200;
+            p[1] = 100;
+            p[2] = 50;
+        }
+    }
+
+    {
+        auto output = ImageOutput::open(
+            "test_preview.jpg",
+            {.width = width, .height = height, .component_type = ComponentType::U8, .component_count = 3});
+        REQUIRE(output);
+        REQUIRE(output->write_image(rgb.data(), rgb.size()));
+    }
+
+    {
+        // Decoding at 1/4 scale is sufficient for the largest level.
+        auto input = ImageInput::open("test_preview.jpg");
+        REQUIRE(input);
+        CHECK(input->set_scale_denom(4));
+        CHECK_EQ(input->spec().width, 256);
+        CHECK_EQ(input->spec().height, 128);
+        CHECK_FALSE(input->set_scale_denom(3));
+    }
+
+    const uint32_t sizes[] = {256, 64};
+    auto pyramid = generate_preview_pyramid("test_preview.jpg", sizes);
+    REQUIRE(pyramid);
+    REQUIRE_EQ(pyramid->levels.size(), 2);
+    CHECK_EQ(pyramid->levels[0].width, 256);
+    CHECK_EQ(pyramid->levels[0].height, 128);
+    CHECK_EQ(pyramid->levels[1].width, 64);
+    CHECK_EQ(pyramid->levels[1].height, 32);
+
+    const uint8_t *p = pyramid->data(1) + (16 * 64 + 32) * 4;
+    CHECK_LE(std::abs(p[0] - 200), 3);
+    CHECK_LE(std::abs(p[1] - 100), 3);
+    CHECK_LE(std::abs(p[2] - 50), 3);
+    CHECK_EQ(p[3], 255);
+
+    CHECK_FALSE(generate_preview_pyramid("__file_that_does_not_exist__.jpg"));
+}
+
+TEST_SUITE_END();
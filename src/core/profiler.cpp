@@ -0,0 +1,120 @@
+#include "profiler.h"
+
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+
+FR_NAMESPACE_BEGIN
+
+Profiler::Profiler() : m_epoch(std::chrono::steady_clock::now()) {}
+
+Profiler &Profiler::global()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+double Profiler::now_us() const
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+uint32_t Profiler::register_track(std::string name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_track_names.push_back(std::move(name));
+    return uint32_t(m_track_names.size() - 1);
+}
+
+uint32_t Profiler::thread_track()
+{
+    // Tracks are per profiler, cache the last profiler used by this thread.
+    thread_local const Profiler *profiler = nullptr;
+    thread_local uint32_t track = 0;
+    if (profiler != this) {
+        static std::atomic<uint32_t> thread_count{0};
+        track = register_track("thread " + std::to_string(thread_count++));
+        profiler = this;
+    }
+    return track;
+}
+
+void Profiler::add_event(ProfileEvent event)
+{
+    if (!m_enabled)
+        return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_events.push_back(std::move(event));
+}
+
+std::vector<ProfileEvent> Profiler::events() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_events;
+}
+
+void Profiler::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_events.clear();
+}
+
+std::string Profiler::chrome_trace() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    nlohmann::json trace_events = nlohmann::json::array();
+    for (uint32_t track = 0; track < m_track_names.size(); ++track) {
+        trace_events.push_back({
+            {"name", "thread_name"},
+            {"ph", "M"},
+            {"pid", 1},
+            {"tid", track},
+            {"args", {{"name", m_track_names[track]}}},
+        });
+    }
+    for (const ProfileEvent &event : m_events) {
+        trace_events.push_back({
+            {"name", event.name},
+            {"cat", event.category},
+            {"ph", "X"},
+            {"pid", 1},
+            {"tid", event.track},
+            {"ts", event.start_us},
+            {"dur", event.duration_us},
+        });
+    }
+
+    nlohmann::json trace = {{"traceEvents", trace_events}, {"displayTimeUnit", "ms"}};
+    return trace.dump();
+}
+
+bool Profiler::write_chrome_trace(const std::filesystem::path &path) const
+{
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    file << chrome_trace();
+    return bool(file);
+}
+
+ProfileScope::ProfileScope(const char *name, const char *category)
+    : m_name(name), m_category(category), m_start_us(Profiler::global().now_us())
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+    Profiler &profiler = Profiler::global();
+    if (!profiler.enabled())
+        return;
+    profiler.add_event({
+        .name = m_name,
+        .category = m_category,
+        .track = profiler.thread_track(),
+        .start_us = m_start_us,
+        .duration_us = profiler.now_us() - m_start_us,
+    });
+}
+
+FR_NAMESPACE_END
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "defs.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+FR_NAMESPACE_BEGIN
+
+/// Timed event on a track (a CPU thread or a GPU queue).
+struct ProfileEvent {
+    std::string name;
+    std::string category;
+    uint32_t track{0};
+    double start_us{0.0};     ///< Start time in microseconds since the profiler epoch.
+    double duration_us{0.0};
+};
+
+/**
+ * Collects CPU and GPU timing events and exports them in the Chrome trace event format
+ * (viewable in chrome://tracing or Perfetto).
+ *
+ * Recording is disabled by default, ProfileScope and add_event() are no-ops until set_enabled(true).
+ */
+class Profiler {
+public:
+    Profiler();
+
+    static Profiler &global();
+
+    bool enabled() const { return m_enabled; }
+    void set_enabled(bool enabled) { m_enabled = enabled; }
+
+    /// Current time in microseconds since the profiler epoch.
+    double now_us() const;
+
+    /// Register a named track for events that don't belong to a CPU thread (e.g. a GPU queue).
+    uint32_t register_track(std::string name);
+
+    /// Track of the calling thread, registered on first use.
+    uint32_t thread_track();
+
+    void add_event(ProfileEvent event);
+
+    std::vector<ProfileEvent> events() const;
+    void clear();
+
+    /// Events in Chrome trace event JSON format.
+    std::string chrome_trace() const;
+
+    /**
+     * Write the events to a Chrome trace file.
+     * @return True if successful.
+     */
+    bool write_chrome_trace(const std::filesystem::path &path) const;
+
+private:
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    std::atomic<bool> m_enabled{false};
+    std::chrono::steady_clock::time_point m_epoch;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::string> m_track_names;
+    std::vector<ProfileEvent> m_events;
+};
+
+/// Records the lifetime of the scope as an event on the calling thread's track of the global profiler.
+class ProfileScope {
+public:
+    ProfileScope(const char *name, const char *category = "cpu");
+    ~ProfileScope();
+
+private:
+    const char *m_name;
+    const char *m_category;
+    double m_start_us;
+};
+
+#define FR_PROFILE_CONCAT_INNER(a, b) a##b
+#define FR_PROFILE_CONCAT(a, b) FR_PROFILE_CONCAT_INNER(a, b)
+#define FR_PROFILE_SCOPE(name) ::fr::ProfileScope FR_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+FR_NAMESPACE_END
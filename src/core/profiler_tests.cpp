@@ -0,0 +1,79 @@
+#include "profiler.h"
+
+#include <doctest/doctest.h>
+#include <nlohmann/json.hpp>
+
+#include <thread>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("profiler");
+
+TEST_CASE("Profiler")
+{
+    Profiler &profiler = Profiler::global();
+    profiler.clear();
+
+    SUBCASE("disabled")
+    {
+        profiler.set_enabled(false);
+        {
+            FR_PROFILE_SCOPE("ignored");
+        }
+        CHECK(profiler.events().empty());
+    }
+
+    SUBCASE("scopes")
+    {
+        profiler.set_enabled(true);
+        {
+            FR_PROFILE_SCOPE("outer");
+            {
+                FR_PROFILE_SCOPE("inner");
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        }
+        std::thread([] { FR_PROFILE_SCOPE("worker"); }).join();
+        profiler.set_enabled(false);
+
+        auto events = profiler.events();
+        REQUIRE_EQ(events.size(), 3);
+        CHECK_EQ(events[0].name, "inner");
+        CHECK_EQ(events[1].name, "outer");
+        CHECK_EQ(events[2].name, "worker");
+        CHECK_GE(events[0].duration_us, 2000.0);
+        CHECK_GE(events[1].duration_us, events[0].duration_us);
+        CHECK_LE(events[1].start_us, events[0].start_us);
+        CHECK_EQ(events[0].track, events[1].track);
+        CHECK_NE(events[0].track, events[2].track);
+    }
+
+    SUBCASE("chrome trace")
+    {
+        profiler.set_enabled(true);
+        uint32_t gpu_track = profiler.register_track("gpu");
+        profiler.add_event({.name = "dispatch", .category = "gpu", .track = gpu_track, .start_us = 10.0,
+                            .duration_us = 5.0});
+        profiler.set_enabled(false);
+
+        auto trace = nlohmann::json::parse(profiler.chrome_trace());
+        bool found_track = false;
+        bool found_event = false;
+        for (const auto &event : trace["traceEvents"]) {
+            if (event["ph"] == "M" && event["tid"] == gpu_track && event["args"]["name"] == "gpu")
+                found_track = true;
+            if (event["ph"] == "X" && event["name"] == "dispatch") {
+                CHECK_EQ(event["tid"], gpu_track);
+                CHECK_EQ(event["ts"], 10.0);
+                CHECK_EQ(event["dur"], 5.0);
+                found_event = true;
+            }
+        }
+        CHECK(found_track);
+        CHECK(found_event);
+    }
+
+    profiler.clear();
+}
+
+TEST_SUITE_END();
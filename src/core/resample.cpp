@@ -0,0 +1,192 @@
+#include "resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FR_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define FR_HAS_SSE2 0
+#endif
+
+#if defined(__ARM_NEON)
+#define FR_HAS_NEON 1
+#include <arm_neon.h>
+#else
+#define FR_HAS_NEON 0
+#endif
+
+FR_NAMESPACE_BEGIN
+
+void downsample_2x_rgba8(const uint8_t *src, uint32_t src_width, uint32_t src_height, size_t src_pitch, uint8_t *dst,
+                         size_t dst_pitch)
+{
+    const uint32_t dst_width = src_width / 2;
+    const uint32_t dst_height = src_height / 2;
+
+    for (uint32_t y = 0; y < dst_height; ++y) {
+        const uint8_t *row0 = src + (2 * y) * src_pitch;
+        const uint8_t *row1 = row0 + src_pitch;
+        uint8_t *out = dst + y * dst_pitch;
+
+        uint32_t x = 0;
+
+#if FR_HAS_SSE2
+        // 8 source pixels -> 4 destination pixels per iteration.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i round = _mm_set1_epi16(2);
+        for (; x + 4 <= dst_width; x += 4) {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8 + 16));
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8));
+            __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8 + 16));
+
+            // Vertical sums, two pixels per register.
+            __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+            __m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+            __m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+            __m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+            // Horizontal sums of neighboring pixels.
+            s0 = _mm_add_epi16(s0, _mm_srli_si128(s0, 8));
+            s1 = _mm_add_epi16(s1, _mm_srli_si128(s1, 8));
+            s2 = _mm_add_epi16(s2, _mm_srli_si128(s2, 8));
+            s3 = _mm_add_epi16(s3, _mm_srli_si128(s3, 8));
+
+            __m128i p01 = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s0, s1), round), 2);
+            __m128i p23 = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s2, s3), round), 2);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4), _mm_packus_epi16(p01, p23));
+        }
+#elif FR_HAS_NEON
+        // 8 source pixels -> 4 destination pixels per iteration.
+        for (; x + 4 <= dst_width; x += 4) {
+            uint32x4x2_t a = vld2q_u32(reinterpret_cast<const uint32_t *>(row0 + x * 8));
+            uint32x4x2_t b = vld2q_u32(reinterpret_cast<const uint32_t *>(row1 + x * 8));
+            uint8x16_t a_even = vreinterpretq_u8_u32(a.val[0]);
+            uint8x16_t a_odd = vreinterpretq_u8_u32(a.val[1]);
+            uint8x16_t b_even = vreinterpretq_u8_u32(b.val[0]);
+            uint8x16_t b_odd = vreinterpretq_u8_u32(b.val[1]);
+
+            uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a_even), vget_low_u8(a_odd)),
+                                      vaddl_u8(vget_low_u8(b_even), vget_low_u8(b_odd)));
+            uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a_even), vget_high_u8(a_odd)),
+                                      vaddl_u8(vget_high_u8(b_even), vget_high_u8(b_odd)));
+
+            vst1q_u8(out + x * 4, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+        }
+#endif
+
+        for (; x < dst_width; ++x) {
+            const uint8_t *p0 = row0 + x * 8;
+            const uint8_t *p1 = row1 + x * 8;
+            for (uint32_t c = 0; c < 4; ++c)
+                out[x * 4 + c] = uint8_t((p0[c] + p0[c + 4] + p1[c] + p1[c + 4] + 2) >> 2);
+        }
+    }
+}
+
+/// Filter taps of an area filter along one axis.
+struct AreaFilter {
+    std::vector<uint32_t> start;
+    std::vector<uint32_t> offset;  // offset into weights, one extra entry at the end
+    std::vector<float> weights;
+
+    AreaFilter(uint32_t src_size, uint32_t dst_size)
+    {
+        const double scale = double(src_size) / double(dst_size);
+        start.resize(dst_size);
+        offset.resize(dst_size + 1);
+        for (uint32_t i = 0; i < dst_size; ++i) {
+            double begin = i * scale;
+            double end = std::min(double(src_size), (i + 1) * scale);
+            uint32_t first = uint32_t(begin);
+            uint32_t last = std::min(src_size, uint32_t(std::ceil(end)));
+            start[i] = first;
+            offset[i] = uint32_t(weights.size());
+            for (uint32_t j = first; j < last; ++j) {
+                double coverage = std::min(end, double(j + 1)) - std::max(begin, double(j));
+                weights.push_back(float(coverage / scale));
+            }
+        }
+        offset[dst_size] = uint32_t(weights.size());
+    }
+
+    uint32_t count(uint32_t i) const { return offset[i + 1] - offset[i]; }
+};
+
+void resample_area_rgba8(const uint8_t *src, uint32_t src_width, uint32_t src_height, size_t src_pitch, uint8_t *dst,
+                         uint32_t dst_width, uint32_t dst_height, size_t dst_pitch)
+{
+    FR_ASSERT(dst_width <= src_width && dst_height <= src_height);
+    if (dst_width == 0 || dst_height == 0)
+        return;
+
+    if (dst_width == src_width && dst_height == src_height) {
+        for (uint32_t y = 0; y < dst_height; ++y)
+            std::memcpy(dst + y * dst_pitch, src + y * src_pitch, size_t(dst_width) * 4);
+        return;
+    }
+
+    const AreaFilter filter_x(src_width, dst_width);
+    const AreaFilter filter_y(src_height, dst_height);
+
+    // Vertical pass into a single float row, followed by the horizontal pass.
+    // Both inner loops are simple enough to be auto-vectorized.
+    const size_t row_size = size_t(src_width) * 4;
+    std::vector<float> row(row_size);
+
+    for (uint32_t y = 0; y < dst_height; ++y) {
+        std::fill(row.begin(), row.end(), 0.f);
+        for (uint32_t j = 0; j < filter_y.count(y); ++j) {
+            const uint8_t *src_row = src + (filter_y.start[y] + j) * src_pitch;
+            const float w = filter_y.weights[filter_y.offset[y] + j];
+            float *acc = row.data();
+            for (size_t i = 0; i < row_size; ++i)
+                acc[i] += w * float(src_row[i]);
+        }
+
+        uint8_t *out = dst + y * dst_pitch;
+        for (uint32_t x = 0; x < dst_width; ++x) {
+            float sum[4] = {0.f, 0.f, 0.f, 0.f};
+            const float *in = row.data() + size_t(filter_x.start[x]) * 4;
+            const float *w = filter_x.weights.data() + filter_x.offset[x];
+            for (uint32_t i = 0; i < filter_x.count(x); ++i) {
+                for (uint32_t c = 0; c < 4; ++c)
+                    sum[c] += w[i] * in[i * 4 + c];
+            }
+            for (uint32_t c = 0; c < 4; ++c)
+                out[x * 4 + c] = uint8_t(std::clamp(sum[c] + 0.5f, 0.f, 255.f));
+        }
+    }
+}
+
+void convert_to_rgba8(const uint8_t *src, uint32_t component_count, size_t pixel_count, uint8_t *dst)
+{
+    switch (component_count) {
+        case 1:
+            for (size_t i = 0; i < pixel_count; ++i) {
+                dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = src[i];
+                dst[i * 4 + 3] = 255;
+            }
+            break;
+        case 3:
+            for (size_t i = 0; i < pixel_count; ++i) {
+                dst[i * 4 + 0] = src[i * 3 + 0];
+                dst[i * 4 + 1] = src[i * 3 + 1];
+                dst[i * 4 + 2] = src[i * 3 + 2];
+                dst[i * 4 + 3] = 255;
+            }
+            break;
+        case 4:
+            std::memcpy(dst, src, pixel_count * 4);
+            break;
+        default:
+            FR_ASSERT(false);
+    }
+}
+
+FR_NAMESPACE_END
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "defs.h"
+
+#include <cstddef>
+#include <cstdint>
+
+FR_NAMESPACE_BEGIN
+
+/**
+ * Downsample an 8-bit RGBA image by a factor of two using a 2x2 box filter.
+ * The destination size is (src_width / 2, src_height / 2), a trailing odd row/column is dropped.
+ * @param src Source pixels.
+ * @param src_width Source width.
+ * @param src_height Source height.
+ * @param src_pitch Source row pitch in bytes.
+ * @param dst Destination pixels.
+ * @param dst_pitch Destination row pitch in bytes.
+ */
+void downsample_2x_rgba8(const uint8_t *src, uint32_t src_width, uint32_t src_height, size_t src_pitch, uint8_t *dst,
+                         size_t dst_pitch);
+
+/**
+ * Resize an 8-bit RGBA image to a smaller size using an area (box) filter.
+ * Every destination pixel is the exact average of the source area it covers.
+ * @param src Source pixels.
+ * @param src_width Source width.
+ * @param src_height Source height.
+ * @param src_pitch Source row pitch in bytes.
+ * @param dst Destination pixels.
+ * @param dst_width Destination width (must be <= src_width).
+ * @param dst_height Destination height (must be <= src_height).
+ * @param dst_pitch Destination row pitch in bytes.
+ */
+void resample_area_rgba8(const uint8_t *src, uint32_t src_width, uint32_t src_height, size_t src_pitch, uint8_t *dst,
+                         uint32_t dst_width, uint32_t dst_height, size_t dst_pitch);
+
+/**
+ * Expand 8-bit RGB or grayscale pixels to RGBA with opaque alpha.
+ * @param src Source pixels.
+ * @param component_count Number of source components (1, 3 or 4).
+ * @param pixel_count Number of pixels.
+ * @param dst Destination pixels.
+ */
+void convert_to_rgba8(const uint8_t *src, uint32_t component_count, size_t pixel_count, uint8_t *dst);
+
+FR_NAMESPACE_END
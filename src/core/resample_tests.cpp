@@ -0,0 +1,92 @@
+#include "resample.h"
+
+#include <doctest/doctest.h>
+
+#include <random>
+#include <vector>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("resample");
+
+TEST_CASE("downsample_2x_rgba8")
+{
+    // Odd width exercises both the vectorized and the scalar tail path.
+    const uint32_t width = 37;
+    const uint32_t height = 10;
+    std::vector<uint8_t> src(width * height * 4);
+    std::mt19937 rng;
+    for (auto &v : src)
+        v = rng() & 0xff;
+
+    const uint32_t dst_width = width / 2;
+    const uint32_t dst_height = height / 2;
+    std::vector<uint8_t> dst(dst_width * dst_height * 4);
+    downsample_2x_rgba8(src.data(), width, height, width * 4, dst.data(), dst_width * 4);
+
+    for (uint32_t y = 0; y < dst_height; ++y) {
+        for (uint32_t x = 0; x < dst_width; ++x) {
+            for (uint32_t c = 0; c < 4; ++c) {
+                auto at = [&](uint32_t sx, uint32_t sy) { return src[(sy * width + sx) * 4 + c]; };
+                uint32_t sum =
+                    at(2 * x, 2 * y) + at(2 * x + 1, 2 * y) + at(2 * x, 2 * y + 1) + at(2 * x + 1, 2 * y + 1);
+                CHECK_EQ(dst[(y * dst_width + x) * 4 + c], (sum + 2) / 4);
+            }
+        }
+    }
+}
+
+TEST_CASE("resample_area_rgba8")
+{
+    SUBCASE("constant")
+    {
+        const uint32_t width = 100;
+        const uint32_t height = 70;
+        std::vector<uint8_t> src(width * height * 4);
+        for (size_t i = 0; i < src.size(); ++i)
+            src[i] = uint8_t(10 + (i % 4) * 50);
+
+        const uint32_t dst_width = 33;
+        const uint32_t dst_height = 23;
+        std::vector<uint8_t> dst(dst_width * dst_height * 4);
+        resample_area_rgba8(src.data(), width, height, width * 4, dst.data(), dst_width, dst_height, dst_width * 4);
+
+        for (size_t i = 0; i < dst.size(); ++i)
+            CHECK_EQ(dst[i], uint8_t(10 + (i % 4) * 50));
+    }
+
+    SUBCASE("integer factor")
+    {
+        // 3x reduction averages 3x3 blocks exactly.
+        const uint32_t width = 9;
+        const uint32_t height = 6;
+        std::vector<uint8_t> src(width * height * 4);
+        for (uint32_t y = 0; y < height; ++y)
+            for (uint32_t x = 0; x < width; ++x)
+                for (uint32_t c = 0; c < 4; ++c)
+                    src[(y * width + x) * 4 + c] = uint8_t(x * 10 + y);
+
+        std::vector<uint8_t> dst(3 * 2 * 4);
+        resample_area_rgba8(src.data(), width, height, width * 4, dst.data(), 3, 2, 3 * 4);
+
+        CHECK_EQ(dst[0], 11);
+        CHECK_EQ(dst[(1 * 3 + 2) * 4], 74);
+    }
+}
+
+TEST_CASE("convert_to_rgba8")
+{
+    const uint8_t rgb[] = {1, 2, 3, 4, 5, 6};
+    uint8_t rgba[8];
+    convert_to_rgba8(rgb, 3, 2, rgba);
+    const uint8_t expected[] = {1, 2, 3, 255, 4, 5, 6, 255};
+    CHECK(std::equal(rgba, rgba + 8, expected));
+
+    const uint8_t gray[] = {7};
+    convert_to_rgba8(gray, 1, 1, rgba);
+    CHECK_EQ(rgba[0], 7);
+    CHECK_EQ(rgba[2], 7);
+    CHECK_EQ(rgba[3], 255);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "defs.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <utility>
+
+FR_NAMESPACE_BEGIN
+
+/**
+ * Vector storing up to N elements inline.
+ *
+ * Only grows onto the heap past N elements, so short lists (e.g. the bindings of a dispatch) can be built, copied
+ * and compared without allocating. Iterators and pointers are invalidated by growth and by moves of inline storage.
+ */
+template <typename T, size_t N>
+class SmallVector {
+public:
+    using value_type = T;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    SmallVector() = default;
+
+    SmallVector(std::initializer_list<T> init)
+    {
+        reserve(init.size());
+        std::uninitialized_copy(init.begin(), init.end(), m_data);
+        m_size = init.size();
+    }
+
+    explicit SmallVector(size_t size) { resize(size); }
+
+    SmallVector(const SmallVector &other)
+    {
+        reserve(other.m_size);
+        std::uninitialized_copy(other.begin(), other.end(), m_data);
+        m_size = other.m_size;
+    }
+
+    SmallVector(SmallVector &&other) noexcept { take(other); }
+
+    ~SmallVector()
+    {
+        clear();
+        release();
+    }
+
+    SmallVector &operator=(const SmallVector &other)
+    {
+        if (this != &other) {
+            clear();
+            reserve(other.m_size);
+            std::uninitialized_copy(other.begin(), other.end(), m_data);
+            m_size = other.m_size;
+        }
+        return *this;
+    }
+
+    SmallVector &operator=(SmallVector &&other) noexcept
+    {
+        if (this != &other) {
+            clear();
+            release();
+            take(other);
+        }
+        return *this;
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t capacity() const { return m_capacity; }
+    /// True if the elements are stored inline.
+    bool is_inline() const { return m_data == inline_data(); }
+
+    T *data() { return m_data; }
+    const T *data() const { return m_data; }
+
+    iterator begin() { return m_data; }
+    iterator end() { return m_data + m_size; }
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const { return m_data + m_size; }
+
+    T &operator[](size_t index) { return m_data[index]; }
+    const T &operator[](size_t index) const { return m_data[index]; }
+
+    T &front() { return m_data[0]; }
+    const T &front() const { return m_data[0]; }
+    T &back() { return m_data[m_size - 1]; }
+    const T &back() const { return m_data[m_size - 1]; }
+
+    void reserve(size_t capacity)
+    {
+        if (capacity <= m_capacity)
+            return;
+
+        T *data = std::allocator<T>().allocate(capacity);
+        std::uninitialized_move(m_data, m_data + m_size, data);
+        std::destroy(m_data, m_data + m_size);
+        release();
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    void resize(size_t size)
+    {
+        if (size < m_size) {
+            std::destroy(m_data + size, m_data + m_size);
+        } else if (size > m_size) {
+            reserve(size);
+            std::uninitialized_value_construct(m_data + m_size, m_data + size);
+        }
+        m_size = size;
+    }
+
+    void push_back(const T &value) { emplace_back(value); }
+    void push_back(T &&value) { emplace_back(std::move(value)); }
+
+    template <typename... Args>
+    T &emplace_back(Args &&...args)
+    {
+        if (m_size == m_capacity) {
+            // construct first, args may reference an element
+            T value(std::forward<Args>(args)...);
+            reserve(m_capacity * 2);
+            return *new (m_data + m_size++) T(std::move(value));
+        }
+        return *new (m_data + m_size++) T(std::forward<Args>(args)...);
+    }
+
+    void pop_back() { std::destroy_at(m_data + --m_size); }
+
+    /// Destroy the elements, the capacity is kept.
+    void clear()
+    {
+        std::destroy(m_data, m_data + m_size);
+        m_size = 0;
+    }
+
+    bool operator==(const SmallVector &other) const
+    {
+        return m_size == other.m_size && std::equal(begin(), end(), other.begin());
+    }
+
+private:
+    T *inline_data() { return reinterpret_cast<T *>(m_storage); }
+    const T *inline_data() const { return reinterpret_cast<const T *>(m_storage); }
+
+    /// Free heap storage and switch back to the inline storage, the elements must have been destroyed.
+    void release()
+    {
+        if (!is_inline())
+            std::allocator<T>().deallocate(m_data, m_capacity);
+        m_data = inline_data();
+        m_capacity = N;
+    }
+
+    /// Move the contents of other into this empty vector with inline storage, other is left empty.
+    void take(SmallVector &other)
+    {
+        if (other.is_inline()) {
+            std::uninitialized_move(other.begin(), other.end(), m_data);
+            m_size = other.m_size;
+            other.clear();
+        } else {
+            m_data = std::exchange(other.m_data, other.inline_data());
+            m_size = std::exchange(other.m_size, 0);
+            m_capacity = std::exchange(other.m_capacity, N);
+        }
+    }
+
+    alignas(T) std::byte m_storage[N * sizeof(T)];
+    T *m_data{inline_data()};
+    size_t m_size{0};
+    size_t m_capacity{N};
+};
+
+FR_NAMESPACE_END
@@ -0,0 +1,70 @@
+#include "small_vector.h"
+
+#include <doctest/doctest.h>
+
+#include <memory>
+#include <string>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("small_vector");
+
+TEST_CASE("SmallVector")
+{
+    SUBCASE("inline")
+    {
+        SmallVector<int, 4> v{1, 2, 3};
+        CHECK(v.is_inline());
+        CHECK_EQ(v.size(), 3);
+        CHECK_EQ(v.capacity(), 4);
+        v.push_back(4);
+        CHECK(v.is_inline());
+        CHECK_EQ(v.back(), 4);
+
+        SmallVector<int, 4> copy = v;
+        CHECK(copy.is_inline());
+        CHECK_EQ(copy, v);
+        copy[0] = 10;
+        CHECK_FALSE(copy == v);
+    }
+
+    SUBCASE("heap")
+    {
+        SmallVector<std::string, 2> v;
+        for (int i = 0; i < 8; ++i)
+            v.emplace_back(std::to_string(i));
+        CHECK_FALSE(v.is_inline());
+        CHECK_EQ(v.size(), 8);
+        CHECK_EQ(v.capacity(), 8);
+        CHECK_EQ(v[7], "7");
+
+        // growing while pushing one of its own elements
+        v.push_back(v[0]);
+        CHECK_EQ(v.back(), "0");
+
+        SmallVector<std::string, 2> moved = std::move(v);
+        CHECK_EQ(moved.size(), 9);
+        CHECK(v.empty());
+        CHECK(v.is_inline());
+
+        moved.resize(1);
+        CHECK_EQ(moved.size(), 1);
+        CHECK_EQ(moved[0], "0");
+        moved.clear();
+        CHECK(moved.empty());
+        CHECK_EQ(moved.capacity(), 16);
+    }
+
+    SUBCASE("move inline elements")
+    {
+        SmallVector<std::unique_ptr<int>, 2> v;
+        v.push_back(std::make_unique<int>(1));
+        SmallVector<std::unique_ptr<int>, 2> moved;
+        moved = std::move(v);
+        REQUIRE_EQ(moved.size(), 1);
+        CHECK_EQ(*moved[0], 1);
+        CHECK(v.empty());
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,89 @@
+#include "thumbnail_cache.h"
+
+FR_NAMESPACE_BEGIN
+
+ThumbnailCache::ThumbnailCache(size_t budget_bytes) : m_budget(budget_bytes) {}
+
+ThumbnailCache::~ThumbnailCache() { set_memory_budget(nullptr); }
+
+CompressedThumbnailPtr ThumbnailCache::get(const ImageCacheKey &key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_map.find(key);
+    if (it == m_map.end())
+        return nullptr;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->thumbnail;
+}
+
+CompressedThumbnailPtr ThumbnailCache::insert(const ImageCacheKey &key, CompressedThumbnail thumbnail)
+{
+    const size_t size = thumbnail.size_bytes();
+    CompressedThumbnailPtr thumbnail_ptr = std::make_shared<const CompressedThumbnail>(std::move(thumbnail));
+
+    // The global budget might evict from this cache, so it is asked without holding the lock.
+    if (size > m_budget || (m_memory_budget && !m_memory_budget->request(size)))
+        return thumbnail_ptr;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_map.find(key); it != m_map.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->thumbnail;
+    }
+
+    if (m_size + size > m_budget && evict_locked(m_size + size - m_budget) < m_size + size - m_budget)
+        return thumbnail_ptr;
+
+    m_lru.push_front({key, thumbnail_ptr});
+    m_map.emplace(key, m_lru.begin());
+    m_size += size;
+    return thumbnail_ptr;
+}
+
+size_t ThumbnailCache::evict(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return evict_locked(bytes);
+}
+
+void ThumbnailCache::set_memory_budget(MemoryBudget *budget, MemoryPriority priority)
+{
+    if (m_memory_budget)
+        m_memory_budget->unregister_consumer(m_consumer_id);
+    m_memory_budget = budget;
+    if (m_memory_budget)
+        m_consumer_id = m_memory_budget->register_consumer("thumbnails", this, priority);
+}
+
+size_t ThumbnailCache::size_bytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+}
+
+size_t ThumbnailCache::entry_count() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_map.size();
+}
+
+size_t ThumbnailCache::evict_locked(size_t bytes)
+{
+    size_t freed = 0;
+    auto it = m_lru.end();
+    while (it != m_lru.begin() && freed < bytes) {
+        --it;
+        // Pinned, new references are only handed out with the lock held.
+        if (it->thumbnail.use_count() > 1)
+            continue;
+
+        const size_t size = it->thumbnail->size_bytes();
+        freed += size;
+        m_size -= size;
+        m_map.erase(it->key);
+        it = m_lru.erase(it);
+    }
+    return freed;
+}
+
+FR_NAMESPACE_END
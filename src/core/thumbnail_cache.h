@@ -0,0 +1,88 @@
+#pragma once
+
+#include "defs.h"
+#include "image_cache.h"
+#include "memory_budget.h"
+#include "thumbnail_codec.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+FR_NAMESPACE_BEGIN
+
+using CompressedThumbnailPtr = std::shared_ptr<const CompressedThumbnail>;
+
+/**
+ * Thread-safe LRU cache of compressed thumbnails with a byte budget.
+ *
+ * Thumbnails are keyed by the identity of their image file (ImageCacheKey). As in ImageCache, entries are pinned
+ * while a returned pointer is alive, and a thumbnail that does not fit the budget is returned but not cached. With
+ * set_memory_budget() the cache takes part in a global MemoryBudget.
+ */
+class ThumbnailCache : public MemoryConsumer {
+public:
+    /**
+     * Constructor.
+     * @param budget_bytes Maximum number of bytes of compressed data held by the cache.
+     */
+    ThumbnailCache(size_t budget_bytes);
+    ~ThumbnailCache();
+
+    /// Look up a thumbnail. Returns nullptr on a miss.
+    CompressedThumbnailPtr get(const ImageCacheKey &key);
+
+    /**
+     * Insert a thumbnail. If the key is already present, the existing entry is returned.
+     * @return Pointer to the cached thumbnail (or the uncached thumbnail if it did not fit the budget).
+     */
+    CompressedThumbnailPtr insert(const ImageCacheKey &key, CompressedThumbnail thumbnail);
+
+    /**
+     * Evict unpinned entries in LRU order.
+     * @param bytes Number of bytes to free.
+     * @return Number of bytes actually freed.
+     */
+    size_t evict(size_t bytes);
+
+    /**
+     * Register the cache as a consumer of a memory budget, replacing a previous one.
+     * Must not be called concurrently with insert().
+     * @param budget Budget, must outlive the cache or be detached with nullptr.
+     * @param priority Eviction priority.
+     */
+    void set_memory_budget(MemoryBudget *budget, MemoryPriority priority = MemoryPriority::Normal);
+
+    size_t budget() const { return m_budget; }
+    size_t size_bytes() const;
+    size_t entry_count() const;
+
+    // MemoryConsumer
+    size_t memory_usage() const override { return size_bytes(); }
+    size_t evict_memory(size_t bytes) override { return evict(bytes); }
+
+private:
+    ThumbnailCache(const ThumbnailCache &) = delete;
+    ThumbnailCache &operator=(const ThumbnailCache &) = delete;
+
+    struct Entry {
+        ImageCacheKey key;
+        CompressedThumbnailPtr thumbnail;
+    };
+
+    size_t evict_locked(size_t bytes);
+
+    size_t m_budget;
+
+    mutable std::mutex m_mutex;
+    // Most recently used entry at the front.
+    std::list<Entry> m_lru;
+    std::unordered_map<ImageCacheKey, std::list<Entry>::iterator, ImageCacheKeyHash> m_map;
+    size_t m_size{0};
+
+    MemoryBudget *m_memory_budget{nullptr};
+    MemoryBudget::ConsumerId m_consumer_id{0};
+};
+
+FR_NAMESPACE_END
@@ -0,0 +1,73 @@
+#include "thumbnail_cache.h"
+
+#include <doctest/doctest.h>
+
+using namespace fr;
+
+static CompressedThumbnail make_thumbnail(size_t size, uint8_t value = 0)
+{
+    CompressedThumbnail thumbnail;
+    thumbnail.format = ThumbnailFormat::Lossless;
+    thumbnail.data.resize(size, value);
+    return thumbnail;
+}
+
+TEST_SUITE_BEGIN("thumbnail_cache");
+
+TEST_CASE("ThumbnailCache")
+{
+    SUBCASE("lru eviction")
+    {
+        ThumbnailCache cache(300);
+
+        CHECK_EQ(cache.get({.path = "a"}), nullptr);
+        cache.insert({.path = "a"}, make_thumbnail(100, 1));
+        cache.insert({.path = "b"}, make_thumbnail(100, 2));
+        cache.insert({.path = "c"}, make_thumbnail(100, 3));
+        CHECK_EQ(cache.size_bytes(), 300);
+
+        // "a" becomes the most recently used entry, "b" is evicted.
+        REQUIRE(cache.get({.path = "a"}));
+        cache.insert({.path = "d"}, make_thumbnail(100, 4));
+        CHECK_EQ(cache.entry_count(), 3);
+        CHECK_EQ(cache.get({.path = "b"}), nullptr);
+        CHECK_EQ(cache.get({.path = "a"})->data[0], 1);
+
+        // Larger than the budget, returned but not cached.
+        CompressedThumbnailPtr large = cache.insert({.path = "e"}, make_thumbnail(400));
+        CHECK(large);
+        CHECK_EQ(cache.get({.path = "e"}), nullptr);
+    }
+
+    SUBCASE("pinned entries")
+    {
+        ThumbnailCache cache(200);
+        CompressedThumbnailPtr a = cache.insert({.path = "a"}, make_thumbnail(100));
+        CompressedThumbnailPtr b = cache.insert({.path = "b"}, make_thumbnail(100));
+        CHECK_EQ(cache.evict(200), 0);
+
+        b.reset();
+        CHECK_EQ(cache.evict(200), 100);
+        CHECK(cache.get({.path = "a"}));
+    }
+
+    SUBCASE("memory budget")
+    {
+        MemoryBudget budget(1000);
+        budget.set_watermarks(0.5f, 0.2f);
+        ThumbnailCache cache(1000);
+        cache.set_memory_budget(&budget);
+        CHECK_EQ(budget.usage_report()[0].name, "thumbnails");
+
+        // Inserts request room from the budget, which evicts older thumbnails.
+        for (const char *path : {"a", "b", "c"})
+            cache.insert({.path = path}, make_thumbnail(200));
+        CHECK_EQ(cache.size_bytes(), 400);
+        CHECK_EQ(cache.get({.path = "a"}), nullptr);
+
+        cache.set_memory_budget(nullptr);
+        CHECK(budget.usage_report().empty());
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,484 @@
+#include "thumbnail_codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FR_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define FR_HAS_SSE2 0
+#endif
+
+FR_NAMESPACE_BEGIN
+
+// ----------------------------------------------------------------------------
+// BC1
+// ----------------------------------------------------------------------------
+
+inline uint16_t to_565(const uint8_t *c)
+{
+    return uint16_t(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+inline void from_565(uint16_t v, int *c)
+{
+    int r = (v >> 11) & 31;
+    int g = (v >> 5) & 63;
+    int b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+/// Compute per-channel minimum and maximum of a 4x4 block of RGBA pixels.
+inline void block_min_max(const uint8_t *block, uint8_t *min_color, uint8_t *max_color)
+{
+#if FR_HAS_SSE2
+    const __m128i *p = reinterpret_cast<const __m128i *>(block);
+    __m128i p0 = _mm_loadu_si128(p + 0);
+    __m128i p1 = _mm_loadu_si128(p + 1);
+    __m128i p2 = _mm_loadu_si128(p + 2);
+    __m128i p3 = _mm_loadu_si128(p + 3);
+    __m128i lo = _mm_min_epu8(_mm_min_epu8(p0, p1), _mm_min_epu8(p2, p3));
+    __m128i hi = _mm_max_epu8(_mm_max_epu8(p0, p1), _mm_max_epu8(p2, p3));
+    lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+    lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+    hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+    hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+    uint32_t lo_bits = uint32_t(_mm_cvtsi128_si32(lo));
+    uint32_t hi_bits = uint32_t(_mm_cvtsi128_si32(hi));
+    std::memcpy(min_color, &lo_bits, 4);
+    std::memcpy(max_color, &hi_bits, 4);
+#else
+    for (uint32_t c = 0; c < 4; ++c) {
+        min_color[c] = 255;
+        max_color[c] = 0;
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            min_color[c] = std::min(min_color[c], block[i * 4 + c]);
+            max_color[c] = std::max(max_color[c], block[i * 4 + c]);
+        }
+    }
+#endif
+}
+
+/// Encode a single 4x4 block of RGBA pixels using bounding box endpoints (real-time DXT style).
+inline void encode_bc1_block(const uint8_t *block, uint8_t *dst)
+{
+    uint8_t min_color[4];
+    uint8_t max_color[4];
+    block_min_max(block, min_color, max_color);
+
+    // Inset the bounding box to reduce the error of the interpolated colors.
+    for (uint32_t c = 0; c < 3; ++c) {
+        int inset = (max_color[c] - min_color[c]) >> 4;
+        min_color[c] = uint8_t(min_color[c] + inset);
+        max_color[c] = uint8_t(max_color[c] - inset);
+    }
+
+    // Select the bounding box diagonal that follows the colors: flip red and blue if they are
+    // anti-correlated with green.
+    int center[3];
+    for (uint32_t c = 0; c < 3; ++c)
+        center[c] = (min_color[c] + max_color[c] + 1) >> 1;
+    int cov_rg = 0;
+    int cov_bg = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        int g = block[i * 4 + 1] - center[1];
+        cov_rg += (block[i * 4 + 0] - center[0]) * g;
+        cov_bg += (block[i * 4 + 2] - center[2]) * g;
+    }
+    if (cov_rg < 0)
+        std::swap(min_color[0], max_color[0]);
+    if (cov_bg < 0)
+        std::swap(min_color[2], max_color[2]);
+
+    uint16_t c0 = to_565(max_color);
+    uint16_t c1 = to_565(min_color);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int p0[3];
+        int p1[3];
+        from_565(c0, p0);
+        from_565(c1, p1);
+        int dir[3] = {p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2]};
+        int len2 = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+
+        // Project each pixel onto the endpoint axis and quantize to the 4 palette entries.
+        // Palette order is p0, p1, (2 * p0 + p1) / 3, (p0 + 2 * p1) / 3.
+        static const uint32_t INDEX_MAP[4] = {1, 3, 2, 0};
+        for (uint32_t i = 0; i < 16; ++i) {
+            const uint8_t *p = block + i * 4;
+            int t = (p[0] - p1[0]) * dir[0] + (p[1] - p1[1]) * dir[1] + (p[2] - p1[2]) * dir[2];
+            int s = len2 > 0 ? (t * 6 + len2) / (2 * len2) : 0;
+            s = std::clamp(s, 0, 3);
+            indices |= INDEX_MAP[s] << (2 * i);
+        }
+    }
+
+    dst[0] = uint8_t(c0 & 0xff);
+    dst[1] = uint8_t(c0 >> 8);
+    dst[2] = uint8_t(c1 & 0xff);
+    dst[3] = uint8_t(c1 >> 8);
+    std::memcpy(dst + 4, &indices, 4);
+}
+
+void encode_bc1(const uint8_t *rgba, uint32_t width, uint32_t height, size_t pitch, uint8_t *blocks)
+{
+    const uint32_t block_count_x = (width + 3) / 4;
+    const uint32_t block_count_y = (height + 3) / 4;
+
+    alignas(16) uint8_t block[64];
+    for (uint32_t by = 0; by < block_count_y; ++by) {
+        for (uint32_t bx = 0; bx < block_count_x; ++bx) {
+            // Gather block, replicating edge pixels for partial blocks.
+            for (uint32_t y = 0; y < 4; ++y) {
+                const uint8_t *row = rgba + std::min(by * 4 + y, height - 1) * pitch;
+                if (bx * 4 + 4 <= width) {
+                    std::memcpy(block + y * 16, row + bx * 16, 16);
+                } else {
+                    for (uint32_t x = 0; x < 4; ++x)
+                        std::memcpy(block + y * 16 + x * 4, row + std::min(bx * 4 + x, width - 1) * 4, 4);
+                }
+            }
+            encode_bc1_block(block, blocks);
+            blocks += 8;
+        }
+    }
+}
+
+void decode_bc1(const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *rgba, size_t pitch)
+{
+    const uint32_t block_count_x = (width + 3) / 4;
+    const uint32_t block_count_y = (height + 3) / 4;
+
+    for (uint32_t by = 0; by < block_count_y; ++by) {
+        for (uint32_t bx = 0; bx < block_count_x; ++bx) {
+            uint16_t c0 = uint16_t(blocks[0] | (blocks[1] << 8));
+            uint16_t c1 = uint16_t(blocks[2] | (blocks[3] << 8));
+            uint32_t indices;
+            std::memcpy(&indices, blocks + 4, 4);
+            blocks += 8;
+
+            int endpoints[2][3];
+            from_565(c0, endpoints[0]);
+            from_565(c1, endpoints[1]);
+            uint8_t palette[4][4];
+            for (uint32_t c = 0; c < 3; ++c) {
+                int e0 = endpoints[0][c];
+                int e1 = endpoints[1][c];
+                palette[0][c] = uint8_t(e0);
+                palette[1][c] = uint8_t(e1);
+                palette[2][c] = uint8_t(c0 > c1 ? (2 * e0 + e1) / 3 : (e0 + e1) / 2);
+                palette[3][c] = uint8_t(c0 > c1 ? (e0 + 2 * e1) / 3 : 0);
+            }
+            palette[0][3] = palette[1][3] = palette[2][3] = 255;
+            palette[3][3] = c0 > c1 ? 255 : 0;
+
+            const uint32_t block_width = std::min(4u, width - bx * 4);
+            const uint32_t block_height = std::min(4u, height - by * 4);
+            for (uint32_t y = 0; y < block_height; ++y) {
+                uint8_t *row = rgba + (by * 4 + y) * pitch + bx * 16;
+                for (uint32_t x = 0; x < block_width; ++x)
+                    std::memcpy(row + x * 4, palette[(indices >> (2 * (y * 4 + x))) & 3], 4);
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Lossless
+// ----------------------------------------------------------------------------
+
+// Pixels are decorrelated (R - G, G, B - G, A) and split into planes. Every plane row is
+// predicted from the plane row above, the zigzag encoded residuals are bit-packed in groups
+// of 16 values using the minimal bit width of each group. A group with bit width b takes
+// exactly 2 * b bytes, the bit widths are stored as nibbles in front of each plane row.
+// Reconstruction (unzigzag, prediction and color transform) works on 16 pixels at a time.
+
+static constexpr uint32_t GROUP_SIZE = 16;
+static constexpr uint32_t PLANE_COUNT = 4;
+
+inline uint32_t padded_width(uint32_t width) { return (width + GROUP_SIZE - 1) / GROUP_SIZE * GROUP_SIZE; }
+
+inline uint32_t bit_width(uint8_t v)
+{
+    uint32_t bits = 0;
+    while (v) {
+        bits++;
+        v >>= 1;
+    }
+    return bits;
+}
+
+inline void pack_group(const uint8_t *values, uint32_t bits, uint8_t *dst)
+{
+    uint64_t words[2] = {0, 0};
+    for (uint32_t i = 0; i < GROUP_SIZE; ++i) {
+        uint32_t pos = i * bits;
+        uint64_t v = values[i];
+        if (pos < 64) {
+            words[0] |= v << pos;
+            if (pos + bits > 64)
+                words[1] |= v >> (64 - pos);
+        } else {
+            words[1] |= v << (pos - 64);
+        }
+    }
+    std::memcpy(dst, words, 2 * bits);
+}
+
+template <uint32_t BITS>
+inline void unpack_group_bits(const uint8_t *src, uint8_t *values)
+{
+    uint64_t words[2] = {0, 0};
+    std::memcpy(words, src, 2 * BITS);
+    constexpr uint64_t MASK = (1u << BITS) - 1;
+    // Fully unrolled with constant shifts for each bit width.
+    for (uint32_t i = 0; i < GROUP_SIZE; ++i) {
+        const uint32_t pos = i * BITS;
+        uint64_t v;
+        if (pos < 64) {
+            v = words[0] >> pos;
+            if (pos > 0 && pos + BITS > 64)
+                v |= words[1] << ((64 - pos) & 63);
+        } else {
+            v = words[1] >> ((pos - 64) & 63);
+        }
+        values[i] = uint8_t(v & MASK);
+    }
+}
+
+inline void unpack_group(const uint8_t *src, uint32_t bits, uint8_t *values)
+{
+    switch (bits) {
+        case 0:
+            std::memset(values, 0, GROUP_SIZE);
+            break;
+        case 1:
+            unpack_group_bits<1>(src, values);
+            break;
+        case 2:
+            unpack_group_bits<2>(src, values);
+            break;
+        case 3:
+            unpack_group_bits<3>(src, values);
+            break;
+        case 4:
+            unpack_group_bits<4>(src, values);
+            break;
+        case 5:
+            unpack_group_bits<5>(src, values);
+            break;
+        case 6:
+            unpack_group_bits<6>(src, values);
+            break;
+        case 7:
+            unpack_group_bits<7>(src, values);
+            break;
+        case 8:
+            std::memcpy(values, src, GROUP_SIZE);
+            break;
+    }
+}
+
+inline uint8_t zigzag(uint8_t d) { return uint8_t((d << 1) ^ uint8_t(int8_t(d) >> 7)); }
+
+/// Reconstruct a plane row: row[i] += unzigzag(residual[i]). Length must be a multiple of GROUP_SIZE.
+inline void apply_residuals(const uint8_t *residuals, uint8_t *row, uint32_t length)
+{
+    uint32_t i = 0;
+#if FR_HAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i low_bits = _mm_set1_epi8(0x7f);
+    for (; i < length; i += 16) {
+        __m128i z = _mm_loadu_si128(reinterpret_cast<const __m128i *>(residuals + i));
+        __m128i d = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(z, 1), low_bits),
+                                  _mm_sub_epi8(zero, _mm_and_si128(z, one)));
+        __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(row + i), _mm_add_epi8(r, d));
+    }
+#endif
+    for (; i < length; ++i)
+        row[i] = uint8_t(row[i] + ((residuals[i] >> 1) ^ uint8_t(0 - (residuals[i] & 1))));
+}
+
+/// Undo the color transform and interleave planes into RGBA pixels.
+inline void interleave_planes(const uint8_t *const *planes, uint32_t width, uint8_t *rgba)
+{
+    const uint8_t *gp = planes[0];
+    const uint8_t *rp = planes[1];
+    const uint8_t *bp = planes[2];
+    const uint8_t *ap = planes[3];
+
+    uint32_t x = 0;
+#if FR_HAS_SSE2
+    for (; x + 16 <= width; x += 16) {
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(gp + x));
+        __m128i r = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rp + x)), g);
+        __m128i b = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bp + x)), g);
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ap + x));
+        __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+        __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+        __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+        __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+        __m128i *dst = reinterpret_cast<__m128i *>(rgba + x * 4);
+        _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+        _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+    }
+#endif
+    for (; x < width; ++x) {
+        rgba[x * 4 + 0] = uint8_t(rp[x] + gp[x]);
+        rgba[x * 4 + 1] = gp[x];
+        rgba[x * 4 + 2] = uint8_t(bp[x] + gp[x]);
+        rgba[x * 4 + 3] = ap[x];
+    }
+}
+
+static std::vector<uint8_t> encode_lossless(const uint8_t *rgba, uint32_t width, uint32_t height)
+{
+    const uint32_t stride = padded_width(width);
+    const uint32_t group_count = stride / GROUP_SIZE;
+
+    std::vector<uint8_t> prev(PLANE_COUNT * stride, 0);
+    std::vector<uint8_t> cur(PLANE_COUNT * stride, 0);
+    std::vector<uint8_t> residuals(stride);
+    std::vector<uint8_t> out;
+    out.reserve(size_t(width) * height * 2);
+
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *row = rgba + size_t(y) * width * 4;
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint8_t *p = row + x * 4;
+            cur[0 * stride + x] = p[1];
+            cur[1 * stride + x] = uint8_t(p[0] - p[1]);
+            cur[2 * stride + x] = uint8_t(p[2] - p[1]);
+            cur[3 * stride + x] = p[3];
+        }
+
+        for (uint32_t plane = 0; plane < PLANE_COUNT; ++plane) {
+            const uint8_t *c = cur.data() + plane * stride;
+            const uint8_t *p = prev.data() + plane * stride;
+            for (uint32_t x = 0; x < stride; ++x)
+                residuals[x] = zigzag(uint8_t(c[x] - p[x]));
+
+            size_t header = out.size();
+            out.resize(header + (group_count + 1) / 2, 0);
+            for (uint32_t g = 0; g < group_count; ++g) {
+                const uint8_t *values = residuals.data() + g * GROUP_SIZE;
+                uint8_t max_value = *std::max_element(values, values + GROUP_SIZE);
+                uint32_t bits = bit_width(max_value);
+                out[header + g / 2] |= uint8_t(bits << ((g & 1) * 4));
+                size_t offset = out.size();
+                out.resize(offset + 2 * bits);
+                if (bits > 0)
+                    pack_group(values, bits, out.data() + offset);
+            }
+        }
+
+        std::swap(prev, cur);
+    }
+
+    return out;
+}
+
+static bool decode_lossless(const std::vector<uint8_t> &data, uint32_t width, uint32_t height, uint8_t *rgba)
+{
+    const uint32_t stride = padded_width(width);
+    const uint32_t group_count = stride / GROUP_SIZE;
+
+    std::vector<uint8_t> planes(PLANE_COUNT * stride, 0);
+    std::vector<uint8_t> residuals(stride);
+    const uint8_t *plane_ptrs[PLANE_COUNT];
+    for (uint32_t plane = 0; plane < PLANE_COUNT; ++plane)
+        plane_ptrs[plane] = planes.data() + plane * stride;
+
+    const uint8_t *src = data.data();
+    const uint8_t *end = src + data.size();
+
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t plane = 0; plane < PLANE_COUNT; ++plane) {
+            const uint8_t *header = src;
+            src += (group_count + 1) / 2;
+            if (src > end)
+                return false;
+            for (uint32_t g = 0; g < group_count; ++g) {
+                uint32_t bits = (header[g / 2] >> ((g & 1) * 4)) & 0xf;
+                if (bits > 8 || src + 2 * bits > end)
+                    return false;
+                unpack_group(src, bits, residuals.data() + g * GROUP_SIZE);
+                src += 2 * bits;
+            }
+            apply_residuals(residuals.data(), planes.data() + plane * stride, stride);
+        }
+
+        interleave_planes(plane_ptrs, width, rgba + size_t(y) * width * 4);
+    }
+
+    return src == end;
+}
+
+// ----------------------------------------------------------------------------
+// CompressedThumbnail
+// ----------------------------------------------------------------------------
+
+CompressedThumbnail compress_thumbnail(const uint8_t *rgba, uint32_t width, uint32_t height, ThumbnailFormat format)
+{
+    CompressedThumbnail thumbnail;
+    thumbnail.format = format;
+    thumbnail.width = width;
+    thumbnail.height = height;
+
+    if (width == 0 || height == 0)
+        return thumbnail;
+
+    switch (format) {
+        case ThumbnailFormat::RGBA8:
+            thumbnail.data.assign(rgba, rgba + size_t(width) * height * 4);
+            break;
+        case ThumbnailFormat::BC1:
+            thumbnail.data.resize(bc1_size(width, height));
+            encode_bc1(rgba, width, height, size_t(width) * 4, thumbnail.data.data());
+            break;
+        case ThumbnailFormat::Lossless:
+            thumbnail.data = encode_lossless(rgba, width, height);
+            break;
+    }
+
+    thumbnail.data.shrink_to_fit();
+    return thumbnail;
+}
+
+bool decompress_thumbnail(const CompressedThumbnail &thumbnail, uint8_t *rgba)
+{
+    const size_t size = size_t(thumbnail.width) * thumbnail.height * 4;
+    if (size == 0)
+        return true;
+
+    switch (thumbnail.format) {
+        case ThumbnailFormat::RGBA8:
+            if (thumbnail.data.size() != size)
+                return false;
+            std::memcpy(rgba, thumbnail.data.data(), size);
+            return true;
+        case ThumbnailFormat::BC1:
+            if (thumbnail.data.size() != bc1_size(thumbnail.width, thumbnail.height))
+                return false;
+            decode_bc1(thumbnail.data.data(), thumbnail.width, thumbnail.height, rgba, size_t(thumbnail.width) * 4);
+            return true;
+        case ThumbnailFormat::Lossless:
+            return decode_lossless(thumbnail.data, thumbnail.width, thumbnail.height, rgba);
+    }
+
+    return false;
+}
+
+FR_NAMESPACE_END
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "defs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+FR_NAMESPACE_BEGIN
+
+enum class ThumbnailFormat : uint32_t {
+    RGBA8,     ///< Uncompressed, 4 bytes per pixel.
+    BC1,       ///< Block compressed (lossy), 0.5 bytes per pixel, can be uploaded to GPU textures directly.
+    Lossless,  ///< Vertical prediction with bit-packed residuals, fast (SIMD) decode.
+};
+
+/**
+ * Compressed in-memory representation of an RGBA8 thumbnail.
+ */
+struct CompressedThumbnail {
+    ThumbnailFormat format{ThumbnailFormat::RGBA8};
+    uint32_t width{0};
+    uint32_t height{0};
+    std::vector<uint8_t> data;
+
+    size_t size_bytes() const { return data.size(); }
+};
+
+/**
+ * Compress an RGBA8 image.
+ * @param rgba Source pixels (tightly packed).
+ * @param width Image width.
+ * @param height Image height.
+ * @param format Compressed format.
+ * @return Compressed thumbnail.
+ */
+CompressedThumbnail compress_thumbnail(const uint8_t *rgba, uint32_t width, uint32_t height, ThumbnailFormat format);
+
+/**
+ * Decompress a thumbnail to RGBA8.
+ * @param thumbnail Compressed thumbnail.
+ * @param rgba Destination pixels (width * height * 4 bytes, tightly packed).
+ * @return True if successful.
+ */
+bool decompress_thumbnail(const CompressedThumbnail &thumbnail, uint8_t *rgba);
+
+/// Size in bytes of BC1 data for an image (4x4 blocks, 8 bytes each).
+inline size_t bc1_size(uint32_t width, uint32_t height) { return size_t((width + 3) / 4) * ((height + 3) / 4) * 8; }
+
+/**
+ * Encode an RGBA8 image to BC1 (alpha is ignored).
+ * @param rgba Source pixels.
+ * @param width Image width.
+ * @param height Image height.
+ * @param pitch Source row pitch in bytes.
+ * @param blocks Destination, bc1_size(width, height) bytes.
+ */
+void encode_bc1(const uint8_t *rgba, uint32_t width, uint32_t height, size_t pitch, uint8_t *blocks);
+
+/**
+ * Decode BC1 to RGBA8.
+ * @param blocks Source blocks.
+ * @param width Image width.
+ * @param height Image height.
+ * @param rgba Destination pixels.
+ * @param pitch Destination row pitch in bytes.
+ */
+void decode_bc1(const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *rgba, size_t pitch);
+
+FR_NAMESPACE_END
@@ -0,0 +1,138 @@
+#include "thumbnail_codec.h"
+#include "timer.h"
+
+#include <doctest/doctest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace fr;
+
+/// Smooth gradients with some noise, roughly resembling photo content.
+static std::vector<uint8_t> create_test_image(uint32_t width, uint32_t height, int noise = 8)
+{
+    std::vector<uint8_t> rgba(size_t(width) * height * 4);
+    std::mt19937 rng;
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint8_t *p = &rgba[(size_t(y) * width + x) * 4];
+            int n = noise > 0 ? int(rng() % (2 * noise + 1)) - noise : 0;
+            p[0] = uint8_t(std::clamp(int(255.f * x / width) + n, 0, 255));
+            p[1] = uint8_t(std::clamp(int(255.f * y / height) + n, 0, 255));
+            p[2] = uint8_t(std::clamp(128 + int(100.f * std::sin(x * 0.05f + y * 0.03f)) + n, 0, 255));
+            p[3] = 255;
+        }
+    }
+    return rgba;
+}
+
+static int max_error(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b)
+{
+    int error = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+        error = std::max(error, std::abs(int(a[i]) - int(b[i])));
+    return error;
+}
+
+TEST_SUITE_BEGIN("thumbnail_codec");
+
+TEST_CASE("BC1")
+{
+    SUBCASE("solid")
+    {
+        std::vector<uint8_t> rgba(8 * 8 * 4);
+        for (size_t i = 0; i < rgba.size(); i += 4) {
+            rgba[i + 0] = 255;
+            rgba[i + 1] = 128;
+            rgba[i + 2] = 0;
+            rgba[i + 3] = 255;
+        }
+        CompressedThumbnail thumbnail = compress_thumbnail(rgba.data(), 8, 8, ThumbnailFormat::BC1);
+        CHECK_EQ(thumbnail.size_bytes(), 4 * 8);
+
+        std::vector<uint8_t> decoded(rgba.size());
+        REQUIRE(decompress_thumbnail(thumbnail, decoded.data()));
+        CHECK_LE(max_error(rgba, decoded), 4);
+    }
+
+    SUBCASE("gradient")
+    {
+        // Partial blocks at the right and bottom edge.
+        const uint32_t width = 70;
+        const uint32_t height = 45;
+        std::vector<uint8_t> rgba = create_test_image(width, height, 0);
+        CompressedThumbnail thumbnail = compress_thumbnail(rgba.data(), width, height, ThumbnailFormat::BC1);
+        CHECK_EQ(thumbnail.size_bytes(), bc1_size(width, height));
+        CHECK_EQ(thumbnail.size_bytes(), 18 * 12 * 8);
+
+        std::vector<uint8_t> decoded(rgba.size());
+        REQUIRE(decompress_thumbnail(thumbnail, decoded.data()));
+        CHECK_LE(max_error(rgba, decoded), 24);
+    }
+}
+
+TEST_CASE("Lossless")
+{
+    SUBCASE("photo")
+    {
+        const uint32_t width = 256;
+        const uint32_t height = 171;
+        std::vector<uint8_t> rgba = create_test_image(width, height);
+        CompressedThumbnail thumbnail = compress_thumbnail(rgba.data(), width, height, ThumbnailFormat::Lossless);
+        CHECK_LT(thumbnail.size_bytes(), rgba.size());
+
+        std::vector<uint8_t> decoded(rgba.size());
+        REQUIRE(decompress_thumbnail(thumbnail, decoded.data()));
+        CHECK(decoded == rgba);
+    }
+
+    SUBCASE("random")
+    {
+        // Incompressible data and an odd width.
+        const uint32_t width = 37;
+        const uint32_t height = 13;
+        std::vector<uint8_t> rgba(width * height * 4);
+        std::mt19937 rng;
+        for (auto &v : rgba)
+            v = rng() & 0xff;
+        CompressedThumbnail thumbnail = compress_thumbnail(rgba.data(), width, height, ThumbnailFormat::Lossless);
+
+        std::vector<uint8_t> decoded(rgba.size());
+        REQUIRE(decompress_thumbnail(thumbnail, decoded.data()));
+        CHECK(decoded == rgba);
+
+        // Truncated data is rejected.
+        thumbnail.data.pop_back();
+        CHECK_FALSE(decompress_thumbnail(thumbnail, decoded.data()));
+    }
+}
+
+TEST_CASE("thumbnail codec benchmark" * doctest::skip(true))
+{
+    const uint32_t width = 256;
+    const uint32_t height = 171;
+    const int iterations = 1000;
+    std::vector<uint8_t> rgba = create_test_image(width, height);
+    std::vector<uint8_t> decoded(rgba.size());
+
+    for (ThumbnailFormat format : {ThumbnailFormat::RGBA8, ThumbnailFormat::BC1, ThumbnailFormat::Lossless}) {
+        Timer timer;
+        CompressedThumbnail thumbnail;
+        for (int i = 0; i < iterations; ++i)
+            thumbnail = compress_thumbnail(rgba.data(), width, height, format);
+        double encode_time = timer.elapsed() / iterations;
+
+        timer.reset();
+        for (int i = 0; i < iterations; ++i)
+            decompress_thumbnail(thumbnail, decoded.data());
+        double decode_time = timer.elapsed() / iterations;
+
+        MESSAGE("format " << int(format) << ": " << thumbnail.size_bytes() << " bytes ("
+                          << 100.0 * thumbnail.size_bytes() / rgba.size() << "%), encode " << encode_time * 1e6
+                          << "us, decode " << decode_time * 1e6 << "us, 100k thumbnails "
+                          << thumbnail.size_bytes() * 100000.0 / (1 << 30) << "GB");
+    }
+}
+
+TEST_SUITE_END();
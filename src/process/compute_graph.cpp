@@ -0,0 +1,241 @@
+#include "compute_graph.h"
+
+#include <algorithm>
+
+FR_NAMESPACE_BEGIN
+
+inline bool is_same_desc(const ImageDesc &a, const ImageDesc &b)
+{
+    return a.width == b.width && a.height == b.height && a.mip_levels == b.mip_levels &&
+           a.array_layers == b.array_layers && a.format == b.format && a.usage == b.usage && a.memory == b.memory &&
+           a.transient == b.transient;
+}
+
+inline bool is_same_desc(const BufferDesc &a, const BufferDesc &b)
+{
+    return a.size == b.size && a.usage == b.usage && a.memory == b.memory && a.transient == b.transient &&
+           a.format == b.format;
+}
+
+inline bool is_same_desc(const std::variant<ImageDesc, BufferDesc> &a, const std::variant<ImageDesc, BufferDesc> &b)
+{
+    if (a.index() != b.index())
+        return false;
+    if (auto image_desc = std::get_if<ImageDesc>(&a))
+        return is_same_desc(*image_desc, std::get<ImageDesc>(b));
+    return is_same_desc(std::get<BufferDesc>(a), std::get<BufferDesc>(b));
+}
+
+ImageHandle ComputeGraph::PassResources::image(GraphResource resource) const
+{
+    FR_ASSERT(resource.id < m_graph.m_resources.size());
+    const ImageHandle *image = std::get_if<ImageHandle>(&m_graph.m_resources[resource.id].handle);
+    FR_ASSERT(image);
+    return *image;
+}
+
+BufferHandle ComputeGraph::PassResources::buffer(GraphResource resource) const
+{
+    FR_ASSERT(resource.id < m_graph.m_resources.size());
+    const BufferHandle *buffer = std::get_if<BufferHandle>(&m_graph.m_resources[resource.id].handle);
+    FR_ASSERT(buffer);
+    return *buffer;
+}
+
+ComputeGraph::ComputeGraph(Device &device) : m_device(device) {}
+
+ComputeGraph::~ComputeGraph()
+{
+    for (const PhysicalResource &physical : m_physical) {
+        if (auto image = std::get_if<ImageHandle>(&physical.handle))
+            m_device.destroy_image(*image);
+        else if (auto buffer = std::get_if<BufferHandle>(&physical.handle))
+            m_device.destroy_buffer(*buffer);
+    }
+}
+
+GraphResource ComputeGraph::create_image(std::string name, const ImageDesc &desc)
+{
+    m_resources.push_back({.name = std::move(name), .desc = desc, .handle = ImageHandle::null()});
+    m_compiled = false;
+    return {uint32_t(m_resources.size() - 1)};
+}
+
+GraphResource ComputeGraph::create_buffer(std::string name, const BufferDesc &desc)
+{
+    m_resources.push_back({.name = std::move(name), .desc = desc, .handle = BufferHandle::null()});
+    m_compiled = false;
+    return {uint32_t(m_resources.size() - 1)};
+}
+
+GraphResource ComputeGraph::import_image(std::string name, ImageHandle image)
+{
+    m_resources.push_back({.name = std::move(name), .desc = ImageDesc{}, .imported = true, .handle = image});
+    m_compiled = false;
+    return {uint32_t(m_resources.size() - 1)};
+}
+
+GraphResource ComputeGraph::import_buffer(std::string name, BufferHandle buffer)
+{
+    m_resources.push_back({.name = std::move(name), .desc = BufferDesc{}, .imported = true, .handle = buffer});
+    m_compiled = false;
+    return {uint32_t(m_resources.size() - 1)};
+}
+
+void ComputeGraph::mark_output(GraphResource resource)
+{
+    FR_ASSERT(resource.id < m_resources.size());
+    m_resources[resource.id].output = true;
+    m_compiled = false;
+}
+
+void ComputeGraph::add_pass(std::string name, std::vector<GraphResource> reads, std::vector<GraphResource> writes,
+                            PassFunc func)
+{
+    for (GraphResource resource : reads)
+        FR_ASSERT(resource.id < m_resources.size());
+    for (GraphResource resource : writes)
+        FR_ASSERT(resource.id < m_resources.size());
+
+    m_passes.push_back({
+        .name = std::move(name),
+        .reads = std::move(reads),
+        .writes = std::move(writes),
+        .func = std::move(func),
+    });
+    m_compiled = false;
+}
+
+const ComputeGraphStats &ComputeGraph::compile()
+{
+    if (m_compiled)
+        return m_stats;
+
+    m_stats = {};
+
+    // Cull passes walking backwards: a pass is needed if it writes a needed resource or has no writes at all
+    // (e.g. a readback to the host). Resources read by needed passes become needed.
+    std::vector<bool> needed(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); ++i)
+        needed[i] = m_resources[i].imported || m_resources[i].output;
+
+    for (size_t i = m_passes.size(); i-- > 0;) {
+        Pass &pass = m_passes[i];
+        pass.culled = !pass.writes.empty() && std::none_of(pass.writes.begin(), pass.writes.end(),
+                                                            [&](GraphResource r) { return needed[r.id]; });
+        if (pass.culled) {
+            m_stats.culled_pass_count++;
+            continue;
+        }
+        m_stats.pass_count++;
+        for (GraphResource resource : pass.reads)
+            needed[resource.id] = true;
+    }
+
+    // Lifetimes of transient resources as [first, last] pass index.
+    const uint32_t NO_PASS = ~uint32_t(0);
+    std::vector<uint32_t> first_use(m_resources.size(), NO_PASS);
+    std::vector<uint32_t> last_use(m_resources.size(), NO_PASS);
+    for (uint32_t i = 0; i < m_passes.size(); ++i) {
+        if (m_passes[i].culled)
+            continue;
+        for (const auto *list : {&m_passes[i].reads, &m_passes[i].writes}) {
+            for (GraphResource resource : *list) {
+                if (first_use[resource.id] == NO_PASS)
+                    first_use[resource.id] = i;
+                last_use[resource.id] = i;
+            }
+        }
+    }
+    for (size_t i = 0; i < m_resources.size(); ++i) {
+        if (m_resources[i].output && first_use[i] != NO_PASS)
+            last_use[i] = uint32_t(m_passes.size());
+    }
+
+    // Assign device resources in execution order, returning them to the pool after their last use so later
+    // resources with the same description alias them.
+    for (PhysicalResource &physical : m_physical)
+        physical.in_use = false;
+    std::vector<bool> physical_used(m_physical.size());
+    for (Resource &resource : m_resources) {
+        if (!resource.imported)
+            resource.physical = ~uint32_t(0);
+    }
+    for (uint32_t i = 0; i <= m_passes.size(); ++i) {
+        for (size_t r = 0; r < m_resources.size(); ++r) {
+            Resource &resource = m_resources[r];
+            if (resource.imported || first_use[r] != i)
+                continue;
+            resource.physical = acquire_physical(resource.desc);
+            resource.handle = m_physical[resource.physical].handle;
+            physical_used.resize(m_physical.size());
+            if (!physical_used[resource.physical]) {
+                physical_used[resource.physical] = true;
+                m_stats.physical_count++;
+            }
+            m_stats.transient_count++;
+        }
+        for (size_t r = 0; r < m_resources.size(); ++r) {
+            Resource &resource = m_resources[r];
+            if (!resource.imported && last_use[r] == i)
+                m_physical[resource.physical].in_use = false;
+        }
+    }
+
+    m_compiled = true;
+    return m_stats;
+}
+
+uint32_t ComputeGraph::acquire_physical(const std::variant<ImageDesc, BufferDesc> &desc)
+{
+    for (uint32_t i = 0; i < m_physical.size(); ++i) {
+        PhysicalResource &physical = m_physical[i];
+        if (!physical.in_use && is_same_desc(physical.desc, desc)) {
+            physical.in_use = true;
+            return i;
+        }
+    }
+
+    PhysicalResource physical{.desc = desc, .in_use = true};
+    if (auto image_desc = std::get_if<ImageDesc>(&desc))
+        physical.handle = m_device.create_image(*image_desc);
+    else
+        physical.handle = m_device.create_buffer(std::get<BufferDesc>(desc));
+    m_physical.push_back(physical);
+    m_stats.created_count++;
+    return uint32_t(m_physical.size() - 1);
+}
+
+void ComputeGraph::execute(ContextHandle context)
+{
+    compile();
+
+    PassResources resources(*this);
+    for (const Pass &pass : m_passes) {
+        if (pass.culled || !pass.func)
+            continue;
+        m_device.begin_scope(context, pass.name);
+        pass.func(m_device, context, resources);
+        m_device.end_scope(context);
+    }
+}
+
+void ComputeGraph::reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_stats = {};
+    m_compiled = false;
+}
+
+std::vector<std::string> ComputeGraph::execution_order() const
+{
+    std::vector<std::string> order;
+    for (const Pass &pass : m_passes) {
+        if (!pass.culled)
+            order.push_back(pass.name);
+    }
+    return order;
+}
+
+FR_NAMESPACE_END
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "device.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <variant>
+#include <vector>
+
+FR_NAMESPACE_BEGIN
+
+/// Resource of a ComputeGraph, either a transient image/buffer owned by the graph or an imported one.
+struct GraphResource {
+    static constexpr uint32_t INVALID_ID = ~uint32_t(0);
+
+    uint32_t id{INVALID_ID};
+
+    bool is_valid() const { return id != INVALID_ID; }
+    bool operator==(const GraphResource &other) const = default;
+};
+
+struct ComputeGraphStats {
+    uint32_t pass_count{0};            ///< Number of passes that are executed.
+    uint32_t culled_pass_count{0};     ///< Number of passes that do not contribute to any output.
+    uint32_t transient_count{0};       ///< Number of transient resources used by executed passes.
+    uint32_t physical_count{0};        ///< Number of device resources backing the transient resources.
+    uint32_t created_count{0};         ///< Number of device resources created by the last compile().
+};
+
+/**
+ * Declarative compute graph on top of Device.
+ *
+ * Passes declare the resources they read and write, the graph then
+ *  - culls passes that do not contribute to an output (imported resource, mark_output() or a pass without writes),
+ *  - computes the lifetime of each transient resource (first to last pass using it),
+ *  - backs transient resources with device resources, reusing a resource for another transient resource with the
+ *    same description once its lifetime ended.
+ *
+ * Passes execute in declaration order, which is a valid order for the dependencies between them. Barriers are
+ * derived by the device from the bindings of each dispatch.
+ *
+ * Device resources are kept in a pool across reset(), so a graph that is rebuilt every frame does not reallocate.
+ * They are destroyed with the graph, the device defers their release until the work using them has completed.
+ */
+class ComputeGraph {
+public:
+    /// Resolves graph resources to device resources while a pass executes.
+    class PassResources {
+    public:
+        ImageHandle image(GraphResource resource) const;
+        BufferHandle buffer(GraphResource resource) const;
+
+    private:
+        PassResources(const ComputeGraph &graph) : m_graph(graph) {}
+
+        const ComputeGraph &m_graph;
+
+        friend class ComputeGraph;
+    };
+
+    using PassFunc = std::function<void(Device &device, ContextHandle context, const PassResources &resources)>;
+
+    ComputeGraph(Device &device);
+    ~ComputeGraph();
+
+    /// Declare a transient image, backed by a device image only while passes use it.
+    GraphResource create_image(std::string name, const ImageDesc &desc);
+    /// Declare a transient buffer, backed by a device buffer only while passes use it.
+    GraphResource create_buffer(std::string name, const BufferDesc &desc);
+
+    /// Use an existing image in the graph, writes to it are outputs of the graph.
+    GraphResource import_image(std::string name, ImageHandle image);
+    /// Use an existing buffer in the graph, writes to it are outputs of the graph.
+    GraphResource import_buffer(std::string name, BufferHandle buffer);
+
+    /// Keep a transient resource alive until the end of the graph and don't cull the passes writing it.
+    void mark_output(GraphResource resource);
+
+    /**
+     * Add a pass.
+     * @param name Name used for debugging.
+     * @param reads Resources read by the pass.
+     * @param writes Resources written by the pass (read-modify-write resources should also be listed in reads).
+     * @param func Function recording the pass, called by execute().
+     */
+    void add_pass(std::string name, std::vector<GraphResource> reads, std::vector<GraphResource> writes,
+                  PassFunc func);
+
+    /**
+     * Cull passes, compute lifetimes and assign device resources.
+     * Called by execute() if the graph changed.
+     */
+    const ComputeGraphStats &compile();
+
+    /// Record all passes into a context (which must be recording), each in a timestamp scope named after the pass.
+    void execute(ContextHandle context);
+
+    /// Remove all passes and resources, the device resources are kept for the next graph.
+    void reset();
+
+    const ComputeGraphStats &stats() const { return m_stats; }
+
+    /// Names of the passes in execution order (after compile()).
+    std::vector<std::string> execution_order() const;
+
+private:
+    ComputeGraph(const ComputeGraph &) = delete;
+    ComputeGraph &operator=(const ComputeGraph &) = delete;
+
+    struct Resource {
+        std::string name;
+        std::variant<ImageDesc, BufferDesc> desc;
+        bool imported{false};
+        bool output{false};
+        uint32_t physical{~uint32_t(0)};  ///< Index into m_physical (transient resources).
+        ResourceHandle handle;             ///< Device resource, set by compile().
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<GraphResource> reads;
+        std::vector<GraphResource> writes;
+        PassFunc func;
+        bool culled{false};
+    };
+
+    struct PhysicalResource {
+        std::variant<ImageDesc, BufferDesc> desc;
+        ResourceHandle handle;
+        bool in_use{false};
+    };
+
+    uint32_t acquire_physical(const std::variant<ImageDesc, BufferDesc> &desc);
+
+    Device &m_device;
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<PhysicalResource> m_physical;
+    ComputeGraphStats m_stats;
+    bool m_compiled{false};
+};
+
+FR_NAMESPACE_END
@@ -0,0 +1,160 @@
+#include "process/compute_graph.h"
+#include "shaders/shaders.h"
+
+#include <doctest/doctest.h>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("process");
+
+TEST_CASE("ComputeGraph" * doctest::skip(false || FOTORITE_GITHUB_CI))
+{
+    static const uint32_t N = 256;
+
+    Device device;
+
+    const ImageDesc image_desc{
+        .width = N,
+        .height = N,
+        .format = ImageFormat::RGBA32Float,
+        .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess,
+    };
+
+    SUBCASE("culling")
+    {
+        ComputeGraph graph(device);
+        ImageHandle output_image = device.create_image(image_desc);
+
+        auto a = graph.create_image("a", image_desc);
+        auto b = graph.create_image("b", image_desc);
+        auto unused = graph.create_image("unused", image_desc);
+        auto output = graph.import_image("output", output_image);
+
+        graph.add_pass("write a", {}, {a}, nullptr);
+        graph.add_pass("write b", {}, {b}, nullptr);
+        graph.add_pass("write unused", {a}, {unused}, nullptr);
+        graph.add_pass("write output", {a}, {output}, nullptr);
+        graph.add_pass("read b", {b}, {}, nullptr);
+
+        const ComputeGraphStats &stats = graph.compile();
+        CHECK_EQ(stats.pass_count, 4);
+        CHECK_EQ(stats.culled_pass_count, 1);
+        CHECK_EQ(stats.transient_count, 2);
+        std::vector<std::string> expected_order{"write a", "write b", "write output", "read b"};
+        CHECK_EQ(graph.execution_order(), expected_order);
+
+        device.destroy_image(output_image);
+    }
+
+    SUBCASE("aliasing")
+    {
+        static const int STAGE_COUNT = 15;
+
+        ComputeGraph graph(device);
+        ImageHandle output_image = device.create_image(image_desc);
+        size_t used_bytes = device.memory_stats().used_bytes;
+
+        // A linear chain only needs two intermediate images at any time.
+        GraphResource prev = graph.create_image("stage 0", image_desc);
+        graph.add_pass("stage 0", {}, {prev}, nullptr);
+        for (int i = 1; i < STAGE_COUNT; ++i) {
+            GraphResource next = graph.create_image("stage " + std::to_string(i), image_desc);
+            graph.add_pass("stage " + std::to_string(i), {prev}, {next}, nullptr);
+            prev = next;
+        }
+        graph.add_pass("output", {prev}, {graph.import_image("output", output_image)}, nullptr);
+
+        const ComputeGraphStats &stats = graph.compile();
+        CHECK_EQ(stats.pass_count, STAGE_COUNT + 1);
+        CHECK_EQ(stats.transient_count, STAGE_COUNT);
+        CHECK_EQ(stats.physical_count, 2);
+        CHECK_EQ(stats.created_count, 2);
+        CHECK_LE(device.memory_stats().used_bytes - used_bytes, 2 * size_t(N) * N * 16 * 2);
+
+        // Rebuilding the graph reuses the device images.
+        graph.reset();
+        auto a = graph.create_image("a", image_desc);
+        graph.add_pass("a", {}, {a}, nullptr);
+        graph.add_pass("output", {a}, {graph.import_image("output", output_image)}, nullptr);
+        CHECK_EQ(graph.compile().created_count, 0);
+
+        device.destroy_image(output_image);
+    }
+
+    SUBCASE("execute")
+    {
+        ShaderBlob blob = get_shader_blob(ShaderID::test_image_cs);
+        ShaderHandle shader = device.create_shader({
+            .code = blob.data(),
+            .code_size = blob.size_bytes(),
+        });
+        PipelineHandle pipeline = device.create_pipeline({
+            .shader = shader,
+            .binding_layout{
+                {.binding = 0, .type = DescriptorType::Texture},
+                {.binding = 1, .type = DescriptorType::RWTexture},
+            },
+            .push_constants_size = 8,
+        });
+
+        ImageHandle input_image = device.create_image({
+            .width = N,
+            .height = N,
+            .format = ImageFormat::RGBA32Float,
+            .usage = ResourceUsage::ShaderResource | ResourceUsage::TransferDst,
+        });
+        ImageHandle output_image = device.create_image({
+            .width = N,
+            .height = N,
+            .format = ImageFormat::RGBA32Float,
+            .usage = ResourceUsage::UnorderedAccess | ResourceUsage::TransferSrc,
+        });
+
+        auto add_stage = [&](ComputeGraph &graph, GraphResource src, GraphResource dst) {
+            auto func = [=](Device &device, ContextHandle context, const ComputeGraph::PassResources &resources) {
+                uint32_t push_constants[2] = {N, N};
+                device.dispatch(context, {
+                                             .pipeline = pipeline,
+                                             .binding_set{
+                                                 {.binding = 0, .resource = resources.image(src)},
+                                                 {.binding = 1, .resource = resources.image(dst)},
+                                             },
+                                             .push_constants = &push_constants,
+                                             .push_constants_size = sizeof(push_constants),
+                                             .group_count{N / 32, N / 32, 1},
+                                         });
+            };
+            graph.add_pass("stage", {src}, {dst}, func);
+        };
+
+        ComputeGraph graph(device);
+        auto input = graph.import_image("input", input_image);
+        auto a = graph.create_image("a", image_desc);
+        auto b = graph.create_image("b", image_desc);
+        auto output = graph.import_image("output", output_image);
+        add_stage(graph, input, a);
+        add_stage(graph, a, b);
+        add_stage(graph, b, output);
+
+        std::vector<float> data(N * N * 4, 1.f);
+        ContextHandle context = device.create_context();
+        device.begin(context);
+        device.write_image(context, input_image, data.data(), data.size() * sizeof(float));
+        graph.execute(context);
+        device.read_image(context, output_image, data.data(), data.size() * sizeof(float));
+        device.submit(context);
+        device.wait(context);
+
+        // ((1 * 2 + 1) * 2 + 1) * 2 + 1
+        CHECK_EQ(data[0], 15.f);
+        CHECK_EQ(data.back(), 15.f);
+
+        device.destroy_context(context);
+        device.destroy_image(input_image);
+        device.destroy_image(output_image);
+        device.destroy_pipeline(pipeline);
+        device.destroy_shader(shader);
+    }
+}
+
+TEST_SUITE_END();
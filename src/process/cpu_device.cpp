@@ -0,0 +1,837 @@
+#include "cpu_device.h"
+#include "image_regions.h"
+#include "spirv.h"
+#include "core/profiler.h"
+
+#include <BS_thread_pool.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+FR_NAMESPACE_BEGIN
+
+struct CpuKernelRegistry {
+    std::mutex mutex;
+    std::unordered_map<const void *, CpuKernel> kernels;
+};
+
+static CpuKernelRegistry &get_kernel_registry()
+{
+    static CpuKernelRegistry registry;
+    return registry;
+}
+
+void register_cpu_kernel(const void *code, CpuKernel kernel)
+{
+    FR_ASSERT(code && kernel);
+    CpuKernelRegistry &registry = get_kernel_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.kernels[code] = std::move(kernel);
+}
+
+struct CpuShader {
+    ShaderDesc desc;
+};
+
+struct CpuBuffer {
+    BufferDesc desc;
+    std::vector<uint8_t> data;
+};
+
+struct CpuImage {
+    ImageDesc desc;
+    std::vector<uint8_t> data;
+    std::vector<size_t> level_offsets;  ///< Offset of each mip level, the layers of a level are consecutive.
+    uint32_t bindless_slot_count;       ///< Number of bindless array slots holding the image.
+};
+
+struct CpuSampler {
+    SamplerDesc desc;
+};
+
+struct CpuPipeline {
+    PipelineDesc desc;
+    CpuKernel kernel;
+    WorkgroupSize workgroup_size;
+};
+
+struct CpuScope {
+    std::string name;
+    uint32_t depth;
+    double start_us;
+    double duration_us;
+    bool timed;  ///< False if the scope exceeded ContextDesc::max_timestamp_scopes and is dropped.
+};
+
+struct CpuContext {
+    ContextDesc desc;
+    bool is_recording;
+    uint64_t submitted_value;
+    uint32_t timed_scope_count;  ///< Scopes timed since the last submission.
+    std::vector<CpuScope> open_scopes;
+    std::vector<CpuScope> closed_scopes;  ///< Closed since the last submission.
+    std::vector<GpuTiming> timings;
+};
+
+struct CpuBindlessSlot {
+    ImageHandle image{ImageHandle::null()};
+    ImageSubresourceRange subresource;
+};
+
+struct CpuBindlessArray {
+    std::vector<CpuBindlessSlot> slots;
+    std::vector<uint32_t> free_indices;
+};
+
+struct CpuDeviceImpl {
+    DeviceDesc desc;
+    std::unique_ptr<BS::thread_pool> thread_pool;
+
+    // Guards the memory counters.
+    mutable std::mutex memory_mutex;
+    uint32_t resource_count{0};
+    size_t used_bytes{0};
+
+    // Bindless image arrays, indexed by 0 = Texture, 1 = RWTexture.
+    std::mutex bindless_mutex;
+    CpuBindlessArray bindless_arrays[2];
+
+    Pool<CpuShader, ShaderHandle> shaders;
+    Pool<CpuBuffer, BufferHandle> buffers;
+    Pool<CpuImage, ImageHandle> images;
+    Pool<CpuSampler, SamplerHandle> samplers;
+    Pool<CpuPipeline, PipelineHandle> pipelines;
+    Pool<CpuContext, ContextHandle> contexts;
+};
+
+inline void track_memory(CpuDeviceImpl &device, size_t size, bool allocate)
+{
+    std::lock_guard<std::mutex> lock(device.memory_mutex);
+    if (allocate) {
+        device.resource_count++;
+        device.used_bytes += size;
+    } else {
+        device.resource_count--;
+        device.used_bytes -= size;
+    }
+}
+
+/// Bytes between rows of texel blocks of a mip level.
+inline size_t level_row_pitch(const ImageDesc &desc, uint32_t level)
+{
+    const ImageFormatInfo &info = get_image_format_info(desc.format);
+    return size_t((level_extent(desc.width, level) + info.block_extent - 1) / info.block_extent) * info.block_size;
+}
+
+/// Number of rows of texel blocks of a mip level.
+inline uint32_t level_row_count(const ImageDesc &desc, uint32_t level)
+{
+    const ImageFormatInfo &info = get_image_format_info(desc.format);
+    return (level_extent(desc.height, level) + info.block_extent - 1) / info.block_extent;
+}
+
+inline size_t level_layer_size(const ImageDesc &desc, uint32_t level)
+{
+    return level_row_pitch(desc, level) * level_row_count(desc, level);
+}
+
+inline uint8_t *subresource_data(CpuImage &image, uint32_t level, uint32_t layer)
+{
+    return image.data.data() + image.level_offsets[level] + layer * level_layer_size(image.desc, level);
+}
+
+/// Texel block rows of a region in the image data.
+struct RegionRows {
+    uint8_t *data;     ///< First block of the region.
+    size_t row_pitch;  ///< Bytes between rows in the image.
+    size_t row_size;   ///< Bytes of a row of the region.
+    uint32_t row_count;
+};
+
+inline RegionRows get_region_rows(CpuImage &image, const ImageRegion &region)
+{
+    const ImageFormatInfo &info = get_image_format_info(image.desc.format);
+    const size_t row_pitch = level_row_pitch(image.desc, region.mip_level);
+    return {
+        .data = subresource_data(image, region.mip_level, region.array_layer) +
+                (region.y / info.block_extent) * row_pitch + (region.x / info.block_extent) * info.block_size,
+        .row_pitch = row_pitch,
+        .row_size = size_t((region.width + info.block_extent - 1) / info.block_extent) * info.block_size,
+        .row_count = (region.height + info.block_extent - 1) / info.block_extent,
+    };
+}
+
+/// 2x2 box filter of one mip level into the next, edge texels are repeated for odd sizes.
+template <typename T, typename Average>
+void downsample(const CpuImage &image, const uint8_t *src, uint32_t level, uint8_t *dst, uint32_t channel_count,
+                Average average)
+{
+    const uint32_t src_width = level_extent(image.desc.width, level - 1);
+    const uint32_t src_height = level_extent(image.desc.height, level - 1);
+    const size_t src_row_pitch = level_row_pitch(image.desc, level - 1);
+    const size_t dst_row_pitch = level_row_pitch(image.desc, level);
+
+    for (uint32_t y = 0; y < level_extent(image.desc.height, level); ++y) {
+        const T *row0 = reinterpret_cast<const T *>(src + std::min(2 * y, src_height - 1) * src_row_pitch);
+        const T *row1 = reinterpret_cast<const T *>(src + std::min(2 * y + 1, src_height - 1) * src_row_pitch);
+        T *dst_row = reinterpret_cast<T *>(dst + y * dst_row_pitch);
+        for (uint32_t x = 0; x < level_extent(image.desc.width, level); ++x) {
+            const uint32_t x0 = std::min(2 * x, src_width - 1) * channel_count;
+            const uint32_t x1 = std::min(2 * x + 1, src_width - 1) * channel_count;
+            for (uint32_t c = 0; c < channel_count; ++c)
+                dst_row[x * channel_count + c] = average(row0[x0 + c], row0[x1 + c], row1[x0 + c], row1[x1 + c]);
+        }
+    }
+}
+
+inline CpuBinding image_binding(CpuImage &image, uint32_t binding, const ImageSubresourceRange &range)
+{
+    const uint32_t level = range.base_mip_level;
+    return {
+        .binding = binding,
+        .data = subresource_data(image, level, range.base_array_layer),
+        .size = level_layer_size(image.desc, level),
+        .format = image.desc.format,
+        .width = level_extent(image.desc.width, level),
+        .height = level_extent(image.desc.height, level),
+        .layer_count = range.array_layer_count,
+        .row_pitch = level_row_pitch(image.desc, level),
+        .layer_pitch = level_layer_size(image.desc, level),
+        .texel_size = get_image_format_info(image.desc.format).block_size,
+    };
+}
+
+CpuDevice::CpuDevice(const DeviceDesc &desc) : m_impl(std::make_unique<CpuDeviceImpl>())
+{
+    m_impl->desc = desc;
+    const uint32_t thread_count =
+        desc.cpu_thread_count > 0 ? desc.cpu_thread_count : std::max(std::thread::hardware_concurrency(), 1u);
+    m_impl->thread_pool = std::make_unique<BS::thread_pool>(thread_count);
+}
+
+CpuDevice::~CpuDevice() {}
+
+ShaderHandle CpuDevice::create_shader(const ShaderDesc &desc)
+{
+    ShaderHandle shader = m_impl->shaders.alloc();
+    m_impl->shaders[shader]->desc = desc;
+    return shader;
+}
+
+void CpuDevice::destroy_shader(ShaderHandle shader) { m_impl->shaders.free(shader); }
+
+BufferHandle CpuDevice::create_buffer(const BufferDesc &desc)
+{
+    BufferHandle buffer = m_impl->buffers.alloc();
+    CpuBuffer *buffer_impl = m_impl->buffers[buffer];
+    buffer_impl->desc = desc;
+    buffer_impl->data.assign(desc.size, 0);
+    track_memory(*m_impl, desc.size, true);
+    return buffer;
+}
+
+void CpuDevice::destroy_buffer(BufferHandle buffer)
+{
+    CpuBuffer *buffer_impl = m_impl->buffers[buffer];
+    if (!buffer_impl)
+        return;
+
+    track_memory(*m_impl, buffer_impl->data.size(), false);
+    buffer_impl->data = {};
+    m_impl->buffers.free(buffer);
+}
+
+ImageHandle CpuDevice::create_image(const ImageDesc &desc)
+{
+    FR_ASSERT(desc.mip_levels >= 1 && desc.mip_levels <= mip_level_count(desc.width, desc.height));
+    FR_ASSERT(desc.array_layers >= 1);
+    FR_ASSERT(desc.memory == MemoryType::Device || (desc.mip_levels == 1 && desc.array_layers == 1));
+
+    ImageHandle image = m_impl->images.alloc();
+    CpuImage *image_impl = m_impl->images[image];
+    image_impl->desc = desc;
+    image_impl->bindless_slot_count = 0;
+
+    size_t size = 0;
+    image_impl->level_offsets.resize(desc.mip_levels);
+    for (uint32_t level = 0; level < desc.mip_levels; ++level) {
+        image_impl->level_offsets[level] = size;
+        size += level_layer_size(desc, level) * desc.array_layers;
+    }
+    image_impl->data.assign(size, 0);
+    track_memory(*m_impl, size, true);
+
+    return image;
+}
+
+void CpuDevice::destroy_image(ImageHandle image)
+{
+    CpuImage *image_impl = m_impl->images[image];
+    if (!image_impl)
+        return;
+
+    if (image_impl->bindless_slot_count > 0) {
+        std::lock_guard<std::mutex> lock(m_impl->bindless_mutex);
+        for (CpuBindlessArray &array : m_impl->bindless_arrays) {
+            for (uint32_t index = 0; index < array.slots.size(); ++index) {
+                if (array.slots[index].image == image) {
+                    array.slots[index].image = ImageHandle::null();
+                    array.free_indices.push_back(index);
+                }
+            }
+        }
+        image_impl->bindless_slot_count = 0;
+    }
+
+    track_memory(*m_impl, image_impl->data.size(), false);
+    image_impl->data = {};
+    m_impl->images.free(image);
+}
+
+SamplerHandle CpuDevice::create_sampler(const SamplerDesc &desc)
+{
+    SamplerHandle sampler = m_impl->samplers.alloc();
+    m_impl->samplers[sampler]->desc = desc;
+    return sampler;
+}
+
+void CpuDevice::destroy_sampler(SamplerHandle sampler) { m_impl->samplers.free(sampler); }
+
+PipelineHandle CpuDevice::create_pipeline(const PipelineDesc &desc)
+{
+    CpuShader *shader = m_impl->shaders[desc.shader];
+    FR_ASSERT(shader);
+
+    CpuKernel kernel;
+    {
+        CpuKernelRegistry &registry = get_kernel_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.kernels.find(shader->desc.code);
+        if (it == registry.kernels.end())
+            throw std::runtime_error("No CPU kernel registered for the pipeline's shader!");
+        kernel = it->second;
+    }
+
+    // the override, the shader's numthreads if the code is SPIR-V, or a single invocation
+    WorkgroupSize workgroup_size = desc.workgroup_size;
+    if (workgroup_size == WorkgroupSize{}) {
+        std::vector<uint32_t> code(shader->desc.code_size / sizeof(uint32_t));
+        std::memcpy(code.data(), shader->desc.code, code.size() * sizeof(uint32_t));
+        if (!get_spirv_workgroup_size(code, workgroup_size))
+            workgroup_size = {1, 1, 1};
+    }
+    FR_ASSERT(uint64_t(workgroup_size[0]) * workgroup_size[1] * workgroup_size[2] <= max_workgroup_invocations());
+
+    PipelineHandle pipeline = m_impl->pipelines.alloc();
+    CpuPipeline *pipeline_impl = m_impl->pipelines[pipeline];
+    pipeline_impl->desc = desc;
+    pipeline_impl->kernel = std::move(kernel);
+    pipeline_impl->workgroup_size = workgroup_size;
+    return pipeline;
+}
+
+std::vector<PipelineHandle> CpuDevice::create_pipelines(std::span<const PipelineDesc> descs)
+{
+    // nothing to compile
+    std::vector<PipelineHandle> pipelines;
+    for (const PipelineDesc &desc : descs)
+        pipelines.push_back(create_pipeline(desc));
+    return pipelines;
+}
+
+void CpuDevice::destroy_pipeline(PipelineHandle pipeline)
+{
+    CpuPipeline *pipeline_impl = m_impl->pipelines[pipeline];
+    if (!pipeline_impl)
+        return;
+
+    pipeline_impl->kernel = nullptr;
+    m_impl->pipelines.free(pipeline);
+}
+
+inline uint32_t get_bindless_array(DescriptorType type)
+{
+    FR_ASSERT(type == DescriptorType::Texture || type == DescriptorType::RWTexture);
+    return type == DescriptorType::Texture ? 0 : 1;
+}
+
+uint32_t CpuDevice::add_bindless_image(ImageHandle image, DescriptorType type,
+                                       const ImageSubresourceRange &subresource)
+{
+    CpuImage *image_impl = m_impl->images[image];
+    FR_ASSERT(image_impl);
+    FR_ASSERT(m_impl->desc.bindless_image_count > 0);
+
+    ImageSubresourceRange range = subresource;
+    if (type == DescriptorType::RWTexture && range.mip_level_count == 0)
+        range.mip_level_count = 1;
+    range = resolve_subresource(image_impl->desc, range);
+
+    std::lock_guard<std::mutex> lock(m_impl->bindless_mutex);
+    CpuBindlessArray &array = m_impl->bindless_arrays[get_bindless_array(type)];
+    uint32_t index;
+    if (!array.free_indices.empty()) {
+        index = array.free_indices.back();
+        array.free_indices.pop_back();
+    } else {
+        FR_ASSERT(array.slots.size() < m_impl->desc.bindless_image_count);
+        index = static_cast<uint32_t>(array.slots.size());
+        array.slots.emplace_back();
+    }
+    array.slots[index] = {.image = image, .subresource = range};
+    image_impl->bindless_slot_count++;
+    return index;
+}
+
+void CpuDevice::remove_bindless_image(DescriptorType type, uint32_t index)
+{
+    std::lock_guard<std::mutex> lock(m_impl->bindless_mutex);
+    CpuBindlessArray &array = m_impl->bindless_arrays[get_bindless_array(type)];
+    FR_ASSERT(index < array.slots.size() && array.slots[index].image != ImageHandle::null());
+
+    m_impl->images[array.slots[index].image]->bindless_slot_count--;
+    array.slots[index].image = ImageHandle::null();
+    array.free_indices.push_back(index);
+}
+
+ContextHandle CpuDevice::create_context(const ContextDesc &desc)
+{
+    ContextHandle context = m_impl->contexts.alloc();
+    CpuContext *context_impl = m_impl->contexts[context];
+    *context_impl = {};
+    context_impl->desc = desc;
+    return context;
+}
+
+void CpuDevice::destroy_context(ContextHandle context)
+{
+    CpuContext *context_impl = m_impl->contexts[context];
+    if (!context_impl)
+        return;
+
+    *context_impl = {};
+    m_impl->contexts.free(context);
+}
+
+void CpuDevice::begin(ContextHandle context)
+{
+    CpuContext *context_impl = m_impl->contexts[context];
+    if (!context_impl)
+        return;
+
+    FR_ASSERT(!context_impl->is_recording);
+    context_impl->is_recording = true;
+}
+
+uint64_t CpuDevice::submit(ContextHandle context)
+{
+    CpuContext *context_impl = m_impl->contexts[context];
+    if (!context_impl)
+        return 0;
+
+    FR_ASSERT(context_impl->is_recording);
+    context_impl->is_recording = false;
+
+    // commands executed while recording, the timings are final
+    if (!context_impl->closed_scopes.empty()) {
+        double first_us = context_impl->closed_scopes.front().start_us;
+        for (const CpuScope &scope : context_impl->closed_scopes)
+            first_us = std::min(first_us, scope.start_us);
+
+        Profiler &profiler = Profiler::global();
+        for (CpuScope &scope : context_impl->closed_scopes) {
+            if (!scope.timed)
+                continue;
+            if (profiler.enabled()) {
+                profiler.add_event({
+                    .name = scope.name,
+                    .category = "cpu device",
+                    .track = profiler.thread_track(),
+                    .start_us = scope.start_us,
+                    .duration_us = scope.duration_us,
+                });
+            }
+            context_impl->timings.push_back({
+                .name = std::move(scope.name),
+                .start_ms = (scope.start_us - first_us) * 1e-3,
+                .duration_ms = scope.duration_us * 1e-3,
+                .depth = scope.depth,
+            });
+        }
+        context_impl->closed_scopes.clear();
+    }
+    context_impl->timed_scope_count = 0;
+
+    return ++context_impl->submitted_value;
+}
+
+uint64_t CpuDevice::completed_value(ContextHandle context) const
+{
+    const CpuContext *context_impl = m_impl->contexts[context];
+    return context_impl ? context_impl->submitted_value : 0;
+}
+
+std::span<uint8_t> CpuDevice::map_buffer(BufferHandle buffer)
+{
+    // same contract as the Vulkan backend, only host memory is mapped
+    CpuBuffer *buffer_impl = m_impl->buffers[buffer];
+    if (!buffer_impl || buffer_impl->desc.memory == MemoryType::Device)
+        return {};
+
+    return buffer_impl->data;
+}
+
+void CpuDevice::write_buffer(ContextHandle context, BufferHandle buffer, const void *data, size_t size,
+                             size_t offset)
+{
+    CpuBuffer *buffer_impl = m_impl->buffers[buffer];
+    if (!buffer_impl || size == 0)
+        return;
+
+    FR_ASSERT(offset + size <= buffer_impl->desc.size);
+    std::memcpy(buffer_impl->data.data() + offset, data, size);
+}
+
+void CpuDevice::read_buffer(ContextHandle context, BufferHandle buffer, void *data, size_t size, size_t offset)
+{
+    CpuBuffer *buffer_impl = m_impl->buffers[buffer];
+    if (!buffer_impl || size == 0)
+        return;
+
+    FR_ASSERT(offset + size <= buffer_impl->desc.size);
+    std::memcpy(data, buffer_impl->data.data() + offset, size);
+}
+
+void CpuDevice::copy_buffer(ContextHandle context, BufferHandle src, BufferHandle dst, size_t size, size_t src_offset,
+                            size_t dst_offset)
+{
+    CpuBuffer *src_impl = m_impl->buffers[src];
+    CpuBuffer *dst_impl = m_impl->buffers[dst];
+    if (!src_impl || !dst_impl || size == 0)
+        return;
+
+    FR_ASSERT(src_offset + size <= src_impl->desc.size && dst_offset + size <= dst_impl->desc.size);
+    std::memmove(dst_impl->data.data() + dst_offset, src_impl->data.data() + src_offset, size);
+}
+
+void CpuDevice::write_image(ContextHandle context, ImageHandle image, const ImageRegion &region, const void *data,
+                            size_t row_pitch)
+{
+    CpuImage *image_impl = m_impl->images[image];
+    if (!image_impl)
+        return;
+
+    const RegionRows rows = get_region_rows(*image_impl, resolve_region(image_impl->desc, region));
+    if (row_pitch == 0)
+        row_pitch = rows.row_size;
+    FR_ASSERT(row_pitch >= rows.row_size);
+    copy_rows(rows.data, rows.row_pitch, static_cast<const uint8_t *>(data), row_pitch, rows.row_size,
+              rows.row_count);
+}
+
+void CpuDevice::read_image(ContextHandle context, ImageHandle image, const ImageRegion &region, void *data,
+                           size_t row_pitch)
+{
+    CpuImage *image_impl = m_impl->images[image];
+    if (!image_impl)
+        return;
+
+    const RegionRows rows = get_region_rows(*image_impl, resolve_region(image_impl->desc, region));
+    if (row_pitch == 0)
+        row_pitch = rows.row_size;
+    FR_ASSERT(row_pitch >= rows.row_size);
+    copy_rows(static_cast<uint8_t *>(data), row_pitch, rows.data, rows.row_pitch, rows.row_size, rows.row_count);
+}
+
+void CpuDevice::copy_buffer_to_image(ContextHandle context, BufferHandle src, ImageHandle dst,
+                                     const ImageRegion &region, size_t src_offset, size_t src_row_pitch)
+{
+    CpuBuffer *src_impl = m_impl->buffers[src];
+    CpuImage *dst_impl = m_impl->images[dst];
+    if (!src_impl || !dst_impl)
+        return;
+
+    const RegionRows rows = get_region_rows(*dst_impl, resolve_region(dst_impl->desc, region));
+    if (src_row_pitch == 0)
+        src_row_pitch = rows.row_size;
+    FR_ASSERT(src_row_pitch >= rows.row_size);
+    FR_ASSERT(src_offset + (rows.row_count - 1) * src_row_pitch + rows.row_size <= src_impl->desc.size);
+    copy_rows(rows.data, rows.row_pitch, src_impl->data.data() + src_offset, src_row_pitch, rows.row_size,
+              rows.row_count);
+}
+
+void CpuDevice::copy_image_to_buffer(ContextHandle context, ImageHandle src, BufferHandle dst,
+                                     const ImageRegion &region, size_t dst_offset, size_t dst_row_pitch)
+{
+    CpuImage *src_impl = m_impl->images[src];
+    CpuBuffer *dst_impl = m_impl->buffers[dst];
+    if (!src_impl || !dst_impl)
+        return;
+
+    const RegionRows rows = get_region_rows(*src_impl, resolve_region(src_impl->desc, region));
+    if (dst_row_pitch == 0)
+        dst_row_pitch = rows.row_size;
+    FR_ASSERT(dst_row_pitch >= rows.row_size);
+    FR_ASSERT(dst_offset + (rows.row_count - 1) * dst_row_pitch + rows.row_size <= dst_impl->desc.size);
+    copy_rows(dst_impl->data.data() + dst_offset, dst_row_pitch, rows.data, rows.row_pitch, rows.row_size,
+              rows.row_count);
+}
+
+void CpuDevice::copy_image(ContextHandle context, ImageHandle src, ImageHandle dst, uint32_t width, uint32_t height)
+{
+    CpuImage *src_impl = m_impl->images[src];
+    CpuImage *dst_impl = m_impl->images[dst];
+    if (!src_impl || !dst_impl || width == 0 || height == 0)
+        return;
+
+    FR_ASSERT(get_image_format_info(src_impl->desc.format).block_size ==
+              get_image_format_info(dst_impl->desc.format).block_size);
+    const ImageRegion region{.width = width, .height = height};
+    const RegionRows src_rows = get_region_rows(*src_impl, resolve_region(src_impl->desc, region));
+    const RegionRows dst_rows = get_region_rows(*dst_impl, resolve_region(dst_impl->desc, region));
+    copy_rows(dst_rows.data, dst_rows.row_pitch, src_rows.data, src_rows.row_pitch, src_rows.row_size,
+              src_rows.row_count);
+}
+
+void CpuDevice::generate_mips(ContextHandle context, ImageHandle image)
+{
+    CpuImage *image_impl = m_impl->images[image];
+    if (!image_impl || image_impl->desc.mip_levels == 1)
+        return;
+
+    const ImageFormat format = image_impl->desc.format;
+    const uint32_t texel_size = get_image_format_info(format).block_size;
+    auto average_unorm8 = [](uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        return uint8_t((a + b + c + d + 2) / 4);
+    };
+    auto average_float = [](float a, float b, float c, float d) { return (a + b + c + d) * 0.25f; };
+
+    for (uint32_t level = 1; level < image_impl->desc.mip_levels; ++level) {
+        for (uint32_t layer = 0; layer < image_impl->desc.array_layers; ++layer) {
+            const uint8_t *src = subresource_data(*image_impl, level - 1, layer);
+            uint8_t *dst = subresource_data(*image_impl, level, layer);
+            switch (format) {
+                case ImageFormat::R8Unorm:
+                case ImageFormat::RGBA8Unorm:
+                    downsample<uint8_t>(*image_impl, src, level, dst, texel_size, average_unorm8);
+                    break;
+                case ImageFormat::R32Float:
+                case ImageFormat::RG32Float:
+                case ImageFormat::RGB32Float:
+                case ImageFormat::RGBA32Float:
+                    downsample<float>(*image_impl, src, level, dst, texel_size / 4, average_float);
+                    break;
+                default:
+                    // no filtering of integer, half float and block-compressed formats on the CPU
+                    FR_ASSERT(false);
+            }
+        }
+    }
+}
+
+void CpuDevice::dispatch(ContextHandle context, const DispatchDesc &desc)
+{
+    CpuContext *context_impl = m_impl->contexts[context];
+    CpuPipeline *pipeline_impl = m_impl->pipelines[desc.pipeline];
+    if (!context_impl || !pipeline_impl)
+        return;
+
+    FR_ASSERT(context_impl->is_recording);
+    FR_ASSERT(desc.binding_set.size() == pipeline_impl->desc.binding_layout.size());
+
+    // previous commands have executed, so indirect arguments are already available
+    uint32_t group_count[3] = {desc.group_count[0], desc.group_count[1], desc.group_count[2]};
+    if (!desc.indirect_buffer.is_null()) {
+        CpuBuffer *indirect_impl = m_impl->buffers[desc.indirect_buffer];
+        FR_ASSERT(indirect_impl);
+        FR_ASSERT(desc.indirect_offset % 4 == 0);
+        FR_ASSERT(desc.indirect_offset + sizeof(group_count) <= indirect_impl->desc.size);
+        std::memcpy(group_count, indirect_impl->data.data() + desc.indirect_offset, sizeof(group_count));
+        if (group_count[0] == 0 || group_count[1] == 0 || group_count[2] == 0)
+            return;
+    }
+    FR_ASSERT(group_count[0] > 0 && group_count[1] > 0 && group_count[2] > 0);
+
+    std::vector<CpuBinding> bindings(desc.binding_set.size());
+    for (size_t i = 0; i < desc.binding_set.size(); ++i) {
+        const auto &set_item = desc.binding_set[i];
+        const auto &layout_item = pipeline_impl->desc.binding_layout[i];
+
+        FR_ASSERT(set_item.binding == layout_item.binding);
+
+        if (auto buffer = std::get_if<BufferHandle>(&set_item.resource)) {
+            CpuBuffer *buffer_impl = m_impl->buffers[*buffer];
+            FR_ASSERT(buffer_impl);
+            bindings[i] = {
+                .binding = set_item.binding,
+                .data = buffer_impl->data.data(),
+                .size = buffer_impl->desc.size,
+                .format = buffer_impl->desc.format,
+                .texel_size = get_image_format_info(buffer_impl->desc.format).block_size,
+            };
+        } else if (auto image = std::get_if<ImageHandle>(&set_item.resource)) {
+            CpuImage *image_impl = m_impl->images[*image];
+            FR_ASSERT(image_impl);
+            ImageSubresourceRange range = set_item.subresource;
+            if (layout_item.type == DescriptorType::RWTexture && range.mip_level_count == 0)
+                range.mip_level_count = 1;
+            bindings[i] = image_binding(*image_impl, set_item.binding, resolve_subresource(image_impl->desc, range));
+        } else if (auto sampler = std::get_if<SamplerHandle>(&set_item.resource)) {
+            CpuSampler *sampler_impl = m_impl->samplers[*sampler];
+            FR_ASSERT(sampler_impl);
+            bindings[i] = {.binding = set_item.binding, .sampler = &sampler_impl->desc};
+        }
+    }
+
+    // only the declared bindless images are resolved, as only those are transitioned by the Vulkan backend
+    FR_ASSERT(pipeline_impl->desc.bindless || (desc.bindless_textures.empty() && desc.bindless_rw_textures.empty()));
+    std::vector<CpuBinding> bindless[2];
+    if (pipeline_impl->desc.bindless) {
+        std::lock_guard<std::mutex> lock(m_impl->bindless_mutex);
+        const std::span<const uint32_t> indices[] = {desc.bindless_textures, desc.bindless_rw_textures};
+        for (uint32_t array = 0; array < 2; ++array) {
+            const auto &slots = m_impl->bindless_arrays[array].slots;
+            bindless[array].resize(slots.size(), CpuBinding{.binding = array});
+            for (uint32_t index : indices[array]) {
+                FR_ASSERT(index < slots.size());
+                CpuImage *image_impl = m_impl->images[slots[index].image];
+                FR_ASSERT(image_impl);
+                bindless[array][index] = image_binding(*image_impl, array, slots[index].subresource);
+            }
+        }
+    }
+
+    const CpuKernelArgs args{
+        .bindings = bindings,
+        .bindless_textures = bindless[0],
+        .bindless_rw_textures = bindless[1],
+        .push_constants = desc.push_constants_size > 0 ? desc.push_constants : nullptr,
+        .specialization_constants = pipeline_impl->desc.specialization_constants,
+        .workgroup_size = pipeline_impl->workgroup_size,
+    };
+
+    // workgroups are split into contiguous ranges, a few per worker to balance uneven groups
+    const uint64_t group_count_xy = uint64_t(group_count[0]) * group_count[1];
+    const uint64_t total_group_count = group_count_xy * group_count[2];
+    const uint64_t task_count = std::min<uint64_t>(total_group_count, m_impl->thread_pool->get_thread_count() * 4);
+    const CpuKernel &kernel = pipeline_impl->kernel;
+
+    auto run_groups = [&](uint64_t begin, uint64_t end) {
+        CpuKernelArgs group_args = args;
+        for (uint64_t group = begin; group < end; ++group) {
+            group_args.group_id[0] = uint32_t(group % group_count[0]);
+            group_args.group_id[1] = uint32_t(group / group_count[0] % group_count[1]);
+            group_args.group_id[2] = uint32_t(group / group_count_xy);
+            kernel(group_args);
+        }
+    };
+
+    if (task_count <= 1) {
+        run_groups(0, total_group_count);
+        return;
+    }
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(task_count);
+    for (uint64_t task = 0; task < task_count; ++task) {
+        futures.push_back(m_impl->thread_pool->submit(run_groups, total_group_count * task / task_count,
+                                                      total_group_count * (task + 1) / task_count));
+    }
+    // Rethrows errors from the kernels.
+    for (auto &future : futures)
+        future.get();
+}
+
+void CpuDevice::dispatch_batch(ContextHandle context, std::span<const DispatchDesc> descs)
+{
+    // dispatches execute while they are recorded, there is no state to share between them, but a batch must not
+    // read a resource written by another of its dispatches, as on the Vulkan backend
+    std::vector<std::pair<ResourceHandle, bool>> accesses;
+    for (const DispatchDesc &desc : descs) {
+        CpuPipeline *pipeline_impl = m_impl->pipelines[desc.pipeline];
+        if (!pipeline_impl)
+            continue;
+        FR_ASSERT(desc.binding_set.size() == pipeline_impl->desc.binding_layout.size());
+        for (size_t i = 0; i < desc.binding_set.size(); ++i) {
+            const DescriptorType type = pipeline_impl->desc.binding_layout[i].type;
+            if (type == DescriptorType::Sampler)
+                continue;
+            const bool write = type == DescriptorType::RWStructuredBuffer || type == DescriptorType::RWBuffer ||
+                               type == DescriptorType::RWTexture;
+            const ResourceHandle &resource = desc.binding_set[i].resource;
+            for (const auto &[other, other_write] : accesses)
+                FR_ASSERT(other != resource || write == other_write);
+            accesses.emplace_back(resource, write);
+        }
+    }
+
+    for (const DispatchDesc &desc : descs)
+        dispatch(context, desc);
+}
+
+void CpuDevice::begin_scope(ContextHandle context, std::string name)
+{
+    CpuContext *context_impl = m_impl->contexts[context];
+    if (!context_impl || !context_impl->desc.enable_timestamps)
+        return;
+
+    FR_ASSERT(context_impl->is_recording);
+    // scopes that don't fit are dropped, like the queries of the Vulkan backend
+    const bool timed = context_impl->timed_scope_count < context_impl->desc.max_timestamp_scopes;
+    if (timed)
+        context_impl->timed_scope_count++;
+    context_impl->open_scopes.push_back({
+        .name = std::move(name),
+        .depth = static_cast<uint32_t>(context_impl->open_scopes.size()),
+        .start_us = Profiler::global().now_us(),
+        .duration_us = 0.0,
+        .timed = timed,
+    });
+}
+
+void CpuDevice::end_scope(ContextHandle context)
+{
+    CpuContext *context_impl = m_impl->contexts[context];
+    if (!context_impl || context_impl->open_scopes.empty())
+        return;
+
+    CpuScope scope = std::move(context_impl->open_scopes.back());
+    context_impl->open_scopes.pop_back();
+    scope.duration_us = Profiler::global().now_us() - scope.start_us;
+    context_impl->closed_scopes.push_back(std::move(scope));
+}
+
+std::vector<GpuTiming> CpuDevice::take_timings(ContextHandle context)
+{
+    CpuContext *context_impl = m_impl->contexts[context];
+    if (!context_impl)
+        return {};
+
+    return std::exchange(context_impl->timings, {});
+}
+
+uint32_t CpuDevice::max_workgroup_invocations() const
+{
+    // kernels loop over their invocations, the limit of common GPUs keeps tuned sizes portable
+    return 1024;
+}
+
+MemoryStats CpuDevice::memory_stats() const
+{
+    std::lock_guard<std::mutex> lock(m_impl->memory_mutex);
+    return {
+        .allocation_count = m_impl->resource_count,
+        .resource_count = m_impl->resource_count,
+        .allocated_bytes = m_impl->used_bytes,
+        .used_bytes = m_impl->used_bytes,
+    };
+}
+
+FR_NAMESPACE_END
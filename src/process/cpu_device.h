@@ -0,0 +1,153 @@
+#pragma once
+
+#include "device.h"
+
+#include <functional>
+#include <span>
+
+FR_NAMESPACE_BEGIN
+
+/// Resource bound to a CPU kernel, resolved to host memory.
+struct CpuBinding {
+    uint32_t binding{0};
+    /// Buffer contents, or the base mip level of the first bound layer of an image (nullptr for samplers).
+    uint8_t *data{nullptr};
+    size_t size{0};         ///< Size of the buffer or of one layer of the bound level in bytes.
+    ImageFormat format{ImageFormat::Unknown};
+    uint32_t width{0};      ///< Size of the bound mip level.
+    uint32_t height{0};
+    uint32_t layer_count{0};
+    size_t row_pitch{0};    ///< Bytes between rows of texel blocks.
+    size_t layer_pitch{0};  ///< Bytes between array layers.
+    uint32_t texel_size{0};
+    const SamplerDesc *sampler{nullptr};
+
+    template <typename T>
+    T *buffer() const
+    {
+        return reinterpret_cast<T *>(data);
+    }
+
+    /// First channel of a texel of a (non block-compressed) image.
+    template <typename T>
+    T *texel(uint32_t x, uint32_t y, uint32_t layer = 0) const
+    {
+        return reinterpret_cast<T *>(data + layer * layer_pitch + y * row_pitch + size_t(x) * texel_size);
+    }
+};
+
+/// Arguments of a CPU kernel call, which executes one workgroup of the dispatch grid.
+struct CpuKernelArgs {
+    std::span<const CpuBinding> bindings;  ///< In DispatchDesc::binding_set order.
+    /// Bindless image arrays of bindless pipelines, images not declared by the dispatch have null data.
+    std::span<const CpuBinding> bindless_textures;
+    std::span<const CpuBinding> bindless_rw_textures;
+    const void *push_constants{nullptr};
+    std::span<const SpecializationConstant> specialization_constants;  ///< PipelineDesc::specialization_constants
+    /// Workgroup size of the pipeline, the kernel must process this many invocations per group.
+    WorkgroupSize workgroup_size{};
+    uint32_t group_id[3]{};
+
+    template <typename T>
+    const T &constants() const
+    {
+        return *static_cast<const T *>(push_constants);
+    }
+
+    /// Value of a specialization constant, or its default value if the pipeline does not set it.
+    uint32_t specialization_constant(uint32_t id, uint32_t default_value) const
+    {
+        for (const SpecializationConstant &constant : specialization_constants) {
+            if (constant.id == id)
+                return constant.value;
+        }
+        return default_value;
+    }
+};
+
+/// C++ equivalent of a compute shader, called once per workgroup (in parallel) by the CPU backend.
+using CpuKernel = std::function<void(const CpuKernelArgs &args)>;
+
+/**
+ * Register the CPU equivalent of a compute shader, used by pipelines of the CPU backend.
+ * @param code Shader code the kernel replaces (ShaderDesc::code), e.g. get_shader_blob(id).data().
+ */
+void register_cpu_kernel(const void *code, CpuKernel kernel);
+
+struct CpuDeviceImpl;
+
+/**
+ * CPU backend of Device (DeviceBackend::Cpu).
+ *
+ * Resources live in host memory and commands execute immediately while being recorded: copies with memcpy,
+ * dispatches by calling the registered kernel for every workgroup on a thread pool. Submissions are therefore
+ * complete when submit() returns, which keeps the context value semantics of the Vulkan backend.
+ */
+class CpuDevice {
+public:
+    CpuDevice(const DeviceDesc &desc);
+    ~CpuDevice();
+
+    ShaderHandle create_shader(const ShaderDesc &desc);
+    void destroy_shader(ShaderHandle shader);
+
+    BufferHandle create_buffer(const BufferDesc &desc);
+    void destroy_buffer(BufferHandle buffer);
+
+    ImageHandle create_image(const ImageDesc &desc);
+    void destroy_image(ImageHandle image);
+
+    SamplerHandle create_sampler(const SamplerDesc &desc);
+    void destroy_sampler(SamplerHandle sampler);
+
+    PipelineHandle create_pipeline(const PipelineDesc &desc);
+    std::vector<PipelineHandle> create_pipelines(std::span<const PipelineDesc> descs);
+    void destroy_pipeline(PipelineHandle pipeline);
+
+    uint32_t add_bindless_image(ImageHandle image, DescriptorType type, const ImageSubresourceRange &subresource);
+    void remove_bindless_image(DescriptorType type, uint32_t index);
+
+    ContextHandle create_context(const ContextDesc &desc);
+    void destroy_context(ContextHandle context);
+
+    void begin(ContextHandle context);
+    uint64_t submit(ContextHandle context);
+    uint64_t completed_value(ContextHandle context) const;
+
+    std::span<uint8_t> map_buffer(BufferHandle buffer);
+
+    void write_buffer(ContextHandle context, BufferHandle buffer, const void *data, size_t size, size_t offset);
+    void read_buffer(ContextHandle context, BufferHandle buffer, void *data, size_t size, size_t offset);
+    void copy_buffer(ContextHandle context, BufferHandle src, BufferHandle dst, size_t size, size_t src_offset,
+                     size_t dst_offset);
+
+    void write_image(ContextHandle context, ImageHandle image, const ImageRegion &region, const void *data,
+                     size_t row_pitch);
+    void read_image(ContextHandle context, ImageHandle image, const ImageRegion &region, void *data,
+                    size_t row_pitch);
+    void copy_buffer_to_image(ContextHandle context, BufferHandle src, ImageHandle dst, const ImageRegion &region,
+                              size_t src_offset, size_t src_row_pitch);
+    void copy_image_to_buffer(ContextHandle context, ImageHandle src, BufferHandle dst, const ImageRegion &region,
+                              size_t dst_offset, size_t dst_row_pitch);
+    void copy_image(ContextHandle context, ImageHandle src, ImageHandle dst, uint32_t width, uint32_t height);
+
+    void generate_mips(ContextHandle context, ImageHandle image);
+
+    void dispatch(ContextHandle context, const DispatchDesc &desc);
+    void dispatch_batch(ContextHandle context, std::span<const DispatchDesc> descs);
+
+    void begin_scope(ContextHandle context, std::string name);
+    void end_scope(ContextHandle context);
+    std::vector<GpuTiming> take_timings(ContextHandle context);
+
+    MemoryStats memory_stats() const;
+    uint32_t max_workgroup_invocations() const;
+
+private:
+    CpuDevice(const CpuDevice &) = delete;
+    CpuDevice &operator=(const CpuDevice &) = delete;
+
+    std::unique_ptr<CpuDeviceImpl> m_impl;
+};
+
+FR_NAMESPACE_END
@@ -0,0 +1,441 @@
+#include "process/cpu_device.h"
+#include "process/cpu_test_kernels.h"
+#include "process/compute_graph.h"
+#include "shaders/shaders.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include <doctest/doctest.h>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("process");
+
+TEST_CASE("cpu device")
+{
+    register_test_kernels();
+
+    Device device({.backend = DeviceBackend::Cpu, .bindless_image_count = 16, .cpu_thread_count = 4});
+    CHECK(device.has_dedicated_queue(QueueType::Graphics));
+    CHECK_FALSE(device.has_dedicated_queue(QueueType::Compute));
+
+    ContextHandle context = device.create_context({.enable_timestamps = true});
+
+    SUBCASE("buffers")
+    {
+        static const size_t N = 1000;
+
+        std::vector<float> buffer0_data(N);
+        std::vector<float> buffer1_data(N);
+        for (size_t i = 0; i < N; ++i) {
+            buffer0_data[i] = float(i);
+            buffer1_data[i] = float(i * 10);
+        }
+
+        const BufferDesc buffer_desc{
+            .size = N * sizeof(float),
+            .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess | ResourceUsage::TransferSrc |
+                     ResourceUsage::TransferDst,
+        };
+        BufferHandle buffer0 = device.create_buffer(buffer_desc);
+        BufferHandle buffer1 = device.create_buffer(buffer_desc);
+        BufferHandle result = device.create_buffer(buffer_desc);
+        BufferHandle readback = device.create_buffer({
+            .size = N * sizeof(float),
+            .usage = ResourceUsage::TransferDst,
+            .memory = MemoryType::Readback,
+        });
+        CHECK_EQ(device.memory_stats().resource_count, 4);
+        CHECK(device.map_buffer(buffer0).empty());
+
+        ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+        ShaderHandle shader = device.create_shader({.code = blob.data(), .code_size = blob.size_bytes()});
+        PipelineHandle pipeline = device.create_pipeline({
+            .shader = shader,
+            .binding_layout{
+                {.binding = 0, .type = DescriptorType::StructuredBuffer},
+                {.binding = 1, .type = DescriptorType::StructuredBuffer},
+                {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+            },
+            .push_constants_size = 4,
+        });
+
+        device.begin(context);
+        device.begin_scope(context, "add");
+        device.write_buffer(context, buffer0, buffer0_data.data(), N * sizeof(float));
+        device.write_buffer(context, buffer1, buffer1_data.data(), N * sizeof(float));
+        uint32_t push_constants = N;
+        device.dispatch(context, {
+                                     .pipeline = pipeline,
+                                     .binding_set{
+                                         {.binding = 0, .resource = buffer0},
+                                         {.binding = 1, .resource = buffer1},
+                                         {.binding = 2, .resource = result},
+                                     },
+                                     .push_constants = &push_constants,
+                                     .push_constants_size = sizeof(push_constants),
+                                     .group_count{(N + 255) / 256, 1, 1},
+                                 });
+        device.end_scope(context);
+        device.copy_buffer(context, result, readback, N * sizeof(float));
+        uint64_t value = device.submit(context);
+        CHECK(device.wait(context));
+        CHECK_EQ(device.completed_value(context), value);
+
+        const float *result_data = reinterpret_cast<const float *>(device.map_buffer(readback).data());
+        CHECK_EQ(result_data[1], 11.f);
+        CHECK_EQ(result_data[N - 1], float((N - 1) * 11));
+
+        std::vector<GpuTiming> timings = device.take_timings(context);
+        REQUIRE_EQ(timings.size(), 1);
+        CHECK_EQ(timings[0].name, "add");
+
+        device.destroy_pipeline(pipeline);
+        device.destroy_shader(shader);
+        device.destroy_buffer(buffer0);
+        device.destroy_buffer(buffer1);
+        device.destroy_buffer(result);
+        device.destroy_buffer(readback);
+        CHECK_EQ(device.memory_stats().resource_count, 0);
+    }
+
+    SUBCASE("indirect and batch")
+    {
+        static const uint32_t N = 1024;
+
+        const BufferDesc buffer_desc{
+            .size = N * sizeof(float),
+            .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess | ResourceUsage::TransferDst,
+        };
+        BufferHandle input = device.create_buffer(buffer_desc);
+        BufferHandle results[2] = {device.create_buffer(buffer_desc), device.create_buffer(buffer_desc)};
+        BufferHandle args = device.create_buffer({
+            .size = 3 * sizeof(uint32_t),
+            .usage = ResourceUsage::IndirectArgument | ResourceUsage::TransferDst,
+        });
+
+        ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+        ShaderHandle shader = device.create_shader({.code = blob.data(), .code_size = blob.size_bytes()});
+        PipelineHandle pipeline = device.create_pipeline({
+            .shader = shader,
+            .binding_layout{
+                {.binding = 0, .type = DescriptorType::StructuredBuffer},
+                {.binding = 1, .type = DescriptorType::StructuredBuffer},
+                {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+            },
+            .push_constants_size = 4,
+        });
+
+        std::vector<float> data(N, 1.f);
+        const uint32_t group_count[3] = {2, 1, 1};
+        uint32_t push_constants = N;
+        auto add = [&](BufferHandle result) {
+            return DispatchDesc{
+                .pipeline = pipeline,
+                .binding_set{
+                    {.binding = 0, .resource = input},
+                    {.binding = 1, .resource = input},
+                    {.binding = 2, .resource = result},
+                },
+                .push_constants = &push_constants,
+                .push_constants_size = sizeof(push_constants),
+                .group_count{N / 256, 1, 1},
+            };
+        };
+
+        device.begin(context);
+        device.write_buffer(context, input, data.data(), N * sizeof(float));
+        device.write_buffer(context, args, group_count, sizeof(group_count));
+
+        // only the first 2 groups run
+        DispatchDesc indirect = add(results[0]);
+        indirect.indirect_buffer = args;
+        device.dispatch(context, indirect);
+        std::vector<float> result(N);
+        device.read_buffer(context, results[0], result.data(), N * sizeof(float));
+        CHECK_EQ(result[511], 2.f);
+        CHECK_EQ(result[512], 0.f);
+
+        const DispatchDesc batch[] = {add(results[0]), add(results[1])};
+        device.dispatch_batch(context, batch);
+        for (BufferHandle buffer : results) {
+            device.read_buffer(context, buffer, result.data(), N * sizeof(float));
+            CHECK_EQ(result[0], 2.f);
+            CHECK_EQ(result[N - 1], 2.f);
+        }
+        device.submit(context);
+        device.wait(context);
+
+        device.destroy_pipeline(pipeline);
+        device.destroy_shader(shader);
+        device.destroy_buffer(input);
+        for (BufferHandle buffer : results)
+            device.destroy_buffer(buffer);
+        device.destroy_buffer(args);
+    }
+
+    SUBCASE("specialization")
+    {
+        static const uint32_t N = 1000;
+
+        // Kernel without a shader, scaling by specialization constant 0.
+        static const char scale_kernel_code[] = "scale";
+        register_cpu_kernel(scale_kernel_code, [](const CpuKernelArgs &args) {
+            const float scale = std::bit_cast<float>(args.specialization_constant(0, std::bit_cast<uint32_t>(1.f)));
+            float *data = args.bindings[0].buffer<float>();
+            for (uint32_t i = args.group_id[0] * args.workgroup_size[0];
+                 i < std::min((args.group_id[0] + 1) * args.workgroup_size[0], N); ++i)
+                data[i] *= scale;
+        });
+
+        const BufferDesc buffer_desc{
+            .size = N * sizeof(float),
+            .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess | ResourceUsage::TransferDst,
+        };
+        BufferHandle input = device.create_buffer(buffer_desc);
+        BufferHandle result = device.create_buffer(buffer_desc);
+
+        // numthreads(256, 1, 1) of the shader, or the pipeline's override
+        ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+        ShaderHandle shader = device.create_shader({.code = blob.data(), .code_size = blob.size_bytes()});
+        PipelineDesc pipeline_desc{
+            .shader = shader,
+            .binding_layout{
+                {.binding = 0, .type = DescriptorType::StructuredBuffer},
+                {.binding = 1, .type = DescriptorType::StructuredBuffer},
+                {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+            },
+            .push_constants_size = 4,
+            .workgroup_size{64, 1, 1},
+        };
+        PipelineHandle pipeline = device.create_pipeline(pipeline_desc);
+        pipeline_desc.workgroup_size = {2048, 1, 1};
+        CHECK_THROWS(device.create_pipeline(pipeline_desc));
+
+        ShaderHandle scale_shader =
+            device.create_shader({.code = scale_kernel_code, .code_size = sizeof(scale_kernel_code)});
+        PipelineHandle scale_pipeline = device.create_pipeline({
+            .shader = scale_shader,
+            .binding_layout{{.binding = 0, .type = DescriptorType::RWStructuredBuffer}},
+            .specialization_constants{{.id = 0, .value = std::bit_cast<uint32_t>(3.f)}},
+            .workgroup_size{100, 1, 1},
+        });
+
+        std::vector<float> data(N, 1.f);
+        uint32_t push_constants = N;
+        device.begin(context);
+        device.write_buffer(context, input, data.data(), N * sizeof(float));
+        device.dispatch(context, {
+                                     .pipeline = pipeline,
+                                     .binding_set{
+                                         {.binding = 0, .resource = input},
+                                         {.binding = 1, .resource = input},
+                                         {.binding = 2, .resource = result},
+                                     },
+                                     .push_constants = &push_constants,
+                                     .push_constants_size = sizeof(push_constants),
+                                     .group_count{(N + 63) / 64, 1, 1},
+                                 });
+        device.dispatch(context, {
+                                     .pipeline = scale_pipeline,
+                                     .binding_set{{.binding = 0, .resource = result}},
+                                     .group_count{N / 100, 1, 1},
+                                 });
+        device.read_buffer(context, result, data.data(), N * sizeof(float));
+        device.submit(context);
+        device.wait(context);
+        CHECK_EQ(data[0], 6.f);
+        CHECK_EQ(data[N - 1], 6.f);
+
+        device.destroy_pipeline(pipeline);
+        device.destroy_pipeline(scale_pipeline);
+        device.destroy_shader(shader);
+        device.destroy_shader(scale_shader);
+        device.destroy_buffer(input);
+        device.destroy_buffer(result);
+    }
+
+    SUBCASE("images")
+    {
+        static const uint32_t W = 64;
+        static const uint32_t H = 32;
+
+        ImageHandle image = device.create_image({
+            .width = W,
+            .height = H,
+            .format = ImageFormat::RGBA8Unorm,
+            .usage = ResourceUsage::ShaderResource | ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+            .mip_levels = mip_level_count(W, H),
+            .array_layers = 2,
+        });
+
+        device.begin(context);
+
+        // Region write from a source with its own row pitch.
+        std::vector<uint32_t> src(10 * 4, 0x01020304);
+        device.write_image(context, image, {.x = 8, .y = 4, .width = 8, .height = 4, .array_layer = 1}, src.data(),
+                           10 * sizeof(uint32_t));
+        std::vector<uint32_t> layer(W * H);
+        device.read_image(context, image, {.array_layer = 1}, layer.data());
+        CHECK_EQ(layer[4 * W + 8], 0x01020304);
+        CHECK_EQ(layer[7 * W + 15], 0x01020304);
+        CHECK_EQ(layer[7 * W + 16], 0);
+
+        // A constant level 0 stays constant down the mip chain.
+        std::vector<uint32_t> constant(W * H, 0xff804020);
+        device.write_image(context, image, constant.data(), constant.size() * sizeof(uint32_t));
+        device.generate_mips(context, image);
+        uint32_t last_level = 0;
+        device.read_image(context, image, {.mip_level = mip_level_count(W, H) - 1}, &last_level);
+        CHECK_EQ(last_level, 0xff804020);
+
+        device.submit(context);
+        device.wait(context);
+
+        device.destroy_image(image);
+    }
+
+    SUBCASE("compute graph")
+    {
+        static const uint32_t N = 100;
+
+        const ImageDesc image_desc{
+            .width = N,
+            .height = N,
+            .format = ImageFormat::RGBA32Float,
+            .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess,
+        };
+
+        ShaderBlob blob = get_shader_blob(ShaderID::test_image_cs);
+        ShaderHandle shader = device.create_shader({.code = blob.data(), .code_size = blob.size_bytes()});
+        PipelineHandle pipeline = device.create_pipeline({
+            .shader = shader,
+            .binding_layout{
+                {.binding = 0, .type = DescriptorType::Texture},
+                {.binding = 1, .type = DescriptorType::RWTexture},
+            },
+            .push_constants_size = 8,
+        });
+        ImageHandle input_image = device.create_image(image_desc);
+        ImageHandle output_image = device.create_image(image_desc);
+
+        ComputeGraph graph(device);
+        auto add_stage = [&](GraphResource src, GraphResource dst) {
+            auto func = [=](Device &device, ContextHandle context, const ComputeGraph::PassResources &resources) {
+                uint32_t push_constants[2] = {N, N};
+                device.dispatch(context, {
+                                             .pipeline = pipeline,
+                                             .binding_set{
+                                                 {.binding = 0, .resource = resources.image(src)},
+                                                 {.binding = 1, .resource = resources.image(dst)},
+                                             },
+                                             .push_constants = &push_constants,
+                                             .push_constants_size = sizeof(push_constants),
+                                             .group_count{(N + 31) / 32, (N + 31) / 32, 1},
+                                         });
+            };
+            graph.add_pass("stage", {src}, {dst}, func);
+        };
+        auto input = graph.import_image("input", input_image);
+        auto a = graph.create_image("a", image_desc);
+        auto output = graph.import_image("output", output_image);
+        add_stage(input, a);
+        add_stage(a, output);
+
+        std::vector<float> data(N * N * 4, 1.f);
+        device.begin(context);
+        device.write_image(context, input_image, data.data(), data.size() * sizeof(float));
+        graph.execute(context);
+        device.read_image(context, output_image, data.data(), data.size() * sizeof(float));
+        device.submit(context);
+        device.wait(context);
+
+        // (1 * 2 + 1) * 2 + 1
+        CHECK_EQ(data[0], 7.f);
+        CHECK_EQ(data.back(), 7.f);
+        CHECK_EQ(device.take_timings(context).size(), 2);
+
+        device.destroy_image(input_image);
+        device.destroy_image(output_image);
+        device.destroy_pipeline(pipeline);
+        device.destroy_shader(shader);
+    }
+
+    SUBCASE("bindless")
+    {
+        // Kernel without a shader, summing the first texel of the declared bindless textures.
+        static const char sum_kernel_code[] = "sum";
+        register_cpu_kernel(sum_kernel_code, [](const CpuKernelArgs &args) {
+            float sum = 0.f;
+            for (const CpuBinding &texture : args.bindless_textures) {
+                if (texture.data)
+                    sum += *texture.texel<float>(0, 0);
+            }
+            *args.bindless_rw_textures[0].texel<float>(0, 0) = sum;
+        });
+
+        const ImageDesc image_desc{
+            .width = 4,
+            .height = 4,
+            .format = ImageFormat::R32Float,
+            .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess,
+        };
+        ImageHandle images[4];
+        for (ImageHandle &image : images)
+            image = device.create_image(image_desc);
+        ImageHandle output = device.create_image(image_desc);
+
+        for (uint32_t i = 0; i < 4; ++i)
+            CHECK_EQ(device.add_bindless_image(images[i], DescriptorType::Texture), i);
+        device.remove_bindless_image(DescriptorType::Texture, 2);
+        CHECK_EQ(device.add_bindless_image(output, DescriptorType::RWTexture), 0);
+
+        ShaderHandle shader = device.create_shader({.code = sum_kernel_code, .code_size = sizeof(sum_kernel_code)});
+        PipelineHandle pipeline = device.create_pipeline({.shader = shader, .bindless = true});
+
+        device.begin(context);
+        for (uint32_t i = 0; i < 4; ++i) {
+            float value = float(1 << i);
+            device.write_image(context, images[i], {.width = 1, .height = 1}, &value);
+        }
+        const uint32_t textures[] = {0, 1, 3};
+        const uint32_t rw_textures[] = {0};
+        device.dispatch(context, {
+                                     .pipeline = pipeline,
+                                     .group_count{1, 1, 1},
+                                     .bindless_textures = textures,
+                                     .bindless_rw_textures = rw_textures,
+                                 });
+        float sum = 0.f;
+        device.read_image(context, output, {.width = 1, .height = 1}, &sum);
+        device.submit(context);
+        device.wait(context);
+        CHECK_EQ(sum, 1.f + 2.f + 8.f);
+
+        // undeclared textures are not accessible
+        const uint32_t first_texture[] = {0};
+        device.begin(context);
+        device.dispatch(context, {
+                                     .pipeline = pipeline,
+                                     .group_count{1, 1, 1},
+                                     .bindless_textures = first_texture,
+                                     .bindless_rw_textures = rw_textures,
+                                 });
+        device.read_image(context, output, {.width = 1, .height = 1}, &sum);
+        device.submit(context);
+        device.wait(context);
+        CHECK_EQ(sum, 1.f);
+
+        device.destroy_pipeline(pipeline);
+        device.destroy_shader(shader);
+        for (ImageHandle image : images)
+            device.destroy_image(image);
+        device.destroy_image(output);
+    }
+
+    device.destroy_context(context);
+}
+
+TEST_SUITE_END();
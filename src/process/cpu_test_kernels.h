@@ -0,0 +1,38 @@
+#pragma once
+
+#include "cpu_device.h"
+#include "shaders/shaders.h"
+
+#include <algorithm>
+
+FR_NAMESPACE_BEGIN
+
+/// C++ equivalents of the test shaders.
+inline void register_test_kernels()
+{
+    register_cpu_kernel(get_shader_blob(ShaderID::test_buffer_cs).data(), [](const CpuKernelArgs &args) {
+        const uint32_t count = args.constants<uint32_t>();
+        const uint32_t size = args.workgroup_size[0];
+        const float *buffer0 = args.bindings[0].buffer<float>();
+        const float *buffer1 = args.bindings[1].buffer<float>();
+        float *result = args.bindings[2].buffer<float>();
+        for (uint32_t i = args.group_id[0] * size; i < std::min((args.group_id[0] + 1) * size, count); ++i)
+            result[i] = buffer0[i] + buffer1[i];
+    });
+
+    register_cpu_kernel(get_shader_blob(ShaderID::test_image_cs).data(), [](const CpuKernelArgs &args) {
+        const uint32_t *res = &args.constants<uint32_t>();
+        const WorkgroupSize &size = args.workgroup_size;
+        const CpuBinding &src = args.bindings[0];
+        const CpuBinding &dst = args.bindings[1];
+        for (uint32_t y = args.group_id[1] * size[1]; y < std::min((args.group_id[1] + 1) * size[1], res[1]); ++y) {
+            for (uint32_t x = args.group_id[0] * size[0]; x < std::min((args.group_id[0] + 1) * size[0], res[0]);
+                 ++x) {
+                for (uint32_t c = 0; c < 4; ++c)
+                    dst.texel<float>(x, y)[c] = src.texel<float>(x, y)[c] * 2.f + 1.f;
+            }
+        }
+    });
+}
+
+FR_NAMESPACE_END
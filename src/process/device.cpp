@@ -1,4 +1,10 @@
 #include "device.h"
+#include "cpu_device.h"
+#include "image_regions.h"
+#include "spirv.h"
+#include "core/arena.h"
+#include "core/buddy_allocator.h"
+#include "core/profiler.h"
 
 #define VK_NO_PROTOTYPES
 #include <vulkan/vulkan.h>
@@ -9,15 +15,24 @@
 
 #include <spdlog/spdlog.h>
 #include <fmt/core.h>
-
+#include <BS_thread_pool.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <numeric>
 #include <optional>
 #include <stdexcept>
 #include <vector>
 
-#define VK_CHECK(call)                                                                                            \
-    if (VkResult result = call; result != VK_SUCCESS) {                                                           \
-        throw std::runtime_error(                                                                                 \
-            fmt::format("{}:{} VK error:\n{} failed with result {}", __FILE__, __LINE__, #call, result).c_str()); \
+#define VK_CHECK(call)                                                                                                \
+    if (VkResult vk_check_result_ = call; vk_check_result_ != VK_SUCCESS) {                                           \
+        throw std::runtime_error(fmt::format("{}:{} VK error:\n{} failed with result {}", __FILE__, __LINE__, #call,  \
+                                             vk_check_result_)                                                        \
+                                     .c_str());                                                                       \
     }
 
 FR_NAMESPACE_BEGIN
@@ -94,13 +109,93 @@ static const VkFormat IMAGE_FORMAT_MAP[] = {
     VK_FORMAT_R32G32B32A32_SINT,
     // ImageFormat::RGBA32Float
     VK_FORMAT_R32G32B32A32_SFLOAT,
+
+    // ImageFormat::BC1Unorm
+    VK_FORMAT_BC1_RGBA_UNORM_BLOCK,
+};
+
+static const ImageFormatInfo IMAGE_FORMAT_INFO_MAP[] = {
+    // ImageFormat::Unknown
+    {0, 1},
+
+    // ImageFormat::R8Unorm
+    {1, 1},
+    // ImageFormat::R8Snorm
+    {1, 1},
+    // ImageFormat::R8UInt
+    {1, 1},
+    // ImageFormat::R8Int
+    {1, 1},
+    // ImageFormat::R16Uint
+    {2, 1},
+    // ImageFormat::R16Int
+    {2, 1},
+    // ImageFormat::R16Float
+    {2, 1},
+    // ImageFormat::R32Uint
+    {4, 1},
+    // ImageFormat::R32Int
+    {4, 1},
+    // ImageFormat::R32Float
+    {4, 1},
+
+    // ImageFormat::RG16Uint
+    {4, 1},
+    // ImageFormat::RG16Int
+    {4, 1},
+    // ImageFormat::RG16Float
+    {4, 1},
+    // ImageFormat::RG32Uint
+    {8, 1},
+    // ImageFormat::RG32Int
+    {8, 1},
+    // ImageFormat::RG32Float
+    {8, 1},
+
+    // ImageFormat::RGB16Uint
+    {6, 1},
+    // ImageFormat::RGB16Int
+    {6, 1},
+    // ImageFormat::RGB16Float
+    {6, 1},
+    // ImageFormat::RGB32Uint
+    {12, 1},
+    // ImageFormat::RGB32Int
+    {12, 1},
+    // ImageFormat::RGB32Float
+    {12, 1},
+
+    // ImageFormat::RGBA8Unorm
+    {4, 1},
+    // ImageFormat::RGBA16Uint
+    {8, 1},
+    // ImageFormat::RGBA16Int
+    {8, 1},
+    // ImageFormat::RGBA16Float
+    {8, 1},
+    // ImageFormat::RGBA32Uint
+    {16, 1},
+    // ImageFormat::RGBA32Int
+    {16, 1},
+    // ImageFormat::RGBA32Float
+    {16, 1},
+
+    // ImageFormat::BC1Unorm
+    {8, 4},
 };
 
+const ImageFormatInfo &get_image_format_info(ImageFormat format)
+{
+    return IMAGE_FORMAT_INFO_MAP[static_cast<size_t>(format)];
+}
+
 const VkMemoryPropertyFlags MEMORY_TYPE_MAP[] = {
     // MemoryType::Host
     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
     // MemoryType::Device
     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    // MemoryType::Readback
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
 };
 
 struct ResourceUsageInfo {
@@ -121,6 +216,8 @@ const ResourceUsageInfo RESOURCE_USAGE_MAP[] = {
     {VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT},
     // ResourceUsage::TransferSrc
     {VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT},
+    // ResourceUsage::IndirectArgument
+    {VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, 0},
 };
 
 inline ResourceUsageInfo get_resource_usage_info(ResourceUsage usage)
@@ -138,23 +235,37 @@ inline ResourceUsageInfo get_resource_usage_info(ResourceUsage usage)
 struct ResourceStateInfo {
     VkImageLayout layout;
     VkAccessFlags access;
+    VkPipelineStageFlags stages;  ///< Stages accessing the resource in this state.
 };
 
 const ResourceStateInfo RESOURCE_STATE_MAP[] = {
     // ResourceState::Undefined
-    {VK_IMAGE_LAYOUT_UNDEFINED, 0},
+    {VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT},
     // ResourceState::ConstantBuffer
-    {VK_IMAGE_LAYOUT_UNDEFINED, 0},
+    {VK_IMAGE_LAYOUT_UNDEFINED, VK_ACCESS_UNIFORM_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT},
     // ResourceState::UnorderedAccess
-    {VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT},
+    {VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
+     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT},
     // ResourceState::ShaderResource
-    {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT},
+    {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT},
     // ResourceState::TransferDst
-    {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT},
+    {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT},
     // ResourceState::TransferSrc
-    {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT},
+    {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT},
+    // ResourceState::IndirectArgument
+    {VK_IMAGE_LAYOUT_UNDEFINED, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT},
 };
 
+/// Access flags that need to be made available by a barrier, reads only need an execution dependency.
+const VkAccessFlags WRITE_ACCESS_MASK = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+/// True if a resource can stay in a state without a barrier (no writes to order).
+inline bool is_read_only_state(ResourceState state)
+{
+    return state == ResourceState::ConstantBuffer || state == ResourceState::ShaderResource ||
+           state == ResourceState::TransferSrc || state == ResourceState::IndirectArgument;
+}
+
 struct DescriptorTypeInfo {
     VkDescriptorType type;
     VkImageLayout layout;
@@ -228,26 +339,102 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(VkDebugUtilsMessageSeverity
 
 struct ShaderImpl {
     ShaderDesc desc;
+    std::vector<uint32_t> code;  ///< Copy of the SPIR-V, patched for pipelines overriding the workgroup size.
     VkShaderModule vk_shader_module;
 };
 
+/// Device memory block that resources are sub-allocated from.
+struct MemoryBlock {
+    VkDeviceMemory vk_device_memory{VK_NULL_HANDLE};
+    uint8_t *mapped{nullptr};
+    BuddyAllocator allocator;
+};
+
+/**
+ * Memory blocks of a single memory type.
+ * Linear resources (buffers, linear images) and optimal images use separate pools so that
+ * bufferImageGranularity never has to be considered. Transient pools keep their empty blocks
+ * for reuse, other pools keep one empty block and release the others when a submission retires.
+ */
+struct MemoryPool {
+    uint32_t memory_type_index;
+    bool linear;
+    bool transient;
+    std::vector<std::unique_ptr<MemoryBlock>> blocks;
+};
+
+struct MemoryAllocation {
+    VkDeviceMemory vk_device_memory{VK_NULL_HANDLE};
+    VkDeviceSize offset{0};
+    VkDeviceSize size{0};
+    uint8_t *mapped{nullptr};  ///< Persistently mapped pointer (host memory only).
+    bool coherent{true};        ///< False if mapped ranges need to be flushed/invalidated.
+    MemoryPool *pool{nullptr};  ///< nullptr for dedicated allocations.
+    MemoryBlock *block{nullptr};
+};
+
+struct BufferViewKey {
+    VkFormat format;
+    VkDeviceSize offset;
+    VkDeviceSize range;
+
+    bool operator==(const BufferViewKey &other) const = default;
+};
+
+struct ImageViewKey {
+    VkFormat format;
+    uint32_t base_mip_level;
+    uint32_t mip_level_count;
+    uint32_t base_array_layer;
+    uint32_t array_layer_count;
+
+    bool operator==(const ImageViewKey &other) const = default;
+};
+
+/// Submission of a context referencing a resource, which is in use until the context's semaphore reaches value.
+struct ResourceUse {
+    ContextHandle context;
+    uint64_t value;
+};
+
 struct BufferImpl {
     BufferDesc desc;
     ResourceState state;
-    VkDeviceMemory vk_device_memory;
+    MemoryAllocation allocation;
     VkBuffer vk_buffer;
+    // Views are created on first use and destroyed with the buffer.
+    std::vector<std::pair<BufferViewKey, VkBufferView>> views;
+    std::vector<ResourceUse> uses;  ///< Last submission of every context that recorded the buffer.
 };
 
 struct ImageImpl {
     ImageDesc desc;
-    ResourceState state;
-    VkDeviceMemory vk_device_memory;
+    /// State of each subresource, indexed by mip_level * array_layers + array_layer.
+    std::vector<ResourceState> states;
+    MemoryAllocation allocation;
     VkImage vk_image;
+    // Views are created on first use and destroyed with the image, guarded by DeviceImpl::view_mutex.
+    std::vector<std::pair<ImageViewKey, VkImageView>> views;
+    VkSubresourceLayout linear_layout;  ///< Memory layout of linear (host memory) images.
+    std::vector<ResourceUse> uses;      ///< Last submission of every context that recorded the image.
+    uint32_t bindless_slot_count;       ///< Number of bindless array slots holding the image.
 };
 
 struct SamplerImpl {
     SamplerDesc desc;
     VkSampler vk_sampler;
+    std::vector<ResourceUse> uses;  ///< Last submission of every context that recorded the sampler.
+};
+
+/// Vulkan objects of a destroyed resource, released once every submission that referenced it has completed.
+struct DeferredDestruction {
+    std::vector<ResourceUse> uses;
+    VkBuffer vk_buffer{VK_NULL_HANDLE};
+    VkImage vk_image{VK_NULL_HANDLE};
+    VkSampler vk_sampler{VK_NULL_HANDLE};
+    std::vector<VkBufferView> vk_buffer_views;
+    std::vector<VkImageView> vk_image_views;
+    MemoryAllocation allocation;
 };
 
 struct PipelineImpl {
@@ -257,28 +444,188 @@ struct PipelineImpl {
     VkPipeline vk_pipeline;
 };
 
-struct DescriptorSet {
-    VkDescriptorSet vk_descriptor_set;
+/// Image in a bindless array.
+struct BindlessSlot {
+    ImageHandle image{ImageHandle::null()};
+    ImageSubresourceRange subresource;  ///< Resolved range.
+};
+
+/// Bindless image array, indices of removed images are reused.
+struct BindlessArray {
+    std::vector<BindlessSlot> slots;
+    std::vector<uint32_t> free_indices;
+};
 
-    std::vector<VkImageView> vk_image_views;
-    std::vector<VkBufferView> vk_buffer_views;
+/// Bindings of the bindless descriptor set.
+static const uint32_t BINDLESS_TEXTURE_BINDING = 0;
+static const uint32_t BINDLESS_RW_TEXTURE_BINDING = 1;
+
+/**
+ * Persistently mapped host buffer used as a ring for staging transfers.
+ * Sub-allocations are handed out linearly and the whole buffer is recycled once the context's fence signals.
+ */
+struct StagingBuffer {
+    VkBuffer vk_buffer{VK_NULL_HANDLE};
+    VkDeviceMemory vk_device_memory{VK_NULL_HANDLE};
+    uint8_t *mapped{nullptr};
+    size_t size{0};
+    size_t head{0};
+};
+
+inline size_t hash_binding_set(PipelineHandle pipeline, const BindingSet &binding_set)
+{
+    size_t hash = std::hash<PipelineHandle>{}(pipeline);
+    for (const BindingItem &item : binding_set) {
+        hash ^= std::hash<uint32_t>{}(item.binding) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        hash ^= std::hash<ResourceHandle>{}(item.resource) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        hash ^= std::hash<uint64_t>{}((uint64_t(item.subresource.base_mip_level) << 48) ^
+                                      (uint64_t(item.subresource.mip_level_count) << 32) ^
+                                      (uint64_t(item.subresource.base_array_layer) << 16) ^
+                                      item.subresource.array_layer_count) +
+                0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+/**
+ * Descriptor sets of a context by (pipeline, binding set), open addressing with linear probing.
+ * The entries and slots keep their capacity when the cache is cleared, so once a context has recorded a typical
+ * submission, lookups and insertions no longer allocate.
+ */
+struct DescriptorSetCache {
+    static constexpr uint32_t EMPTY = ~0u;
+
+    struct Entry {
+        size_t hash;
+        PipelineHandle pipeline;
+        BindingSet binding_set;
+        VkDescriptorSet vk_descriptor_set;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> slots;  ///< Indices into entries, the size is a power of two.
+
+    VkDescriptorSet find(size_t hash, PipelineHandle pipeline, const BindingSet &binding_set) const
+    {
+        if (slots.empty())
+            return VK_NULL_HANDLE;
+        const size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; slots[i] != EMPTY; i = (i + 1) & mask) {
+            const Entry &entry = entries[slots[i]];
+            if (entry.hash == hash && entry.pipeline == pipeline && entry.binding_set == binding_set)
+                return entry.vk_descriptor_set;
+        }
+        return VK_NULL_HANDLE;
+    }
+
+    void insert(size_t hash, PipelineHandle pipeline, const BindingSet &binding_set, VkDescriptorSet vk_descriptor_set)
+    {
+        // rehash to keep the load factor below 1/2
+        if ((entries.size() + 1) * 2 > slots.size()) {
+            slots.assign(std::max<size_t>(slots.size() * 2, 64), EMPTY);
+            for (uint32_t i = 0; i < entries.size(); ++i)
+                place(entries[i].hash, i);
+        }
+        entries.push_back({hash, pipeline, binding_set, vk_descriptor_set});
+        place(hash, uint32_t(entries.size() - 1));
+    }
+
+    void clear()
+    {
+        entries.clear();
+        std::fill(slots.begin(), slots.end(), EMPTY);
+    }
+
+    void place(size_t hash, uint32_t entry)
+    {
+        const size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        while (slots[i] != EMPTY)
+            i = (i + 1) & mask;
+        slots[i] = entry;
+    }
+};
+
+struct TimestampScope {
+    std::string name;
+    uint32_t depth;
+    uint32_t begin_query;
+    uint32_t end_query;
+    bool closed{false};
+    // Scopes still open when a submission is retired keep their resolved begin timestamp.
+    std::optional<uint64_t> begin_ticks;
 };
 
 struct ContextImpl {
+    ContextHandle handle;
+    QueueType queue;
+    // Every context has its own command pool, so contexts can record on different threads.
+    VkCommandPool vk_command_pool;
     VkCommandBuffer vk_command_buffer;
-    VkFence vk_fence;
+
+    // Timeline semaphore signaled with submitted_value by every submission. Used to wait on the host and by
+    // other contexts to wait on the GPU.
+    VkSemaphore vk_semaphore;
+    uint64_t submitted_value{0};
+    uint64_t retired_value{0};  ///< Submission up to which per-submission resources were recycled.
+    // Semaphore values the next submission waits on.
+    std::vector<std::pair<VkSemaphore, uint64_t>> pending_waits;
 
     bool is_recording;
+    // Compute state bound by the last dispatch, redundant binds are skipped. Reset by begin().
+    VkPipeline bound_pipeline{VK_NULL_HANDLE};
+    VkDescriptorSet bound_descriptor_set{VK_NULL_HANDLE};
+
+    StagingBuffer staging_buffer;
 
     std::vector<ResourceHandle> transient_resources;
 
-    std::vector<DescriptorSet> descriptor_sets;
+    // Transitions are collected and recorded as a single barrier before the next command using the resources.
+    std::vector<VkBufferMemoryBarrier> pending_buffer_barriers;
+    std::vector<VkImageMemoryBarrier> pending_image_barriers;
+    VkPipelineStageFlags pending_src_stages{0};
+    VkPipelineStageFlags pending_dst_stages{0};
+    // Host-visible resources were written, the submission makes the writes available to the host.
+    bool host_visible_writes{false};
+
+    // Descriptor sets are allocated from per-context pools that are reset in bulk once the fence signals.
+    // Identical (pipeline, binding set) pairs reuse the same descriptor set until then.
+    std::vector<VkDescriptorPool> descriptor_pools;
+    size_t descriptor_pool_index{0};
+    DescriptorSetCache descriptor_set_cache;
+
+    // Temporary arrays of recorded commands (e.g. descriptor writes), recycled with the staging buffer.
+    Arena scratch;
+
+    // Timestamp queries (null if disabled), two per scope, reset at the start of every submission.
+    VkQueryPool vk_query_pool{VK_NULL_HANDLE};
+    uint32_t query_capacity{0};
+    uint32_t query_count{0};
+    std::vector<TimestampScope> timestamp_scopes;
+    std::vector<size_t> open_scopes;  ///< Indices into timestamp_scopes.
+    double submit_time_us{0.0};       ///< Profiler time of the first submission with scopes since the last retire.
+    std::vector<GpuTiming> timings;
+};
+
+struct Queue {
+    uint32_t family;
+    VkQueueFlags flags;
+    VkQueue vk_queue;
+    std::mutex *mutex;  ///< Guards submissions, shared by the queue types using the same queue.
+    /// Pipeline stages usable in barriers on this queue.
+    VkPipelineStageFlags supported_stages;
+    uint32_t timestamp_valid_bits;  ///< 0 if the queue does not support timestamps.
+    uint32_t profiler_track;        ///< Profiler track of GPU timings, registered on first use.
+    bool dedicated;
 };
 
 struct DeviceImpl {
     DeviceImpl(const DeviceDesc &desc);
     ~DeviceImpl();
 
+    std::vector<uint8_t> load_pipeline_cache_data() const;
+    bool save_pipeline_cache_data() const;
+
     uint32_t find_memory_type(uint32_t type_filter, MemoryType memory_type) const
     {
         uint32_t properties = MEMORY_TYPE_MAP[static_cast<uint32_t>(memory_type)];
@@ -288,6 +635,9 @@ struct DeviceImpl {
                 return i;
             }
         }
+        // not all devices have cached host memory
+        if (memory_type == MemoryType::Readback)
+            return find_memory_type(type_filter, MemoryType::Host);
         throw std::runtime_error("Failed to find suitable memory type!");
     }
 
@@ -295,13 +645,41 @@ struct DeviceImpl {
     VkInstance vk_instance{VK_NULL_HANDLE};
     VkDebugUtilsMessengerEXT vk_debug_messenger{VK_NULL_HANDLE};
     VkPhysicalDevice vk_physical_device{VK_NULL_HANDLE};
+    VkPhysicalDeviceProperties vk_properties;
     VkPhysicalDeviceMemoryProperties vk_memory_properties;
     VkDevice vk_device{VK_NULL_HANDLE};
-    uint32_t graphics_queue_family;
-    VkQueue vk_queue;
-
-    VkDescriptorPool vk_descriptor_pool;
-    VkCommandPool vk_command_pool;
+    // Indexed by QueueType, types without a dedicated queue family share the queue of another type.
+    Queue queues[3];
+    std::mutex queue_mutexes[3];
+    // Distinct queue families in use, resources are shared concurrently between them.
+    std::vector<uint32_t> queue_families;
+
+    VkPipelineCache vk_pipeline_cache{VK_NULL_HANDLE};
+    // Workers for create_pipelines(), created on first use.
+    std::unique_ptr<BS::thread_pool> compile_pool;
+    std::once_flag compile_pool_once;
+
+    // Bindless image arrays, indexed by binding. Created if desc.bindless_image_count > 0.
+    VkDescriptorSetLayout vk_bindless_set_layout{VK_NULL_HANDLE};
+    VkDescriptorPool vk_bindless_descriptor_pool{VK_NULL_HANDLE};
+    VkDescriptorSet vk_bindless_set{VK_NULL_HANDLE};
+    std::mutex bindless_mutex;
+    BindlessArray bindless_arrays[2];
+
+    // Guards ImageImpl::views, which dispatches and add_bindless_image() extend from different threads.
+    std::mutex view_mutex;
+
+    // Resources destroyed while pending submissions still reference them. The mutex also keeps contexts alive
+    // while their semaphores are queried.
+    std::mutex deferred_mutex;
+    std::vector<DeferredDestruction> deferred_destructions;
+
+    // Guards memory_pools and the dedicated allocation counters.
+    mutable std::mutex memory_mutex;
+    std::vector<std::unique_ptr<MemoryPool>> memory_pools;
+    bool has_empty_blocks{false};  ///< A non-transient pool might have more than one empty block.
+    uint32_t dedicated_allocation_count{0};
+    size_t dedicated_allocation_bytes{0};
 
     Pool<ShaderImpl, ShaderHandle> shaders;
     Pool<BufferImpl, BufferHandle> buffers;
@@ -408,86 +786,179 @@ DeviceImpl::DeviceImpl(const DeviceDesc &desc_) : desc(desc_)
             throw std::runtime_error("No suitable Vulkan device available!");
     }
 
+    vkGetPhysicalDeviceProperties(vk_physical_device, &vk_properties);
+
     // check memory types
     vkGetPhysicalDeviceMemoryProperties(vk_physical_device, &vk_memory_properties);
 
     // check queues
-    graphics_queue_family = static_cast<uint32_t>(-1);
+    // Prefer dedicated families for async compute (no graphics) and transfers (neither graphics nor compute).
+    uint32_t queue_family_indices[3] = {~0u, ~0u, ~0u};
+    std::vector<VkQueueFamilyProperties> queue_families_properties;
     {
         uint32_t queue_family_count = 0;
         vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &queue_family_count, nullptr);
-        std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
-        vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &queue_family_count, queue_families.data());
+        queue_families_properties.resize(queue_family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &queue_family_count,
+                                                 queue_families_properties.data());
 
+        uint32_t &graphics = queue_family_indices[static_cast<size_t>(QueueType::Graphics)];
+        uint32_t &compute = queue_family_indices[static_cast<size_t>(QueueType::Compute)];
+        uint32_t &transfer = queue_family_indices[static_cast<size_t>(QueueType::Transfer)];
         for (uint32_t i = 0; i < queue_family_count; ++i) {
-            if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
-                graphics_queue_family = i;
+            VkQueueFlags flags = queue_families_properties[i].queueFlags;
+            if ((flags & VK_QUEUE_GRAPHICS_BIT) && graphics == ~0u)
+                graphics = i;
+            else if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && compute == ~0u)
+                compute = i;
+            else if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+                     transfer == ~0u)
+                transfer = i;
         }
 
-        if (graphics_queue_family == static_cast<uint32_t>(-1))
+        if (graphics == ~0u)
             throw std::runtime_error("No graphics queue!");
+        if (compute == ~0u)
+            compute = graphics;
+        if (transfer == ~0u)
+            transfer = compute;
+
+        for (uint32_t family : queue_family_indices) {
+            if (std::find(queue_families.begin(), queue_families.end(), family) == queue_families.end())
+                queue_families.push_back(family);
+        }
     }
 
     // create device
     {
-        VkDeviceQueueCreateInfo queue_info{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
-        queue_info.queueFamilyIndex = graphics_queue_family;
-        queue_info.queueCount = 1;
         float queue_priority = 1.0f;
-        queue_info.pQueuePriorities = &queue_priority;
+        std::vector<VkDeviceQueueCreateInfo> queue_infos;
+        for (uint32_t family : queue_families) {
+            VkDeviceQueueCreateInfo queue_info{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+            queue_info.queueFamilyIndex = family;
+            queue_info.queueCount = 1;
+            queue_info.pQueuePriorities = &queue_priority;
+            queue_infos.push_back(queue_info);
+        }
 
         VkPhysicalDeviceFeatures device_features{};
 
+        VkPhysicalDeviceVulkan12Features vulkan12_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        vulkan12_features.timelineSemaphore = VK_TRUE;
+
+        if (desc.bindless_image_count > 0) {
+            VkPhysicalDeviceVulkan12Features supported{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+            VkPhysicalDeviceFeatures2 features2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+            features2.pNext = &supported;
+            vkGetPhysicalDeviceFeatures2(vk_physical_device, &features2);
+            if (!supported.runtimeDescriptorArray || !supported.descriptorBindingPartiallyBound ||
+                !supported.descriptorBindingSampledImageUpdateAfterBind ||
+                !supported.descriptorBindingStorageImageUpdateAfterBind ||
+                !supported.descriptorBindingUpdateUnusedWhilePending ||
+                !supported.shaderSampledImageArrayNonUniformIndexing ||
+                !supported.shaderStorageImageArrayNonUniformIndexing)
+                throw std::runtime_error("Descriptor indexing is not supported, bindless mode is unavailable!");
+
+            vulkan12_features.runtimeDescriptorArray = VK_TRUE;
+            vulkan12_features.descriptorBindingPartiallyBound = VK_TRUE;
+            vulkan12_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            vulkan12_features.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+            vulkan12_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            vulkan12_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            vulkan12_features.shaderStorageImageArrayNonUniformIndexing = VK_TRUE;
+        }
+
         VkDeviceCreateInfo device_info{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
-        device_info.pQueueCreateInfos = &queue_info;
-        device_info.queueCreateInfoCount = 1;
+        device_info.pQueueCreateInfos = queue_infos.data();
+        device_info.queueCreateInfoCount = static_cast<uint32_t>(queue_infos.size());
         device_info.pEnabledFeatures = &device_features;
+        device_info.pNext = &vulkan12_features;
         if (desc.enable_validation_layers) {
             device_info.enabledLayerCount = static_cast<uint32_t>(validation_layers.size());
             device_info.ppEnabledLayerNames = validation_layers.data();
         }
 
         VK_CHECK(vkCreateDevice(vk_physical_device, &device_info, nullptr, &vk_device));
-        vkGetDeviceQueue(vk_device, graphics_queue_family, 0, &vk_queue);
     }
 
-    // create descriptor pool
+    // create queues, shared by queue types using the same family
+    for (size_t i = 0; i < 3; ++i) {
+        Queue &queue = queues[i];
+        queue.family = queue_family_indices[i];
+        queue.dedicated = i == 0 || queue.family != queue_family_indices[i - 1];
+        if (!queue.dedicated) {
+            queue = queues[i - 1];
+            queue.dedicated = false;
+            continue;
+        }
+
+        vkGetDeviceQueue(vk_device, queue.family, 0, &queue.vk_queue);
+        queue.mutex = &queue_mutexes[i];
+
+        VkQueueFlags flags = queue_families_properties[queue.family].queueFlags;
+        queue.flags = flags;
+        queue.supported_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+                                 VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        if (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+            queue.supported_stages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        queue.timestamp_valid_bits = queue_families_properties[queue.family].timestampValidBits;
+        queue.profiler_track = ~0u;
+    }
+
+    // create pipeline cache
     {
-        uint32_t set_count = 100;
-        uint32_t descriptor_count = 1000;
-
-        const VkDescriptorPoolSize sizes[] = {
-            {VK_DESCRIPTOR_TYPE_SAMPLER, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, descriptor_count},
-            {VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, descriptor_count},
-        };
+        std::vector<uint8_t> cache_data = load_pipeline_cache_data();
 
-        VkDescriptorPoolCreateInfo create_info{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-        create_info.flags =
-            VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT | VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
-        create_info.maxSets = set_count;
-        create_info.poolSizeCount = static_cast<uint32_t>(std::size(sizes));
-        create_info.pPoolSizes = sizes;
+        VkPipelineCacheCreateInfo create_info{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+        create_info.initialDataSize = cache_data.size();
+        create_info.pInitialData = cache_data.data();
 
-        VK_CHECK(vkCreateDescriptorPool(vk_device, &create_info, nullptr, &vk_descriptor_pool));
+        VK_CHECK(vkCreatePipelineCache(vk_device, &create_info, nullptr, &vk_pipeline_cache));
     }
 
-    // create command pool
-    {
-        VkCommandPoolCreateInfo create_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
-        create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        create_info.queueFamilyIndex = graphics_queue_family;
+    // create bindless descriptor set, a single set that is updated in place while bound
+    if (desc.bindless_image_count > 0) {
+        VkDescriptorSetLayoutBinding bindings[2] = {};
+        bindings[BINDLESS_TEXTURE_BINDING].binding = BINDLESS_TEXTURE_BINDING;
+        bindings[BINDLESS_TEXTURE_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        bindings[BINDLESS_RW_TEXTURE_BINDING].binding = BINDLESS_RW_TEXTURE_BINDING;
+        bindings[BINDLESS_RW_TEXTURE_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        VkDescriptorBindingFlags binding_flags[2];
+        for (uint32_t i = 0; i < 2; ++i) {
+            bindings[i].descriptorCount = desc.bindless_image_count;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            binding_flags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        }
 
-        VK_CHECK(vkCreateCommandPool(vk_device, &create_info, nullptr, &vk_command_pool));
+        VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+        binding_flags_info.bindingCount = 2;
+        binding_flags_info.pBindingFlags = binding_flags;
+
+        VkDescriptorSetLayoutCreateInfo layout_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        layout_info.pNext = &binding_flags_info;
+        layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layout_info.bindingCount = 2;
+        layout_info.pBindings = bindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(vk_device, &layout_info, nullptr, &vk_bindless_set_layout));
+
+        VkDescriptorPoolSize sizes[] = {
+            {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, desc.bindless_image_count},
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, desc.bindless_image_count},
+        };
+        VkDescriptorPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        pool_info.maxSets = 1;
+        pool_info.poolSizeCount = static_cast<uint32_t>(std::size(sizes));
+        pool_info.pPoolSizes = sizes;
+        VK_CHECK(vkCreateDescriptorPool(vk_device, &pool_info, nullptr, &vk_bindless_descriptor_pool));
+
+        VkDescriptorSetAllocateInfo allocate_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        allocate_info.descriptorPool = vk_bindless_descriptor_pool;
+        allocate_info.descriptorSetCount = 1;
+        allocate_info.pSetLayouts = &vk_bindless_set_layout;
+        VK_CHECK(vkAllocateDescriptorSets(vk_device, &allocate_info, &vk_bindless_set));
     }
 }
 
@@ -495,8 +966,20 @@ DeviceImpl::~DeviceImpl()
 {
     vkDeviceWaitIdle(vk_device);
 
-    vkDestroyCommandPool(vk_device, vk_command_pool, nullptr);
-    vkDestroyDescriptorPool(vk_device, vk_descriptor_pool, nullptr);
+    compile_pool.reset();
+    save_pipeline_cache_data();
+    vkDestroyPipelineCache(vk_device, vk_pipeline_cache, nullptr);
+
+    if (vk_bindless_set_layout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(vk_device, vk_bindless_descriptor_pool, nullptr);
+        vkDestroyDescriptorSetLayout(vk_device, vk_bindless_set_layout, nullptr);
+    }
+
+    for (auto &pool : memory_pools) {
+        for (auto &block : pool->blocks)
+            vkFreeMemory(vk_device, block->vk_device_memory, nullptr);
+    }
+    memory_pools.clear();
 
     vkDestroyDevice(vk_device, nullptr);
 
@@ -507,269 +990,977 @@ DeviceImpl::~DeviceImpl()
     vkDestroyInstance(vk_instance, nullptr);
 }
 
-inline void transition_state(DeviceImpl &device, ContextImpl &context, BufferImpl &buffer, ResourceState new_state)
+/**
+ * Read the pipeline cache file.
+ * The data is discarded if the header does not match the current device and driver, drivers are not required
+ * to validate it themselves.
+ */
+std::vector<uint8_t> DeviceImpl::load_pipeline_cache_data() const
 {
-    ResourceState old_state = buffer.state;
-    buffer.state = new_state;
-
-    const ResourceStateInfo &old_info = RESOURCE_STATE_MAP[static_cast<size_t>(old_state)];
-    const ResourceStateInfo &new_info = RESOURCE_STATE_MAP[static_cast<size_t>(new_state)];
-
-    VkBufferMemoryBarrier buffer_memory_barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
-    buffer_memory_barrier.srcAccessMask = old_info.access;
-    buffer_memory_barrier.dstAccessMask = new_info.access;
-    buffer_memory_barrier.srcQueueFamilyIndex = device.graphics_queue_family;
-    buffer_memory_barrier.dstQueueFamilyIndex = device.graphics_queue_family;
-    buffer_memory_barrier.buffer = buffer.vk_buffer;
-    buffer_memory_barrier.offset = 0;
-    buffer_memory_barrier.size = VK_WHOLE_SIZE;
+    if (desc.pipeline_cache_path.empty())
+        return {};
+
+    std::ifstream file(desc.pipeline_cache_path, std::ios::binary);
+    if (!file)
+        return {};
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) {
+        spdlog::warn("Discarding invalid pipeline cache '{}'", desc.pipeline_cache_path.string());
+        return {};
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.headerSize < sizeof(header) || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        header.vendorID != vk_properties.vendorID || header.deviceID != vk_properties.deviceID ||
+        std::memcmp(header.pipelineCacheUUID, vk_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        spdlog::info("Discarding pipeline cache '{}' created by a different device or driver",
+                     desc.pipeline_cache_path.string());
+        return {};
+    }
 
-    vkCmdPipelineBarrier(context.vk_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VkDependencyFlags(0), 0, nullptr, 1,
-                         &buffer_memory_barrier, 0, nullptr);
+    return data;
 }
 
-inline void transition_state(DeviceImpl &device, ContextImpl &context, ImageImpl &image, ResourceState new_state)
+/**
+ * Write the pipeline cache file (via a temporary file, so a crash never leaves a truncated cache behind).
+ * Errors are logged rather than thrown, as this is also called from the destructor.
+ */
+bool DeviceImpl::save_pipeline_cache_data() const
 {
-    ResourceState old_state = image.state;
-    image.state = new_state;
-
-    const ResourceStateInfo &old_info = RESOURCE_STATE_MAP[static_cast<size_t>(old_state)];
-    const ResourceStateInfo &new_info = RESOURCE_STATE_MAP[static_cast<size_t>(new_state)];
+    if (desc.pipeline_cache_path.empty())
+        return false;
+
+    // the cache can grow between the size and the data query (pipelines compiled concurrently), retry then
+    std::vector<uint8_t> data;
+    size_t size = 0;
+    VkResult result;
+    do {
+        result = vkGetPipelineCacheData(vk_device, vk_pipeline_cache, &size, nullptr);
+        if (result != VK_SUCCESS)
+            break;
+        data.resize(size);
+        result = vkGetPipelineCacheData(vk_device, vk_pipeline_cache, &size, data.data());
+    } while (result == VK_INCOMPLETE);
+    if (result != VK_SUCCESS) {
+        spdlog::warn("Failed to get pipeline cache data: {}", result);
+        return false;
+    }
 
-    VkImageMemoryBarrier image_memory_barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
-    image_memory_barrier.srcAccessMask = old_info.access;
-    image_memory_barrier.dstAccessMask = new_info.access;
-    image_memory_barrier.oldLayout = old_info.layout;
-    image_memory_barrier.newLayout = new_info.layout;
-    image_memory_barrier.srcQueueFamilyIndex = device.graphics_queue_family;
-    image_memory_barrier.dstQueueFamilyIndex = device.graphics_queue_family;
-    image_memory_barrier.image = image.vk_image;
-    image_memory_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    image_memory_barrier.subresourceRange.baseMipLevel = 0;
-    image_memory_barrier.subresourceRange.levelCount = 1;
-    image_memory_barrier.subresourceRange.baseArrayLayer = 0;
-    image_memory_barrier.subresourceRange.layerCount = 1;
+    std::filesystem::path tmp_path = desc.pipeline_cache_path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char *>(data.data()), std::streamsize(size))) {
+            spdlog::warn("Failed to write pipeline cache '{}'", tmp_path.string());
+            return false;
+        }
+    }
 
-    vkCmdPipelineBarrier(context.vk_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VkDependencyFlags(0), 0, nullptr, 0, nullptr, 1,
-                         &image_memory_barrier);
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, desc.pipeline_cache_path, ec);
+    if (ec) {
+        spdlog::warn("Failed to write pipeline cache '{}': {}", desc.pipeline_cache_path.string(), ec.message());
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+    return true;
 }
 
-inline VkDescriptorSet create_descriptor_set(DeviceImpl &device, ContextImpl &context, PipelineImpl &pipeline,
-                                             const BindingSet &binding_set)
+inline VkDeviceMemory allocate_device_memory(DeviceImpl &device, VkDeviceSize size, uint32_t memory_type_index,
+                                             bool map, uint8_t **mapped)
 {
-    DescriptorSet descriptor_set;
-
-    FR_ASSERT(binding_set.size() == pipeline.desc.binding_layout.size());
-
-    VkDescriptorSetAllocateInfo allocate_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    allocate_info.descriptorPool = device.vk_descriptor_pool;
-    allocate_info.descriptorSetCount = 1;
-    allocate_info.pSetLayouts = &pipeline.vk_descriptor_set_layout;
-
-    VK_CHECK(vkAllocateDescriptorSets(device.vk_device, &allocate_info, &descriptor_set.vk_descriptor_set));
-
-    for (size_t i = 0; i < binding_set.size(); ++i) {
-        const auto &set_item = binding_set[i];
-        const auto &layout_item = pipeline.desc.binding_layout[i];
+    VkMemoryAllocateInfo allocate_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocate_info.allocationSize = size;
+    allocate_info.memoryTypeIndex = memory_type_index;
+    VkDeviceMemory vk_device_memory;
+    VK_CHECK(vkAllocateMemory(device.vk_device, &allocate_info, nullptr, &vk_device_memory));
 
-        FR_ASSERT(set_item.binding == layout_item.binding);
+    *mapped = nullptr;
+    if (map) {
+        void *data;
+        VK_CHECK(vkMapMemory(device.vk_device, vk_device_memory, 0, VK_WHOLE_SIZE, 0, &data));
+        *mapped = static_cast<uint8_t *>(data);
+    }
+    return vk_device_memory;
+}
 
-        VkDescriptorBufferInfo buffer_info{};
-        VkDescriptorImageInfo image_info{};
+/**
+ * Allocate memory for a resource.
+ * Small resources are sub-allocated from the blocks of a pool, resources larger than half a block get a
+ * dedicated allocation. Host memory is persistently mapped.
+ */
+inline MemoryAllocation allocate_memory(DeviceImpl &device, const VkMemoryRequirements &requirements,
+                                        MemoryType memory, bool linear, bool transient)
+{
+    const uint32_t memory_type_index = device.find_memory_type(requirements.memoryTypeBits, memory);
+    const bool map = memory != MemoryType::Device;
+
+    std::lock_guard<std::mutex> lock(device.memory_mutex);
+
+    MemoryAllocation allocation;
+    allocation.size = requirements.size;
+    allocation.coherent = !map || (device.vk_memory_properties.memoryTypes[memory_type_index].propertyFlags &
+                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if (requirements.size > device.desc.memory_block_size / 2) {
+        allocation.vk_device_memory =
+            allocate_device_memory(device, requirements.size, memory_type_index, map, &allocation.mapped);
+        device.dedicated_allocation_count++;
+        device.dedicated_allocation_bytes += requirements.size;
+        return allocation;
+    }
 
-        VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-        write.dstSet = descriptor_set.vk_descriptor_set;
-        write.dstBinding = set_item.binding;
-        write.dstArrayElement = 0;
-        write.descriptorCount = 1;
+    MemoryPool *pool = nullptr;
+    for (auto &p : device.memory_pools) {
+        if (p->memory_type_index == memory_type_index && p->linear == linear && p->transient == transient) {
+            pool = p.get();
+            break;
+        }
+    }
+    if (!pool) {
+        device.memory_pools.push_back(std::make_unique<MemoryPool>());
+        pool = device.memory_pools.back().get();
+        pool->memory_type_index = memory_type_index;
+        pool->linear = linear;
+        pool->transient = transient;
+    }
 
-        if (auto buffer = std::get_if<BufferHandle>(&set_item.resource)) {
-            BufferImpl *buffer_impl = device.buffers[*buffer];
-            FR_ASSERT(buffer_impl);
+    auto try_allocate = [&](MemoryBlock &block) {
+        size_t offset = block.allocator.allocate(requirements.size, requirements.alignment);
+        if (offset == BuddyAllocator::INVALID_OFFSET)
+            return false;
+        allocation.vk_device_memory = block.vk_device_memory;
+        allocation.offset = offset;
+        allocation.mapped = block.mapped ? block.mapped + offset : nullptr;
+        allocation.pool = pool;
+        allocation.block = &block;
+        return true;
+    };
+
+    for (auto &block : pool->blocks) {
+        if (try_allocate(*block))
+            return allocation;
+    }
 
-            write.descriptorType = DESCRIPTOR_TYPE_MAP[static_cast<size_t>(layout_item.type)].type;
+    uint8_t *mapped;
+    VkDeviceMemory vk_device_memory =
+        allocate_device_memory(device, device.desc.memory_block_size, memory_type_index, map, &mapped);
+    pool->blocks.push_back(std::unique_ptr<MemoryBlock>(
+        new MemoryBlock{vk_device_memory, mapped, BuddyAllocator(device.desc.memory_block_size, 256)}));
+    bool allocated = try_allocate(*pool->blocks.back());
+    FR_ASSERT(allocated);
+    return allocation;
+}
 
-            switch (layout_item.type) {
-                case DescriptorType::ConstantBuffer:
-                case DescriptorType::StructuredBuffer:
-                case DescriptorType::RWStructuredBuffer:
-                    buffer_info.buffer = buffer_impl->vk_buffer;
-                    buffer_info.offset = 0;
-                    buffer_info.range = VK_WHOLE_SIZE;
-                    write.pBufferInfo = &buffer_info;
-                    break;
-                case DescriptorType::Buffer:
-                case DescriptorType::RWBuffer: {
-                    FR_ASSERT(false);
-                    // auto view = new BufferView(buffer, format, offset, range);
-                    // _buffer_views.push_back(view);
-                    // buffer_view = view->vk_buffer_view();
-                    // write.pTexelBufferView = &buffer_view;
-                    break;
-                }
-                default:
-                    FR_ASSERT(false);
-            }
-        } else if (auto image = std::get_if<ImageHandle>(&set_item.resource)) {
-            ImageImpl *image_impl = device.images[*image];
-            FR_ASSERT(image_impl);
+inline void free_memory(DeviceImpl &device, MemoryAllocation &allocation)
+{
+    if (!allocation.vk_device_memory)
+        return;
 
-            write.descriptorType = DESCRIPTOR_TYPE_MAP[static_cast<size_t>(layout_item.type)].type;
+    std::lock_guard<std::mutex> lock(device.memory_mutex);
+
+    if (!allocation.block) {
+        vkFreeMemory(device.vk_device, allocation.vk_device_memory, nullptr);
+        device.dedicated_allocation_count--;
+        device.dedicated_allocation_bytes -= allocation.size;
+    } else {
+        MemoryBlock *block = allocation.block;
+        MemoryPool *pool = allocation.pool;
+        block->allocator.free(allocation.offset);
+        // empty blocks are released lazily by release_empty_blocks()
+        if (block->allocator.empty() && !pool->transient)
+            device.has_empty_blocks = true;
+    }
 
-            switch (layout_item.type) {
-                case DescriptorType::Texture:
-                case DescriptorType::RWTexture: {
-                    VkImageViewCreateInfo create_info{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
-                    create_info.image = image_impl->vk_image;
-                    create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-                    create_info.format = IMAGE_FORMAT_MAP[static_cast<size_t>(image_impl->desc.format)];
-                    create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-                    create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-                    create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-                    create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-                    create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                    create_info.subresourceRange.baseMipLevel = 0;
-                    create_info.subresourceRange.levelCount = 1;
-                    create_info.subresourceRange.baseArrayLayer = 0;
-                    create_info.subresourceRange.layerCount = 1;
-                    VkImageView vk_image_view;
-                    VK_CHECK(vkCreateImageView(device.vk_device, &create_info, nullptr, &vk_image_view));
-                    descriptor_set.vk_image_views.push_back(vk_image_view);
+    allocation = {};
+}
 
-                    image_info.imageLayout = DESCRIPTOR_TYPE_MAP[static_cast<size_t>(layout_item.type)].layout;
-                    image_info.imageView = vk_image_view;
-                    image_info.sampler = VK_NULL_HANDLE;
-                    write.pImageInfo = &image_info;
-                    break;
-                }
-                default:
-                    FR_ASSERT(false);
-            }
-        } else if (auto sampler = std::get_if<SamplerHandle>(&set_item.resource)) {
-            SamplerImpl *sampler_impl = device.samplers[*sampler];
-            FR_ASSERT(sampler);
-            image_info.sampler = sampler_impl->vk_sampler;
-            write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
-            write.pImageInfo = &image_info;
-        }
+/// Free the empty blocks of non-transient pools except one per pool, which is kept for create/destroy cycles.
+inline void release_empty_blocks(DeviceImpl &device)
+{
+    std::lock_guard<std::mutex> lock(device.memory_mutex);
+    if (!device.has_empty_blocks)
+        return;
 
-        vkUpdateDescriptorSets(device.vk_device, 1, &write, 0, nullptr);
+    for (auto &pool : device.memory_pools) {
+        if (pool->transient)
+            continue;
+        bool keep = true;
+        std::erase_if(pool->blocks, [&](const std::unique_ptr<MemoryBlock> &block) {
+            if (!block->allocator.empty())
+                return false;
+            if (std::exchange(keep, false))
+                return false;
+            vkFreeMemory(device.vk_device, block->vk_device_memory, nullptr);
+            return true;
+        });
     }
-
-    context.descriptor_sets.push_back(descriptor_set);
-
-    return descriptor_set.vk_descriptor_set;
+    device.has_empty_blocks = false;
 }
 
-inline void destroy_descriptor_set(DeviceImpl &device, DescriptorSet &descriptor_set)
+/// True if every submission in uses has completed, uses of destroyed contexts count as completed (destroy_context()
+/// waits for all of its submissions).
+inline bool is_complete(const DeviceImpl &device, const std::vector<ResourceUse> &uses)
 {
-    VK_CHECK(vkFreeDescriptorSets(device.vk_device, device.vk_descriptor_pool, 1, &descriptor_set.vk_descriptor_set));
+    for (const ResourceUse &use : uses) {
+        const ContextImpl *context = device.contexts[use.context];
+        if (!context)
+            continue;
+        uint64_t value;
+        VK_CHECK(vkGetSemaphoreCounterValue(device.vk_device, context->vk_semaphore, &value));
+        if (value < use.value)
+            return false;
+    }
+    return true;
+}
 
-    for (VkImageView vk_image_view : descriptor_set.vk_image_views)
-        vkDestroyImageView(device.vk_device, vk_image_view, nullptr);
-    for (VkBufferView vk_buffer_view : descriptor_set.vk_buffer_views)
+inline void release(DeviceImpl &device, DeferredDestruction &destruction)
+{
+    for (VkBufferView vk_buffer_view : destruction.vk_buffer_views)
         vkDestroyBufferView(device.vk_device, vk_buffer_view, nullptr);
+    for (VkImageView vk_image_view : destruction.vk_image_views)
+        vkDestroyImageView(device.vk_device, vk_image_view, nullptr);
+    vkDestroyBuffer(device.vk_device, destruction.vk_buffer, nullptr);
+    vkDestroyImage(device.vk_device, destruction.vk_image, nullptr);
+    vkDestroySampler(device.vk_device, destruction.vk_sampler, nullptr);
+    free_memory(device, destruction.allocation);
 }
 
-Device::Device(const DeviceDesc &desc) { m_impl = std::make_unique<DeviceImpl>(desc); }
-
-Device::~Device() {}
-
-ShaderHandle Device::create_shader(const ShaderDesc &desc)
+/// Release the objects of a destroyed resource now if it is idle, otherwise once its submissions completed.
+inline void destroy_deferred(DeviceImpl &device, DeferredDestruction destruction)
 {
-    ShaderHandle shader = m_impl->shaders.alloc();
-    ShaderImpl *shader_impl = m_impl->shaders[shader];
-
-    shader_impl->desc = desc;
-
-    VkShaderModuleCreateInfo create_info{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-    create_info.pCode = static_cast<const uint32_t *>(desc.code);
-    create_info.codeSize = desc.code_size;
+    std::lock_guard<std::mutex> lock(device.deferred_mutex);
+    if (is_complete(device, destruction.uses))
+        release(device, destruction);
+    else
+        device.deferred_destructions.push_back(std::move(destruction));
+}
 
-    VK_CHECK(vkCreateShaderModule(m_impl->vk_device, &create_info, nullptr, &shader_impl->vk_shader_module));
+/// Release the deferred destructions whose submissions completed.
+inline void collect_deferred_destructions(DeviceImpl &device)
+{
+    std::lock_guard<std::mutex> lock(device.deferred_mutex);
+    auto &destructions = device.deferred_destructions;
+    for (size_t i = 0; i < destructions.size();) {
+        if (is_complete(device, destructions[i].uses)) {
+            release(device, destructions[i]);
+            destructions[i] = std::move(destructions.back());
+            destructions.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
 
-    return shader;
+/// Mapped range of an allocation, aligned to nonCoherentAtomSize and clamped to the memory object.
+inline VkMappedMemoryRange get_mapped_range(const DeviceImpl &device, const MemoryAllocation &allocation,
+                                            size_t offset, size_t size)
+{
+    const VkDeviceSize atom_size = device.vk_properties.limits.nonCoherentAtomSize;
+    const VkDeviceSize memory_size = allocation.block ? device.desc.memory_block_size : allocation.size;
+    size = std::min(size, size_t(allocation.size) - std::min(offset, size_t(allocation.size)));
+
+    VkMappedMemoryRange range{VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+    range.memory = allocation.vk_device_memory;
+    range.offset = (allocation.offset + offset) / atom_size * atom_size;
+    VkDeviceSize end = (allocation.offset + offset + size + atom_size - 1) / atom_size * atom_size;
+    range.size = end >= memory_size ? VK_WHOLE_SIZE : end - range.offset;
+    return range;
 }
 
-void Device::destroy_shader(ShaderHandle shader)
+inline void flush_memory(const DeviceImpl &device, const MemoryAllocation &allocation, size_t offset, size_t size)
 {
-    ShaderImpl *shader_impl = m_impl->shaders[shader];
-    if (!shader_impl)
+    if (allocation.coherent || !allocation.mapped)
         return;
-
-    vkDestroyShaderModule(m_impl->vk_device, shader_impl->vk_shader_module, nullptr);
-    m_impl->shaders.free(shader);
+    VkMappedMemoryRange range = get_mapped_range(device, allocation, offset, size);
+    VK_CHECK(vkFlushMappedMemoryRanges(device.vk_device, 1, &range));
 }
 
-BufferHandle Device::create_buffer(const BufferDesc &desc)
+inline void invalidate_memory(const DeviceImpl &device, const MemoryAllocation &allocation, size_t offset,
+                              size_t size)
 {
-    BufferHandle buffer = m_impl->buffers.alloc();
-    BufferImpl *buffer_impl = m_impl->buffers[buffer];
+    if (allocation.coherent || !allocation.mapped)
+        return;
+    VkMappedMemoryRange range = get_mapped_range(device, allocation, offset, size);
+    VK_CHECK(vkInvalidateMappedMemoryRanges(device.vk_device, 1, &range));
+}
 
-    buffer_impl->desc = desc;
-    buffer_impl->state = ResourceState::Undefined;
+struct BarrierScope {
+    VkPipelineStageFlags src_stages;
+    VkAccessFlags src_access;
+    VkPipelineStageFlags dst_stages;
+    VkAccessFlags dst_access;
+};
+
+/// Stages and accesses of a transition, restricted to the stages supported by the context's queue.
+inline BarrierScope get_barrier_scope(const DeviceImpl &device, const ContextImpl &context, ResourceState old_state,
+                                      ResourceState new_state)
+{
+    const ResourceStateInfo &old_info = RESOURCE_STATE_MAP[static_cast<size_t>(old_state)];
+    const ResourceStateInfo &new_info = RESOURCE_STATE_MAP[static_cast<size_t>(new_state)];
+    const VkPipelineStageFlags supported_stages =
+        device.queues[static_cast<size_t>(context.queue)].supported_stages;
+
+    BarrierScope scope;
+    scope.src_stages = old_info.stages & supported_stages;
+    scope.src_access = old_info.access & WRITE_ACCESS_MASK;
+    if (!scope.src_stages) {
+        // The previous access happened on a queue with other capabilities, the semaphore wait of the submission
+        // already orders it and makes its writes visible.
+        scope.src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        scope.src_access = 0;
+    }
+    scope.dst_stages = new_info.stages & supported_stages;
+    scope.dst_access = new_info.access;
+    FR_ASSERT(scope.dst_stages);
+    return scope;
+}
+
+/// Record that the submission being recorded by the context references a resource.
+inline void mark_used(std::vector<ResourceUse> &uses, const ContextImpl &context)
+{
+    const uint64_t value = context.submitted_value + 1;
+    for (ResourceUse &use : uses) {
+        if (use.context == context.handle) {
+            use.value = value;
+            return;
+        }
+    }
+    uses.push_back({context.handle, value});
+}
+
+/// Queue a buffer state transition, recorded by the next flush_barriers().
+inline void transition_state(DeviceImpl &device, ContextImpl &context, BufferImpl &buffer, ResourceState new_state)
+{
+    mark_used(buffer.uses, context);
+    ResourceState old_state = buffer.state;
+    if (buffer.desc.memory != MemoryType::Device && !is_read_only_state(new_state))
+        context.host_visible_writes = true;
+    if (old_state == new_state && is_read_only_state(new_state))
+        return;
+    buffer.state = new_state;
+
+    const BarrierScope scope = get_barrier_scope(device, context, old_state, new_state);
+
+    VkBufferMemoryBarrier buffer_memory_barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    buffer_memory_barrier.srcAccessMask = scope.src_access;
+    buffer_memory_barrier.dstAccessMask = scope.dst_access;
+    buffer_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_memory_barrier.buffer = buffer.vk_buffer;
+    buffer_memory_barrier.offset = 0;
+    buffer_memory_barrier.size = VK_WHOLE_SIZE;
+
+    context.pending_buffer_barriers.push_back(buffer_memory_barrier);
+    context.pending_src_stages |= scope.src_stages;
+    context.pending_dst_stages |= scope.dst_stages;
+}
+
+/**
+ * Queue a state transition of a subresource range of an image, recorded by the next flush_barriers().
+ * Subresources are tracked individually, adjacent subresources with the same previous state share a barrier.
+ */
+inline void transition_state(DeviceImpl &device, ContextImpl &context, ImageImpl &image, ResourceState new_state,
+                             const ImageSubresourceRange &range = {})
+{
+    mark_used(image.uses, context);
+    const ImageSubresourceRange resolved = resolve_subresource(image.desc, range);
+    if (image.desc.memory != MemoryType::Device && !is_read_only_state(new_state))
+        context.host_visible_writes = true;
+
+    const size_t first_barrier = context.pending_image_barriers.size();
+    for (uint32_t level = resolved.base_mip_level; level < resolved.base_mip_level + resolved.mip_level_count;
+         ++level) {
+        const size_t level_first_barrier = context.pending_image_barriers.size();
+        for (uint32_t layer = resolved.base_array_layer;
+             layer < resolved.base_array_layer + resolved.array_layer_count; ++layer) {
+            ResourceState &state = image.states[level * image.desc.array_layers + layer];
+            ResourceState old_state = state;
+            if (old_state == new_state && is_read_only_state(new_state))
+                continue;
+            state = new_state;
+
+            const BarrierScope scope = get_barrier_scope(device, context, old_state, new_state);
+            context.pending_src_stages |= scope.src_stages;
+            context.pending_dst_stages |= scope.dst_stages;
+
+            const VkImageLayout old_layout = RESOURCE_STATE_MAP[static_cast<size_t>(old_state)].layout;
+            if (context.pending_image_barriers.size() > level_first_barrier) {
+                VkImageMemoryBarrier &last = context.pending_image_barriers.back();
+                if (last.oldLayout == old_layout && last.srcAccessMask == scope.src_access &&
+                    last.subresourceRange.baseArrayLayer + last.subresourceRange.layerCount == layer) {
+                    last.subresourceRange.layerCount++;
+                    continue;
+                }
+            }
+
+            VkImageMemoryBarrier image_memory_barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+            image_memory_barrier.srcAccessMask = scope.src_access;
+            image_memory_barrier.dstAccessMask = scope.dst_access;
+            image_memory_barrier.oldLayout = old_layout;
+            image_memory_barrier.newLayout = RESOURCE_STATE_MAP[static_cast<size_t>(new_state)].layout;
+            image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_memory_barrier.image = image.vk_image;
+            image_memory_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            image_memory_barrier.subresourceRange.baseMipLevel = level;
+            image_memory_barrier.subresourceRange.levelCount = 1;
+            image_memory_barrier.subresourceRange.baseArrayLayer = layer;
+            image_memory_barrier.subresourceRange.layerCount = 1;
+            context.pending_image_barriers.push_back(image_memory_barrier);
+        }
+
+        // merge with the previous level if both were transitioned by a single identical barrier
+        auto &barriers = context.pending_image_barriers;
+        if (barriers.size() == level_first_barrier + 1 && level_first_barrier > first_barrier) {
+            VkImageMemoryBarrier &prev = barriers[level_first_barrier - 1];
+            const VkImageMemoryBarrier &last = barriers.back();
+            if (prev.oldLayout == last.oldLayout && prev.srcAccessMask == last.srcAccessMask &&
+                prev.subresourceRange.baseArrayLayer == last.subresourceRange.baseArrayLayer &&
+                prev.subresourceRange.layerCount == last.subresourceRange.layerCount &&
+                prev.subresourceRange.baseMipLevel + prev.subresourceRange.levelCount == level) {
+                prev.subresourceRange.levelCount++;
+                barriers.pop_back();
+            }
+        }
+    }
+}
+
+/// Record all queued transitions as a single pipeline barrier.
+inline void flush_barriers(ContextImpl &context)
+{
+    if (context.pending_buffer_barriers.empty() && context.pending_image_barriers.empty())
+        return;
+
+    vkCmdPipelineBarrier(context.vk_command_buffer, context.pending_src_stages, context.pending_dst_stages,
+                         VkDependencyFlags(0), 0, nullptr,
+                         static_cast<uint32_t>(context.pending_buffer_barriers.size()),
+                         context.pending_buffer_barriers.data(),
+                         static_cast<uint32_t>(context.pending_image_barriers.size()),
+                         context.pending_image_barriers.data());
+
+    context.pending_buffer_barriers.clear();
+    context.pending_image_barriers.clear();
+    context.pending_src_stages = 0;
+    context.pending_dst_stages = 0;
+}
+
+/// Resources are used concurrently by all queue families, so no ownership transfers are needed between queues.
+template <typename T>
+void set_sharing_mode(const DeviceImpl &device, T &create_info)
+{
+    create_info.sharingMode = device.queue_families.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    create_info.queueFamilyIndexCount = static_cast<uint32_t>(device.queue_families.size());
+    create_info.pQueueFamilyIndices = device.queue_families.data();
+}
+
+inline void create_staging_buffer(DeviceImpl &device, StagingBuffer &staging_buffer, size_t size)
+{
+    VkBufferCreateInfo create_info{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    create_info.size = size;
+    create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    set_sharing_mode(device, create_info);
+    VK_CHECK(vkCreateBuffer(device.vk_device, &create_info, nullptr, &staging_buffer.vk_buffer));
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(device.vk_device, staging_buffer.vk_buffer, &memory_requirements);
+
+    VkMemoryAllocateInfo allocate_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocate_info.allocationSize = memory_requirements.size;
+    allocate_info.memoryTypeIndex = device.find_memory_type(memory_requirements.memoryTypeBits, MemoryType::Host);
+    VK_CHECK(vkAllocateMemory(device.vk_device, &allocate_info, nullptr, &staging_buffer.vk_device_memory));
+    VK_CHECK(vkBindBufferMemory(device.vk_device, staging_buffer.vk_buffer, staging_buffer.vk_device_memory, 0));
+
+    void *mapped;
+    VK_CHECK(vkMapMemory(device.vk_device, staging_buffer.vk_device_memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+    staging_buffer.mapped = static_cast<uint8_t *>(mapped);
+    staging_buffer.size = size;
+    staging_buffer.head = 0;
+}
+
+inline void destroy_staging_buffer(DeviceImpl &device, StagingBuffer &staging_buffer)
+{
+    if (!staging_buffer.vk_buffer)
+        return;
+
+    vkUnmapMemory(device.vk_device, staging_buffer.vk_device_memory);
+    vkDestroyBuffer(device.vk_device, staging_buffer.vk_buffer, nullptr);
+    vkFreeMemory(device.vk_device, staging_buffer.vk_device_memory, nullptr);
+    staging_buffer = {};
+}
+
+/// Number of bytes available in the staging buffer after aligning the head.
+inline size_t staging_available(DeviceImpl &device, StagingBuffer &staging_buffer, size_t alignment)
+{
+    if (!staging_buffer.vk_buffer)
+        create_staging_buffer(device, staging_buffer, device.desc.staging_buffer_size);
+
+    size_t offset = (staging_buffer.head + alignment - 1) / alignment * alignment;
+    return offset < staging_buffer.size ? staging_buffer.size - offset : 0;
+}
+
+/// Sub-allocate from the staging buffer, the caller must check staging_available() first.
+inline size_t staging_allocate(StagingBuffer &staging_buffer, size_t size, size_t alignment)
+{
+    size_t offset = (staging_buffer.head + alignment - 1) / alignment * alignment;
+    FR_ASSERT(offset + size <= staging_buffer.size);
+    staging_buffer.head = offset + size;
+    return offset;
+}
+
+/// Make transfer writes to the staging buffer visible to the host.
+inline void staging_readback_barrier(ContextImpl &context)
+{
+    VkMemoryBarrier memory_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(context.vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         VkDependencyFlags(0), 1, &memory_barrier, 0, nullptr, 0, nullptr);
+}
+
+inline VkBufferView get_buffer_view(DeviceImpl &device, BufferImpl &buffer, const BufferViewKey &key)
+{
+    for (const auto &[view_key, vk_buffer_view] : buffer.views) {
+        if (view_key == key)
+            return vk_buffer_view;
+    }
+
+    VkBufferViewCreateInfo create_info{VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO};
+    create_info.buffer = buffer.vk_buffer;
+    create_info.format = key.format;
+    create_info.offset = key.offset;
+    create_info.range = key.range;
+    VkBufferView vk_buffer_view;
+    VK_CHECK(vkCreateBufferView(device.vk_device, &create_info, nullptr, &vk_buffer_view));
+    buffer.views.emplace_back(key, vk_buffer_view);
+    return vk_buffer_view;
+}
+
+inline VkImageView get_image_view(DeviceImpl &device, ImageImpl &image, const ImageViewKey &key)
+{
+    std::lock_guard<std::mutex> lock(device.view_mutex);
+    for (const auto &[view_key, vk_image_view] : image.views) {
+        if (view_key == key)
+            return vk_image_view;
+    }
+
+    VkImageViewCreateInfo create_info{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    create_info.image = image.vk_image;
+    create_info.viewType = image.desc.array_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    create_info.format = key.format;
+    create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    create_info.subresourceRange.baseMipLevel = key.base_mip_level;
+    create_info.subresourceRange.levelCount = key.mip_level_count;
+    create_info.subresourceRange.baseArrayLayer = key.base_array_layer;
+    create_info.subresourceRange.layerCount = key.array_layer_count;
+    VkImageView vk_image_view;
+    VK_CHECK(vkCreateImageView(device.vk_device, &create_info, nullptr, &vk_image_view));
+    image.views.emplace_back(key, vk_image_view);
+    return vk_image_view;
+}
+
+/// Resolved subresource range of an image binding, storage images can only bind a single level.
+inline ImageSubresourceRange get_binding_subresource(const ImageImpl &image, const BindingItem &set_item,
+                                                     const BindingLayoutItem &layout_item)
+{
+    ImageSubresourceRange range = set_item.subresource;
+    if (layout_item.type == DescriptorType::RWTexture && range.mip_level_count == 0)
+        range.mip_level_count = 1;
+    FR_ASSERT(layout_item.type != DescriptorType::RWTexture || range.mip_level_count == 1);
+    return resolve_subresource(image.desc, range);
+}
+
+inline VkDescriptorPool create_descriptor_pool(DeviceImpl &device)
+{
+    const uint32_t set_count = 256;
+    const uint32_t descriptor_count = 1024;
+
+    const VkDescriptorPoolSize sizes[] = {
+        {VK_DESCRIPTOR_TYPE_SAMPLER, descriptor_count},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, descriptor_count},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, descriptor_count},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, descriptor_count},
+        {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, descriptor_count},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptor_count},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptor_count},
+    };
+
+    VkDescriptorPoolCreateInfo create_info{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    create_info.maxSets = set_count;
+    create_info.poolSizeCount = static_cast<uint32_t>(std::size(sizes));
+    create_info.pPoolSizes = sizes;
+
+    VkDescriptorPool vk_descriptor_pool;
+    VK_CHECK(vkCreateDescriptorPool(device.vk_device, &create_info, nullptr, &vk_descriptor_pool));
+    return vk_descriptor_pool;
+}
+
+inline VkDescriptorSet allocate_descriptor_set(DeviceImpl &device, ContextImpl &context,
+                                               VkDescriptorSetLayout vk_descriptor_set_layout)
+{
+    VkDescriptorSetAllocateInfo allocate_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &vk_descriptor_set_layout;
+
+    // move on to the next pool when the current one is exhausted
+    while (true) {
+        if (context.descriptor_pool_index == context.descriptor_pools.size())
+            context.descriptor_pools.push_back(create_descriptor_pool(device));
+
+        allocate_info.descriptorPool = context.descriptor_pools[context.descriptor_pool_index];
+        VkDescriptorSet vk_descriptor_set;
+        VkResult result = vkAllocateDescriptorSets(device.vk_device, &allocate_info, &vk_descriptor_set);
+        if (result == VK_SUCCESS)
+            return vk_descriptor_set;
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+            throw std::runtime_error(fmt::format("vkAllocateDescriptorSets failed with result {}", result));
+
+        context.descriptor_pool_index++;
+    }
+}
+
+inline VkDescriptorSet get_descriptor_set(DeviceImpl &device, ContextImpl &context, PipelineHandle pipeline,
+                                          const PipelineImpl &pipeline_impl, const BindingSet &binding_set)
+{
+    const size_t hash = hash_binding_set(pipeline, binding_set);
+    if (VkDescriptorSet vk_descriptor_set = context.descriptor_set_cache.find(hash, pipeline, binding_set))
+        return vk_descriptor_set;
+
+    FR_ASSERT(binding_set.size() == pipeline_impl.desc.binding_layout.size());
+
+    VkDescriptorSet vk_descriptor_set =
+        allocate_descriptor_set(device, context, pipeline_impl.vk_descriptor_set_layout);
+
+    // all bindings are written with a single vkUpdateDescriptorSets call
+    // (info arrays are sized upfront so the pointers stored in the writes remain valid)
+    Arena &scratch = context.scratch;
+    VkWriteDescriptorSet *writes = scratch.allocate<VkWriteDescriptorSet>(binding_set.size());
+    VkDescriptorBufferInfo *buffer_infos = scratch.allocate<VkDescriptorBufferInfo>(binding_set.size());
+    VkDescriptorImageInfo *image_infos = scratch.allocate<VkDescriptorImageInfo>(binding_set.size());
+    VkBufferView *buffer_views = scratch.allocate<VkBufferView>(binding_set.size());
+
+    for (size_t i = 0; i < binding_set.size(); ++i) {
+        const auto &set_item = binding_set[i];
+        const auto &layout_item = pipeline_impl.desc.binding_layout[i];
+
+        FR_ASSERT(set_item.binding == layout_item.binding);
+
+        VkDescriptorBufferInfo &buffer_info = buffer_infos[i];
+        VkDescriptorImageInfo &image_info = image_infos[i];
+
+        VkWriteDescriptorSet &write = writes[i];
+        write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        write.dstSet = vk_descriptor_set;
+        write.dstBinding = set_item.binding;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+
+        if (auto buffer = std::get_if<BufferHandle>(&set_item.resource)) {
+            BufferImpl *buffer_impl = device.buffers[*buffer];
+            FR_ASSERT(buffer_impl);
+
+            write.descriptorType = DESCRIPTOR_TYPE_MAP[static_cast<size_t>(layout_item.type)].type;
+
+            switch (layout_item.type) {
+                case DescriptorType::ConstantBuffer:
+                case DescriptorType::StructuredBuffer:
+                case DescriptorType::RWStructuredBuffer:
+                    buffer_info.buffer = buffer_impl->vk_buffer;
+                    buffer_info.offset = 0;
+                    buffer_info.range = VK_WHOLE_SIZE;
+                    write.pBufferInfo = &buffer_info;
+                    break;
+                case DescriptorType::Buffer:
+                case DescriptorType::RWBuffer: {
+                    FR_ASSERT(buffer_impl->desc.format != ImageFormat::Unknown);
+                    BufferViewKey view_key{
+                        .format = IMAGE_FORMAT_MAP[static_cast<size_t>(buffer_impl->desc.format)],
+                        .offset = 0,
+                        .range = VK_WHOLE_SIZE,
+                    };
+                    buffer_views[i] = get_buffer_view(device, *buffer_impl, view_key);
+                    write.pTexelBufferView = &buffer_views[i];
+                    break;
+                }
+                default:
+                    FR_ASSERT(false);
+            }
+        } else if (auto image = std::get_if<ImageHandle>(&set_item.resource)) {
+            ImageImpl *image_impl = device.images[*image];
+            FR_ASSERT(image_impl);
+
+            write.descriptorType = DESCRIPTOR_TYPE_MAP[static_cast<size_t>(layout_item.type)].type;
+
+            switch (layout_item.type) {
+                case DescriptorType::Texture:
+                case DescriptorType::RWTexture: {
+                    const ImageSubresourceRange range = get_binding_subresource(*image_impl, set_item, layout_item);
+                    ImageViewKey view_key{
+                        .format = IMAGE_FORMAT_MAP[static_cast<size_t>(image_impl->desc.format)],
+                        .base_mip_level = range.base_mip_level,
+                        .mip_level_count = range.mip_level_count,
+                        .base_array_layer = range.base_array_layer,
+                        .array_layer_count = range.array_layer_count,
+                    };
+                    VkImageView vk_image_view = get_image_view(device, *image_impl, view_key);
+
+                    image_info.imageLayout = DESCRIPTOR_TYPE_MAP[static_cast<size_t>(layout_item.type)].layout;
+                    image_info.imageView = vk_image_view;
+                    image_info.sampler = VK_NULL_HANDLE;
+                    write.pImageInfo = &image_info;
+                    break;
+                }
+                default:
+                    FR_ASSERT(false);
+            }
+        } else if (auto sampler = std::get_if<SamplerHandle>(&set_item.resource)) {
+            SamplerImpl *sampler_impl = device.samplers[*sampler];
+            FR_ASSERT(sampler);
+            image_info = {};
+            image_info.sampler = sampler_impl->vk_sampler;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+            write.pImageInfo = &image_info;
+        }
+    }
+
+    vkUpdateDescriptorSets(device.vk_device, static_cast<uint32_t>(binding_set.size()), writes, 0, nullptr);
+
+    context.descriptor_set_cache.insert(hash, pipeline, binding_set, vk_descriptor_set);
+
+    return vk_descriptor_set;
+}
+
+/// Release all descriptor sets of a context, the context's commands must have completed.
+inline void reset_descriptor_sets(DeviceImpl &device, ContextImpl &context)
+{
+    for (VkDescriptorPool vk_descriptor_pool : context.descriptor_pools)
+        VK_CHECK(vkResetDescriptorPool(device.vk_device, vk_descriptor_pool, 0));
+    context.descriptor_pool_index = 0;
+    context.descriptor_set_cache.clear();
+}
+
+static const uint32_t NO_QUERY = ~0u;
+
+/// Profiler track of a queue, shared by the queue types using the same queue.
+inline uint32_t get_profiler_track(DeviceImpl &device, QueueType queue_type)
+{
+    Queue &queue = device.queues[static_cast<size_t>(queue_type)];
+    std::lock_guard<std::mutex> lock(*queue.mutex);
+    if (queue.profiler_track == ~0u) {
+        static const char *QUEUE_NAMES[] = {"graphics", "compute", "transfer"};
+        std::string name = fmt::format("gpu {} queue", QUEUE_NAMES[static_cast<size_t>(queue_type)]);
+        uint32_t track = Profiler::global().register_track(std::move(name));
+        for (Queue &other : device.queues) {
+            if (other.vk_queue == queue.vk_queue)
+                other.profiler_track = track;
+        }
+    }
+    return queue.profiler_track;
+}
+
+/// Convert the timestamps of the closed scopes to timings, the context's commands must have completed.
+inline void resolve_timestamps(DeviceImpl &device, ContextImpl &context)
+{
+    if (context.vk_query_pool == VK_NULL_HANDLE || context.timestamp_scopes.empty())
+        return;
+
+    std::vector<uint64_t> ticks(context.query_count);
+    if (context.query_count > 0) {
+        VK_CHECK(vkGetQueryPoolResults(device.vk_device, context.vk_query_pool, 0, context.query_count,
+                                       ticks.size() * sizeof(uint64_t), ticks.data(), sizeof(uint64_t),
+                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+    }
+
+    const uint32_t valid_bits = device.queues[static_cast<size_t>(context.queue)].timestamp_valid_bits;
+    const uint64_t mask = valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+    const double ms_per_tick = double(device.vk_properties.limits.timestampPeriod) * 1e-6;
+
+    for (TimestampScope &scope : context.timestamp_scopes) {
+        if (!scope.begin_ticks && scope.begin_query != NO_QUERY)
+            scope.begin_ticks = ticks[scope.begin_query] & mask;
+        scope.begin_query = NO_QUERY;
+    }
+
+    std::optional<uint64_t> first_ticks;
+    for (const TimestampScope &scope : context.timestamp_scopes) {
+        if (scope.closed && scope.begin_ticks && scope.end_query != NO_QUERY)
+            first_ticks = std::min(first_ticks.value_or(*scope.begin_ticks), *scope.begin_ticks);
+    }
+
+    Profiler &profiler = Profiler::global();
+    const bool export_events = profiler.enabled() && first_ticks;
+    const uint32_t track = export_events ? get_profiler_track(device, context.queue) : 0;
+
+    // Closed scopes are resolved, open (and dropped) scopes are kept for the next submission.
+    std::vector<TimestampScope> open_scopes;
+    for (TimestampScope &scope : context.timestamp_scopes) {
+        if (!scope.closed) {
+            open_scopes.push_back(std::move(scope));
+            continue;
+        }
+        if (!scope.begin_ticks || scope.end_query == NO_QUERY)
+            continue;
+
+        GpuTiming timing{
+            .name = std::move(scope.name),
+            .start_ms = double((*scope.begin_ticks - *first_ticks) & mask) * ms_per_tick,
+            .duration_ms = double((ticks[scope.end_query] - *scope.begin_ticks) & mask) * ms_per_tick,
+            .depth = scope.depth,
+        };
+        // GPU and CPU clocks are not calibrated, the submission is placed at the time it was submitted.
+        if (export_events) {
+            profiler.add_event({
+                .name = timing.name,
+                .category = "gpu",
+                .track = track,
+                .start_us = context.submit_time_us + timing.start_ms * 1e3,
+                .duration_us = timing.duration_ms * 1e3,
+            });
+        }
+        context.timings.push_back(std::move(timing));
+    }
+    context.timestamp_scopes = std::move(open_scopes);
+    context.open_scopes.resize(context.timestamp_scopes.size());
+    std::iota(context.open_scopes.begin(), context.open_scopes.end(), size_t(0));
+}
+
+Device::Device(const DeviceDesc &desc)
+{
+    if (desc.backend == DeviceBackend::Cpu)
+        m_cpu = std::make_unique<CpuDevice>(desc);
+    else
+        m_impl = std::make_unique<DeviceImpl>(desc);
+}
+
+Device::~Device()
+{
+    // release the deferred destructions before the memory blocks are freed
+    if (m_impl) {
+        vkDeviceWaitIdle(m_impl->vk_device);
+        collect_deferred_destructions(*m_impl);
+    }
+}
+
+ShaderHandle Device::create_shader(const ShaderDesc &desc)
+{
+    if (m_cpu)
+        return m_cpu->create_shader(desc);
+    ShaderHandle shader = m_impl->shaders.alloc();
+    ShaderImpl *shader_impl = m_impl->shaders[shader];
+
+    shader_impl->desc = desc;
+    const uint32_t *code = static_cast<const uint32_t *>(desc.code);
+    shader_impl->code.assign(code, code + desc.code_size / sizeof(uint32_t));
+
+    VkShaderModuleCreateInfo create_info{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    create_info.pCode = static_cast<const uint32_t *>(desc.code);
+    create_info.codeSize = desc.code_size;
+
+    VK_CHECK(vkCreateShaderModule(m_impl->vk_device, &create_info, nullptr, &shader_impl->vk_shader_module));
+
+    return shader;
+}
+
+void Device::destroy_shader(ShaderHandle shader)
+{
+    if (m_cpu)
+        return m_cpu->destroy_shader(shader);
+    ShaderImpl *shader_impl = m_impl->shaders[shader];
+    if (!shader_impl)
+        return;
+
+    vkDestroyShaderModule(m_impl->vk_device, shader_impl->vk_shader_module, nullptr);
+    m_impl->shaders.free(shader);
+}
+
+BufferHandle Device::create_buffer(const BufferDesc &desc)
+{
+    if (m_cpu)
+        return m_cpu->create_buffer(desc);
+    BufferHandle buffer = m_impl->buffers.alloc();
+    BufferImpl *buffer_impl = m_impl->buffers[buffer];
+
+    buffer_impl->desc = desc;
+    buffer_impl->state = ResourceState::Undefined;
+    buffer_impl->uses.clear();
 
     ResourceUsageInfo usage_info = get_resource_usage_info(desc.usage);
 
     VkBufferCreateInfo create_info{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
     create_info.size = desc.size;
     create_info.usage = usage_info.buffer_usage;
-    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    create_info.queueFamilyIndexCount = 1;
-    create_info.pQueueFamilyIndices = &m_impl->graphics_queue_family;
+    set_sharing_mode(*m_impl, create_info);
     VK_CHECK(vkCreateBuffer(m_impl->vk_device, &create_info, nullptr, &buffer_impl->vk_buffer));
 
     VkMemoryRequirements memory_requirements;
     vkGetBufferMemoryRequirements(m_impl->vk_device, buffer_impl->vk_buffer, &memory_requirements);
 
-    // VkMemoryAllocateFlagsInfo flags_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO};
-    // flags_info.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
-
-    VkMemoryAllocateInfo allocate_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    // allocate_info.pNext = &flags_info;
-    allocate_info.allocationSize = memory_requirements.size;
-    allocate_info.memoryTypeIndex = m_impl->find_memory_type(memory_requirements.memoryTypeBits, desc.memory);
-    VK_CHECK(vkAllocateMemory(m_impl->vk_device, &allocate_info, nullptr, &buffer_impl->vk_device_memory));
-    VK_CHECK(vkBindBufferMemory(m_impl->vk_device, buffer_impl->vk_buffer, buffer_impl->vk_device_memory, 0));
+    buffer_impl->allocation = allocate_memory(*m_impl, memory_requirements, desc.memory, true, desc.transient);
+    VK_CHECK(vkBindBufferMemory(m_impl->vk_device, buffer_impl->vk_buffer, buffer_impl->allocation.vk_device_memory,
+                                buffer_impl->allocation.offset));
 
     return buffer;
 }
 
 void Device::destroy_buffer(BufferHandle buffer)
 {
+    if (m_cpu)
+        return m_cpu->destroy_buffer(buffer);
     BufferImpl *buffer_impl = m_impl->buffers[buffer];
     if (!buffer_impl)
         return;
 
-    vkDestroyBuffer(m_impl->vk_device, buffer_impl->vk_buffer, nullptr);
-    vkFreeMemory(m_impl->vk_device, buffer_impl->vk_device_memory, nullptr);
+    DeferredDestruction destruction{
+        .uses = std::move(buffer_impl->uses),
+        .vk_buffer = buffer_impl->vk_buffer,
+        .allocation = std::exchange(buffer_impl->allocation, {}),
+    };
+    for (const auto &[view_key, vk_buffer_view] : buffer_impl->views)
+        destruction.vk_buffer_views.push_back(vk_buffer_view);
+    buffer_impl->views.clear();
+    buffer_impl->uses.clear();
     m_impl->buffers.free(buffer);
+
+    destroy_deferred(*m_impl, std::move(destruction));
 }
 
 ImageHandle Device::create_image(const ImageDesc &desc)
 {
+    if (m_cpu)
+        return m_cpu->create_image(desc);
     ImageHandle image = m_impl->images.alloc();
     ImageImpl *image_impl = m_impl->images[image];
 
+    FR_ASSERT(desc.mip_levels >= 1 && desc.mip_levels <= mip_level_count(desc.width, desc.height));
+    FR_ASSERT(desc.array_layers >= 1);
+    FR_ASSERT(desc.memory == MemoryType::Device || (desc.mip_levels == 1 && desc.array_layers == 1));
+
     image_impl->desc = desc;
-    image_impl->state = ResourceState::Undefined;
+    image_impl->states.assign(size_t(desc.mip_levels) * desc.array_layers, ResourceState::Undefined);
+    image_impl->uses.clear();
+    image_impl->bindless_slot_count = 0;
 
     ResourceUsageInfo usage_info = get_resource_usage_info(desc.usage);
+    // mip levels are generated by blits between levels
+    if (desc.mip_levels > 1)
+        usage_info.image_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
     VkImageCreateInfo create_info{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
     create_info.imageType = VK_IMAGE_TYPE_2D;
     create_info.format = IMAGE_FORMAT_MAP[static_cast<size_t>(desc.format)];
-    create_info.mipLevels = 1;
-    create_info.arrayLayers = 1;
+    create_info.mipLevels = desc.mip_levels;
+    create_info.arrayLayers = desc.array_layers;
     create_info.samples = VK_SAMPLE_COUNT_1_BIT;
-    // TODO: this is a crude way to allow reading image data on the host
+    // host memory images are linear so they can be accessed through the mapping
     create_info.tiling = desc.memory == MemoryType::Device ? VK_IMAGE_TILING_OPTIMAL : VK_IMAGE_TILING_LINEAR;
     create_info.usage = usage_info.image_usage;
-    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    create_info.queueFamilyIndexCount = 1;
-    create_info.pQueueFamilyIndices = &m_impl->graphics_queue_family;
+    set_sharing_mode(*m_impl, create_info);
     create_info.extent = {desc.width, desc.height, 1};
     create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
@@ -778,30 +1969,64 @@ ImageHandle Device::create_image(const ImageDesc &desc)
     VkMemoryRequirements memory_requirements;
     vkGetImageMemoryRequirements(m_impl->vk_device, image_impl->vk_image, &memory_requirements);
 
-    VkMemoryAllocateInfo allocate_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    allocate_info.allocationSize = memory_requirements.size;
-    allocate_info.memoryTypeIndex = m_impl->find_memory_type(memory_requirements.memoryTypeBits, desc.memory);
-    VK_CHECK(vkAllocateMemory(m_impl->vk_device, &allocate_info, nullptr, &image_impl->vk_device_memory));
-    VK_CHECK(vkBindImageMemory(m_impl->vk_device, image_impl->vk_image, image_impl->vk_device_memory, 0));
+    const bool linear = create_info.tiling == VK_IMAGE_TILING_LINEAR;
+    image_impl->allocation = allocate_memory(*m_impl, memory_requirements, desc.memory, linear, desc.transient);
+    VK_CHECK(vkBindImageMemory(m_impl->vk_device, image_impl->vk_image, image_impl->allocation.vk_device_memory,
+                               image_impl->allocation.offset));
+
+    image_impl->linear_layout = {};
+    if (linear) {
+        VkImageSubresource subresource{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+        vkGetImageSubresourceLayout(m_impl->vk_device, image_impl->vk_image, &subresource,
+                                    &image_impl->linear_layout);
+    }
 
     return image;
 }
 
 void Device::destroy_image(ImageHandle image)
 {
+    if (m_cpu)
+        return m_cpu->destroy_image(image);
     ImageImpl *image_impl = m_impl->images[image];
     if (!image_impl)
         return;
 
-    vkDestroyImage(m_impl->vk_device, image_impl->vk_image, nullptr);
-    vkFreeMemory(m_impl->vk_device, image_impl->vk_device_memory, nullptr);
+    // free the indices still holding the image, the descriptors are left as is (see remove_bindless_image())
+    if (image_impl->bindless_slot_count > 0) {
+        std::lock_guard<std::mutex> lock(m_impl->bindless_mutex);
+        for (BindlessArray &array : m_impl->bindless_arrays) {
+            for (uint32_t index = 0; index < array.slots.size(); ++index) {
+                if (array.slots[index].image == image) {
+                    array.slots[index].image = ImageHandle::null();
+                    array.free_indices.push_back(index);
+                }
+            }
+        }
+        image_impl->bindless_slot_count = 0;
+    }
+
+    DeferredDestruction destruction{
+        .uses = std::move(image_impl->uses),
+        .vk_image = image_impl->vk_image,
+        .allocation = std::exchange(image_impl->allocation, {}),
+    };
+    for (const auto &[view_key, vk_image_view] : image_impl->views)
+        destruction.vk_image_views.push_back(vk_image_view);
+    image_impl->views.clear();
+    image_impl->uses.clear();
     m_impl->images.free(image);
+
+    destroy_deferred(*m_impl, std::move(destruction));
 }
 
 SamplerHandle Device::create_sampler(const SamplerDesc &desc)
 {
+    if (m_cpu)
+        return m_cpu->create_sampler(desc);
     SamplerHandle sampler = m_impl->samplers.alloc();
     SamplerImpl *sampler_impl = m_impl->samplers[sampler];
+    sampler_impl->uses.clear();
 
     VkSamplerCreateInfo create_info{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
     create_info.magFilter = SAMPLER_FILTER_MAP[static_cast<uint32_t>(desc.mag_filter)];
@@ -818,20 +2043,41 @@ SamplerHandle Device::create_sampler(const SamplerDesc &desc)
 
 void Device::destroy_sampler(SamplerHandle sampler)
 {
+    if (m_cpu)
+        return m_cpu->destroy_sampler(sampler);
     SamplerImpl *sampler_impl = m_impl->samplers[sampler];
     if (!sampler_impl)
         return;
 
-    vkDestroySampler(m_impl->vk_device, sampler_impl->vk_sampler, nullptr);
+    DeferredDestruction destruction{.uses = std::move(sampler_impl->uses), .vk_sampler = sampler_impl->vk_sampler};
+    sampler_impl->uses.clear();
     m_impl->samplers.free(sampler);
+
+    destroy_deferred(*m_impl, std::move(destruction));
 }
 
-PipelineHandle Device::create_pipeline(const PipelineDesc &desc)
+/**
+ * Create the Vulkan objects of a pipeline, only reads device state so it can be called from worker threads.
+ * On failure the objects created so far are left in pipeline_impl, see destroy_pipeline_objects().
+ */
+inline void create_pipeline_objects(DeviceImpl &device, PipelineImpl *pipeline_impl)
 {
-    PipelineHandle pipeline = m_impl->pipelines.alloc();
-    PipelineImpl *pipeline_impl = m_impl->pipelines[pipeline];
+    const PipelineDesc &desc = pipeline_impl->desc;
+
+    ShaderImpl *shader = device.shaders[desc.shader];
+    FR_ASSERT(shader);
+    FR_ASSERT(shader->desc.entry_point_name);
 
-    pipeline_impl->desc = desc;
+    // numthreads is not specializable in HLSL, other workgroup sizes use a patched module that only lives during
+    // pipeline creation
+    std::vector<uint32_t> patched_code;
+    if (desc.workgroup_size != WorkgroupSize{}) {
+        FR_ASSERT(uint64_t(desc.workgroup_size[0]) * desc.workgroup_size[1] * desc.workgroup_size[2] <=
+                  device.vk_properties.limits.maxComputeWorkGroupInvocations);
+        patched_code = shader->code;
+        if (!set_spirv_workgroup_size(patched_code, desc.workgroup_size))
+            throw std::runtime_error("Cannot set the workgroup size of a shader without a LocalSize execution mode");
+    }
 
     std::vector<VkDescriptorSetLayoutBinding> bindings;
     for (const auto &item : desc.binding_layout) {
@@ -850,7 +2096,7 @@ PipelineHandle Device::create_pipeline(const PipelineDesc &desc)
     descriptor_set_layout_create_info.bindingCount = static_cast<uint32_t>(bindings.size());
     descriptor_set_layout_create_info.pBindings = bindings.data();
 
-    VK_CHECK(vkCreateDescriptorSetLayout(m_impl->vk_device, &descriptor_set_layout_create_info, nullptr,
+    VK_CHECK(vkCreateDescriptorSetLayout(device.vk_device, &descriptor_set_layout_create_info, nullptr,
                                          &pipeline_impl->vk_descriptor_set_layout));
 
     VkPushConstantRange push_constant_range{};
@@ -858,126 +2104,464 @@ PipelineHandle Device::create_pipeline(const PipelineDesc &desc)
     push_constant_range.size = desc.push_constants_size;
     push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+    // bindless pipelines use the device's bindless set as set 1
+    FR_ASSERT(!desc.bindless || device.vk_bindless_set_layout != VK_NULL_HANDLE);
+    const VkDescriptorSetLayout set_layouts[] = {pipeline_impl->vk_descriptor_set_layout,
+                                                 device.vk_bindless_set_layout};
+
     VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
     pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_create_info.setLayoutCount = 1;
-    pipeline_layout_create_info.pSetLayouts = &pipeline_impl->vk_descriptor_set_layout;
+    pipeline_layout_create_info.setLayoutCount = desc.bindless ? 2 : 1;
+    pipeline_layout_create_info.pSetLayouts = set_layouts;
     pipeline_layout_create_info.pushConstantRangeCount = desc.push_constants_size > 0 ? 1 : 0;
     pipeline_layout_create_info.pPushConstantRanges = desc.push_constants_size > 0 ? &push_constant_range : nullptr;
 
-    VK_CHECK(vkCreatePipelineLayout(m_impl->vk_device, &pipeline_layout_create_info, nullptr,
+    VK_CHECK(vkCreatePipelineLayout(device.vk_device, &pipeline_layout_create_info, nullptr,
                                     &pipeline_impl->vk_pipeline_layout));
 
-    ShaderImpl *shader = m_impl->shaders[desc.shader];
-    FR_ASSERT(shader);
-    FR_ASSERT(shader->desc.entry_point_name);
+    VkShaderModule vk_shader_module = shader->vk_shader_module;
+    if (!patched_code.empty()) {
+        VkShaderModuleCreateInfo module_create_info{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+        module_create_info.pCode = patched_code.data();
+        module_create_info.codeSize = patched_code.size() * sizeof(uint32_t);
+        VK_CHECK(vkCreateShaderModule(device.vk_device, &module_create_info, nullptr, &vk_shader_module));
+    }
+
+    // all constants are 32-bit, packed in declaration order
+    std::vector<VkSpecializationMapEntry> map_entries;
+    std::vector<uint32_t> specialization_data;
+    for (const SpecializationConstant &constant : desc.specialization_constants) {
+        map_entries.push_back({constant.id, uint32_t(specialization_data.size() * sizeof(uint32_t)), sizeof(uint32_t)});
+        specialization_data.push_back(constant.value);
+    }
+
+    VkSpecializationInfo specialization_info{};
+    specialization_info.mapEntryCount = uint32_t(map_entries.size());
+    specialization_info.pMapEntries = map_entries.data();
+    specialization_info.dataSize = specialization_data.size() * sizeof(uint32_t);
+    specialization_info.pData = specialization_data.data();
 
     VkPipelineShaderStageCreateInfo stage_create_info{};
     stage_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     stage_create_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    stage_create_info.module = shader->vk_shader_module;
+    stage_create_info.module = vk_shader_module;
     stage_create_info.pName = shader->desc.entry_point_name;
+    stage_create_info.pSpecializationInfo = map_entries.empty() ? nullptr : &specialization_info;
 
     VkComputePipelineCreateInfo pipeline_create_info{};
     pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
     pipeline_create_info.stage = stage_create_info;
     pipeline_create_info.layout = pipeline_impl->vk_pipeline_layout;
 
-    VK_CHECK(vkCreateComputePipelines(m_impl->vk_device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr,
-                                      &pipeline_impl->vk_pipeline));
+    const VkResult create_result = vkCreateComputePipelines(
+        device.vk_device, device.vk_pipeline_cache, 1, &pipeline_create_info, nullptr, &pipeline_impl->vk_pipeline);
+    if (vk_shader_module != shader->vk_shader_module)
+        vkDestroyShaderModule(device.vk_device, vk_shader_module, nullptr);
+    VK_CHECK(create_result);
+}
+
+/// Destroy the Vulkan objects of a pipeline, including those of a partially created one.
+inline void destroy_pipeline_objects(DeviceImpl &device, PipelineImpl &pipeline_impl)
+{
+    vkDestroyPipeline(device.vk_device, pipeline_impl.vk_pipeline, nullptr);
+    vkDestroyPipelineLayout(device.vk_device, pipeline_impl.vk_pipeline_layout, nullptr);
+    vkDestroyDescriptorSetLayout(device.vk_device, pipeline_impl.vk_descriptor_set_layout, nullptr);
+}
+
+PipelineHandle Device::create_pipeline(const PipelineDesc &desc)
+{
+    if (m_cpu)
+        return m_cpu->create_pipeline(desc);
+    PipelineHandle pipeline = m_impl->pipelines.alloc();
+    PipelineImpl *pipeline_impl = m_impl->pipelines[pipeline];
+
+    *pipeline_impl = {.desc = desc};
+    try {
+        create_pipeline_objects(*m_impl, pipeline_impl);
+    } catch (...) {
+        destroy_pipeline_objects(*m_impl, *pipeline_impl);
+        m_impl->pipelines.free(pipeline);
+        throw;
+    }
 
     return pipeline;
 }
 
+std::vector<PipelineHandle> Device::create_pipelines(std::span<const PipelineDesc> descs)
+{
+    if (m_cpu)
+        return m_cpu->create_pipelines(descs);
+    // Allocate all handles upfront, workers only create the Vulkan objects.
+    std::vector<PipelineHandle> pipelines(descs.size());
+    for (size_t i = 0; i < descs.size(); ++i) {
+        pipelines[i] = m_impl->pipelines.alloc();
+        *m_impl->pipelines[pipelines[i]] = {.desc = descs[i]};
+    }
+
+    std::call_once(m_impl->compile_pool_once, [&] { m_impl->compile_pool = std::make_unique<BS::thread_pool>(); });
+
+    // The pipeline cache is internally synchronized, so pipelines can share it while being compiled concurrently.
+    std::vector<std::future<void>> futures;
+    futures.reserve(pipelines.size());
+    for (PipelineHandle pipeline : pipelines) {
+        PipelineImpl *pipeline_impl = m_impl->pipelines[pipeline];
+        futures.push_back(
+            m_impl->compile_pool->submit([this, pipeline_impl] { create_pipeline_objects(*m_impl, pipeline_impl); }));
+    }
+    // Waits for all workers before rethrowing the first error, then destroys every pipeline of the call.
+    std::exception_ptr error;
+    for (auto &future : futures) {
+        try {
+            future.get();
+        } catch (...) {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+    if (error) {
+        for (PipelineHandle pipeline : pipelines) {
+            destroy_pipeline_objects(*m_impl, *m_impl->pipelines[pipeline]);
+            m_impl->pipelines.free(pipeline);
+        }
+        std::rethrow_exception(error);
+    }
+
+    return pipelines;
+}
+
 void Device::destroy_pipeline(PipelineHandle pipeline)
 {
+    if (m_cpu)
+        return m_cpu->destroy_pipeline(pipeline);
     PipelineImpl *pipeline_impl = m_impl->pipelines[pipeline];
     if (!pipeline_impl)
         return;
 
-    vkDestroyPipeline(m_impl->vk_device, pipeline_impl->vk_pipeline, nullptr);
-    vkDestroyPipelineLayout(m_impl->vk_device, pipeline_impl->vk_pipeline_layout, nullptr);
-    vkDestroyDescriptorSetLayout(m_impl->vk_device, pipeline_impl->vk_descriptor_set_layout, nullptr);
-
+    destroy_pipeline_objects(*m_impl, *pipeline_impl);
     m_impl->pipelines.free(pipeline);
 }
 
-ContextHandle Device::create_context()
+bool Device::save_pipeline_cache()
+{
+    if (m_cpu)
+        return true;
+    return m_impl->save_pipeline_cache_data();
+}
+
+inline uint32_t get_bindless_binding(DescriptorType type)
 {
+    FR_ASSERT(type == DescriptorType::Texture || type == DescriptorType::RWTexture);
+    return type == DescriptorType::Texture ? BINDLESS_TEXTURE_BINDING : BINDLESS_RW_TEXTURE_BINDING;
+}
+
+uint32_t Device::add_bindless_image(ImageHandle image, DescriptorType type, const ImageSubresourceRange &subresource)
+{
+    if (m_cpu)
+        return m_cpu->add_bindless_image(image, type, subresource);
+    ImageImpl *image_impl = m_impl->images[image];
+    FR_ASSERT(image_impl);
+    FR_ASSERT(m_impl->vk_bindless_set != VK_NULL_HANDLE);
+
+    const uint32_t binding = get_bindless_binding(type);
+    const ImageSubresourceRange range =
+        get_binding_subresource(*image_impl, {.subresource = subresource}, {.binding = binding, .type = type});
+
+    std::lock_guard<std::mutex> lock(m_impl->bindless_mutex);
+    BindlessArray &array = m_impl->bindless_arrays[binding];
+    uint32_t index;
+    if (!array.free_indices.empty()) {
+        index = array.free_indices.back();
+        array.free_indices.pop_back();
+    } else {
+        FR_ASSERT(array.slots.size() < m_impl->desc.bindless_image_count);
+        index = static_cast<uint32_t>(array.slots.size());
+        array.slots.emplace_back();
+    }
+    array.slots[index] = {.image = image, .subresource = range};
+    image_impl->bindless_slot_count++;
+
+    ImageViewKey view_key{
+        .format = IMAGE_FORMAT_MAP[static_cast<size_t>(image_impl->desc.format)],
+        .base_mip_level = range.base_mip_level,
+        .mip_level_count = range.mip_level_count,
+        .base_array_layer = range.base_array_layer,
+        .array_layer_count = range.array_layer_count,
+    };
+    VkDescriptorImageInfo image_info{};
+    image_info.imageView = get_image_view(*m_impl, *image_impl, view_key);
+    image_info.imageLayout = DESCRIPTOR_TYPE_MAP[static_cast<size_t>(type)].layout;
+
+    // the set may be bound by recording contexts, update-after-bind allows updating the unused element
+    VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = m_impl->vk_bindless_set;
+    write.dstBinding = binding;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = DESCRIPTOR_TYPE_MAP[static_cast<size_t>(type)].type;
+    write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(m_impl->vk_device, 1, &write, 0, nullptr);
+
+    return index;
+}
+
+void Device::remove_bindless_image(DescriptorType type, uint32_t index)
+{
+    if (m_cpu)
+        return m_cpu->remove_bindless_image(type, index);
+    std::lock_guard<std::mutex> lock(m_impl->bindless_mutex);
+    BindlessArray &array = m_impl->bindless_arrays[get_bindless_binding(type)];
+    FR_ASSERT(index < array.slots.size() && array.slots[index].image != ImageHandle::null());
+
+    // the descriptor is left as is, partially bound arrays may contain descriptors that are not accessed
+    m_impl->images[array.slots[index].image]->bindless_slot_count--;
+    array.slots[index].image = ImageHandle::null();
+    array.free_indices.push_back(index);
+}
+
+ContextHandle Device::create_context(const ContextDesc &desc)
+{
+    if (m_cpu)
+        return m_cpu->create_context(desc);
     ContextHandle context = m_impl->contexts.alloc();
     ContextImpl *context_impl = m_impl->contexts[context];
 
+    context_impl->handle = context;
+    context_impl->queue = desc.queue;
     context_impl->is_recording = false;
 
-    VkFenceCreateInfo fence_create_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-    VK_CHECK(vkCreateFence(m_impl->vk_device, &fence_create_info, nullptr, &context_impl->vk_fence));
+    VkSemaphoreTypeCreateInfo semaphore_type_create_info{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    semaphore_type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphore_type_create_info.initialValue = 0;
+    VkSemaphoreCreateInfo semaphore_create_info{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    append_create_info(semaphore_create_info, semaphore_type_create_info);
+    VK_CHECK(vkCreateSemaphore(m_impl->vk_device, &semaphore_create_info, nullptr, &context_impl->vk_semaphore));
+
+    VkCommandPoolCreateInfo command_pool_create_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    command_pool_create_info.queueFamilyIndex = m_impl->queues[static_cast<size_t>(desc.queue)].family;
+    VK_CHECK(vkCreateCommandPool(m_impl->vk_device, &command_pool_create_info, nullptr,
+                                 &context_impl->vk_command_pool));
 
     VkCommandBufferAllocateInfo alloc_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
-    alloc_info.commandPool = m_impl->vk_command_pool;
+    alloc_info.commandPool = context_impl->vk_command_pool;
     alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     alloc_info.commandBufferCount = 1;
 
     VK_CHECK(vkAllocateCommandBuffers(m_impl->vk_device, &alloc_info, &context_impl->vk_command_buffer));
 
+    if (desc.enable_timestamps && m_impl->queues[static_cast<size_t>(desc.queue)].timestamp_valid_bits > 0) {
+        VkQueryPoolCreateInfo create_info{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        create_info.queryCount = 2 * desc.max_timestamp_scopes;
+        VK_CHECK(vkCreateQueryPool(m_impl->vk_device, &create_info, nullptr, &context_impl->vk_query_pool));
+        context_impl->query_capacity = create_info.queryCount;
+    }
+
     return context;
 }
 
-void Device::destroy_context(ContextHandle context)
+void Device::destroy_context(ContextHandle context)
+{
+    if (m_cpu)
+        return m_cpu->destroy_context(context);
+    ContextImpl *context_impl = m_impl->contexts[context];
+    if (!context_impl)
+        return;
+
+    // pending submissions still use the command buffer and staging buffer, and resources destroyed while they were
+    // recorded are only released once they complete
+    wait(context);
+
+    destroy_staging_buffer(*m_impl, context_impl->staging_buffer);
+    reset_descriptor_sets(*m_impl, *context_impl);
+    for (VkDescriptorPool vk_descriptor_pool : context_impl->descriptor_pools)
+        vkDestroyDescriptorPool(m_impl->vk_device, vk_descriptor_pool, nullptr);
+    if (context_impl->vk_query_pool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(m_impl->vk_device, context_impl->vk_query_pool, nullptr);
+    // also frees the command buffer
+    vkDestroyCommandPool(m_impl->vk_device, context_impl->vk_command_pool, nullptr);
+
+    // deferred destructions may be querying the semaphore
+    std::lock_guard<std::mutex> lock(m_impl->deferred_mutex);
+    vkDestroySemaphore(m_impl->vk_device, context_impl->vk_semaphore, nullptr);
+    // the pool reuses the object for the next context
+    *context_impl = {};
+    m_impl->contexts.free(context);
+}
+
+bool Device::has_dedicated_queue(QueueType queue) const
+{
+    if (m_cpu)
+        return queue == QueueType::Graphics;
+    return m_impl->queues[static_cast<size_t>(queue)].dedicated;
+}
+
+void Device::begin(ContextHandle context)
+{
+    if (m_cpu)
+        return m_cpu->begin(context);
+    ContextImpl *context_impl = m_impl->contexts[context];
+    if (!context_impl)
+        return;
+
+    FR_ASSERT(!context_impl->is_recording);
+
+    // the command buffer, staging buffer and descriptor sets are reused
+    if (context_impl->retired_value < context_impl->submitted_value)
+        wait(context);
+
+    VkCommandBufferBeginInfo begin_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VK_CHECK(vkBeginCommandBuffer(context_impl->vk_command_buffer, &begin_info));
+    context_impl->bound_pipeline = VK_NULL_HANDLE;
+    context_impl->bound_descriptor_set = VK_NULL_HANDLE;
+
+    if (context_impl->vk_query_pool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(context_impl->vk_command_buffer, context_impl->vk_query_pool, 0,
+                            context_impl->query_capacity);
+        context_impl->query_count = 0;
+    }
+
+    context_impl->is_recording = true;
+}
+
+uint64_t Device::submit(ContextHandle context)
+{
+    if (m_cpu)
+        return m_cpu->submit(context);
+    ContextImpl *context_impl = m_impl->contexts[context];
+    if (!context_impl)
+        return 0;
+
+    FR_ASSERT(context_impl->is_recording);
+
+    // transitions without a following command still need to be recorded, the tracked state already changed
+    flush_barriers(*context_impl);
+
+    if (context_impl->host_visible_writes) {
+        VkMemoryBarrier memory_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        memory_barrier.srcAccessMask = WRITE_ACCESS_MASK;
+        memory_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(context_impl->vk_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT, VkDependencyFlags(0), 1, &memory_barrier, 0, nullptr, 0,
+                             nullptr);
+        context_impl->host_visible_writes = false;
+    }
+
+    VK_CHECK(vkEndCommandBuffer(context_impl->vk_command_buffer));
+
+    std::vector<VkSemaphore> wait_semaphores;
+    std::vector<uint64_t> wait_values;
+    for (const auto &[vk_semaphore, value] : context_impl->pending_waits) {
+        wait_semaphores.push_back(vk_semaphore);
+        wait_values.push_back(value);
+    }
+    std::vector<VkPipelineStageFlags> wait_stages(wait_semaphores.size(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    context_impl->pending_waits.clear();
+
+    const uint64_t signal_value = ++context_impl->submitted_value;
+
+    VkTimelineSemaphoreSubmitInfo timeline_submit_info{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    timeline_submit_info.waitSemaphoreValueCount = static_cast<uint32_t>(wait_values.size());
+    timeline_submit_info.pWaitSemaphoreValues = wait_values.data();
+    timeline_submit_info.signalSemaphoreValueCount = 1;
+    timeline_submit_info.pSignalSemaphoreValues = &signal_value;
+
+    VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit_info.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size());
+    submit_info.pWaitSemaphores = wait_semaphores.data();
+    submit_info.pWaitDstStageMask = wait_stages.data();
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &context_impl->vk_command_buffer;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &context_impl->vk_semaphore;
+    append_create_info(submit_info, timeline_submit_info);
+
+    {
+        const Queue &queue = m_impl->queues[static_cast<size_t>(context_impl->queue)];
+        std::lock_guard<std::mutex> lock(*queue.mutex);
+        VK_CHECK(vkQueueSubmit(queue.vk_queue, 1, &submit_info, VK_NULL_HANDLE));
+    }
+
+    context_impl->is_recording = false;
+    if (!context_impl->timestamp_scopes.empty())
+        context_impl->submit_time_us = Profiler::global().now_us();
+
+    return signal_value;
+}
+
+bool Device::wait(ContextHandle context, uint64_t timeout_ns)
 {
+    if (m_cpu)
+        return true;
     ContextImpl *context_impl = m_impl->contexts[context];
     if (!context_impl)
-        return;
+        return true;
 
-    vkDestroyFence(m_impl->vk_device, context_impl->vk_fence, nullptr);
-    vkFreeCommandBuffers(m_impl->vk_device, m_impl->vk_command_pool, 1, &context_impl->vk_command_buffer);
+    if (!wait_for_value(context, context_impl->submitted_value, timeout_ns))
+        return false;
 
-    m_impl->contexts.free(context);
+    retire(context);
+    return true;
 }
 
-void Device::begin(ContextHandle context)
+bool Device::wait_for_value(ContextHandle context, uint64_t value, uint64_t timeout_ns)
 {
+    if (m_cpu)
+        return true;
     ContextImpl *context_impl = m_impl->contexts[context];
-    if (!context_impl)
-        return;
-
-    FR_ASSERT(!context_impl->is_recording);
+    if (!context_impl || value == 0)
+        return true;
 
-    VkCommandBufferBeginInfo begin_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    VK_CHECK(vkBeginCommandBuffer(context_impl->vk_command_buffer, &begin_info));
+    FR_ASSERT(value <= context_impl->submitted_value);
 
-    VK_CHECK(vkResetFences(m_impl->vk_device, 1, &context_impl->vk_fence));
+    VkSemaphoreWaitInfo wait_info{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &context_impl->vk_semaphore;
+    wait_info.pValues = &value;
 
-    context_impl->is_recording = true;
+    VkResult result = vkWaitSemaphores(m_impl->vk_device, &wait_info, timeout_ns);
+    if (result == VK_TIMEOUT)
+        return false;
+    VK_CHECK(result);
+    return true;
 }
-void Device::submit(ContextHandle context)
+
+bool Device::poll(ContextHandle context)
 {
+    if (m_cpu)
+        return true;
     ContextImpl *context_impl = m_impl->contexts[context];
     if (!context_impl)
-        return;
-
-    FR_ASSERT(context_impl->is_recording);
+        return true;
 
-    VK_CHECK(vkEndCommandBuffer(context_impl->vk_command_buffer));
+    if (completed_value(context) < context_impl->submitted_value)
+        return false;
 
-    VkSubmitInfo submit_info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &context_impl->vk_command_buffer;
+    retire(context);
+    return true;
+}
 
-    VK_CHECK(vkQueueSubmit(m_impl->vk_queue, 1, &submit_info, context_impl->vk_fence));
+uint64_t Device::completed_value(ContextHandle context) const
+{
+    if (m_cpu)
+        return m_cpu->completed_value(context);
+    const ContextImpl *context_impl = m_impl->contexts[context];
+    if (!context_impl)
+        return 0;
 
-    context_impl->is_recording = false;
+    uint64_t value;
+    VK_CHECK(vkGetSemaphoreCounterValue(m_impl->vk_device, context_impl->vk_semaphore, &value));
+    return value;
 }
 
-void Device::wait(ContextHandle context)
+void Device::retire(ContextHandle context)
 {
     ContextImpl *context_impl = m_impl->contexts[context];
-    if (!context_impl)
+    if (!context_impl || context_impl->retired_value == context_impl->submitted_value)
         return;
 
-    VK_CHECK(vkWaitForFences(m_impl->vk_device, 1, &context_impl->vk_fence, VK_TRUE, 1000000000));
-
     // release transient resources
     for (const ResourceHandle &resource : context_impl->transient_resources) {
         // TODO use visitor
@@ -988,15 +2572,87 @@ void Device::wait(ContextHandle context)
         else if (auto sampler = std::get_if<SamplerHandle>(&resource))
             destroy_sampler(*sampler);
     }
+    context_impl->transient_resources.clear();
+
+    // recycle staging buffer and scratch memory
+    context_impl->staging_buffer.head = 0;
+    context_impl->scratch.reset();
 
     // release descriptor sets
-    for (DescriptorSet &descriptor_set : context_impl->descriptor_sets)
-        destroy_descriptor_set(*m_impl, descriptor_set);
-    context_impl->descriptor_sets.clear();
+    reset_descriptor_sets(*m_impl, *context_impl);
+
+    resolve_timestamps(*m_impl, *context_impl);
+
+    context_impl->retired_value = context_impl->submitted_value;
+
+    collect_deferred_destructions(*m_impl);
+    release_empty_blocks(*m_impl);
+}
+
+void Device::add_dependency(ContextHandle context, ContextHandle dependency, uint64_t value)
+{
+    if (m_cpu)
+        return;
+    ContextImpl *context_impl = m_impl->contexts[context];
+    ContextImpl *dependency_impl = m_impl->contexts[dependency];
+    if (!context_impl || !dependency_impl)
+        return;
+
+    if (value == 0)
+        value = dependency_impl->submitted_value;
+    FR_ASSERT(value <= dependency_impl->submitted_value);
+    if (value == 0)
+        return;
+
+    context_impl->pending_waits.emplace_back(dependency_impl->vk_semaphore, value);
+}
+
+void Device::flush(ContextHandle context)
+{
+    submit(context);
+    wait(context);
+    begin(context);
+}
+
+std::span<uint8_t> Device::map_buffer(BufferHandle buffer)
+{
+    if (m_cpu)
+        return m_cpu->map_buffer(buffer);
+    BufferImpl *buffer_impl = m_impl->buffers[buffer];
+    if (!buffer_impl || !buffer_impl->allocation.mapped)
+        return {};
+
+    return {buffer_impl->allocation.mapped, buffer_impl->desc.size};
+}
+
+void Device::flush_buffer(BufferHandle buffer, size_t offset, size_t size)
+{
+    if (m_cpu)
+        return;
+    BufferImpl *buffer_impl = m_impl->buffers[buffer];
+    if (!buffer_impl)
+        return;
+
+    FR_ASSERT(offset <= buffer_impl->desc.size);
+    flush_memory(*m_impl, buffer_impl->allocation, offset, std::min(size, buffer_impl->desc.size - offset));
+}
+
+void Device::invalidate_buffer(BufferHandle buffer, size_t offset, size_t size)
+{
+    if (m_cpu)
+        return;
+    BufferImpl *buffer_impl = m_impl->buffers[buffer];
+    if (!buffer_impl)
+        return;
+
+    FR_ASSERT(offset <= buffer_impl->desc.size);
+    invalidate_memory(*m_impl, buffer_impl->allocation, offset, std::min(size, buffer_impl->desc.size - offset));
 }
 
 void Device::write_buffer(ContextHandle context, BufferHandle buffer, const void *data, size_t size, size_t offset)
 {
+    if (m_cpu)
+        return m_cpu->write_buffer(context, buffer, data, size, offset);
     ContextImpl *context_impl = m_impl->contexts[context];
     BufferImpl *buffer_impl = m_impl->buffers[buffer];
     if (!context_impl || !buffer_impl || size == 0)
@@ -1004,36 +2660,44 @@ void Device::write_buffer(ContextHandle context, BufferHandle buffer, const void
 
     FR_ASSERT(data);
 
-    if (buffer_impl->desc.memory == MemoryType::Host) {
-        void *buffer_data;
-        VK_CHECK(vkMapMemory(m_impl->vk_device, buffer_impl->vk_device_memory, offset, size, 0, &buffer_data));
-        std::memcpy(buffer_data, data, size);
-        vkUnmapMemory(m_impl->vk_device, buffer_impl->vk_device_memory);
+    if (buffer_impl->desc.memory != MemoryType::Device) {
+        std::memcpy(buffer_impl->allocation.mapped + offset, data, size);
+        flush_memory(*m_impl, buffer_impl->allocation, offset, size);
     } else if (buffer_impl->desc.memory == MemoryType::Device) {
-        // create staging buffer
-        BufferHandle staging_buffer = create_buffer({
-            .size = size,
-            .usage = ResourceUsage::TransferSrc,
-            .memory = MemoryType::Host,
-        });
-
-        // TODO make stable pointer pools (pointer might be invalid after creating staging resource)
-        buffer_impl = m_impl->buffers[buffer];
-
-        write_buffer(context, staging_buffer, data, size);
+        StagingBuffer &staging_buffer = context_impl->staging_buffer;
+        const uint8_t *src = static_cast<const uint8_t *>(data);
+
+        transition_state(*m_impl, *context_impl, *buffer_impl, ResourceState::TransferDst);
+
+        // copy in chunks, flushing whenever the staging buffer is exhausted
+        size_t copied = 0;
+        while (copied < size) {
+            size_t chunk_size = std::min(size - copied, staging_available(*m_impl, staging_buffer, 16));
+            if (chunk_size == 0) {
+                flush(context);
+                continue;
+            }
+            size_t staging_offset = staging_allocate(staging_buffer, chunk_size, 16);
+            std::memcpy(staging_buffer.mapped + staging_offset, src + copied, chunk_size);
 
-        submit(context);
-        wait(context);
-        begin(context);
+            flush_barriers(*context_impl);
 
-        copy_buffer(context, staging_buffer, buffer, size, 0, offset);
+            VkBufferCopy buffer_copy{};
+            buffer_copy.srcOffset = staging_offset;
+            buffer_copy.dstOffset = offset + copied;
+            buffer_copy.size = chunk_size;
+            vkCmdCopyBuffer(context_impl->vk_command_buffer, staging_buffer.vk_buffer, buffer_impl->vk_buffer, 1,
+                            &buffer_copy);
 
-        context_impl->transient_resources.push_back(staging_buffer);
+            copied += chunk_size;
+        }
     }
 }
 
 void Device::read_buffer(ContextHandle context, BufferHandle buffer, void *data, size_t size, size_t offset)
 {
+    if (m_cpu)
+        return m_cpu->read_buffer(context, buffer, data, size, offset);
     ContextImpl *context_impl = m_impl->contexts[context];
     BufferImpl *buffer_impl = m_impl->buffers[buffer];
     if (!context_impl || !buffer_impl || size == 0)
@@ -1041,37 +2705,48 @@ void Device::read_buffer(ContextHandle context, BufferHandle buffer, void *data,
 
     FR_ASSERT(data);
 
-    if (buffer_impl->desc.memory == MemoryType::Host) {
-        void *buffer_data;
-        VK_CHECK(vkMapMemory(m_impl->vk_device, buffer_impl->vk_device_memory, offset, size, 0, &buffer_data));
-        std::memcpy(data, buffer_data, size);
-        vkUnmapMemory(m_impl->vk_device, buffer_impl->vk_device_memory);
+    if (buffer_impl->desc.memory != MemoryType::Device) {
+        invalidate_memory(*m_impl, buffer_impl->allocation, offset, size);
+        std::memcpy(data, buffer_impl->allocation.mapped + offset, size);
     } else if (buffer_impl->desc.memory == MemoryType::Device) {
-        // create staging buffer
-        BufferHandle staging_buffer = create_buffer({
-            .size = size,
-            .usage = ResourceUsage::TransferDst,
-            .memory = MemoryType::Host,
-        });
-
-        // TODO make stable pointer pools (pointer might be invalid after creating staging resource)
-        buffer_impl = m_impl->buffers[buffer];
+        StagingBuffer &staging_buffer = context_impl->staging_buffer;
+        uint8_t *dst = static_cast<uint8_t *>(data);
+
+        transition_state(*m_impl, *context_impl, *buffer_impl, ResourceState::TransferSrc);
+
+        // copy in chunks, the data is only available on the host after the commands completed
+        size_t copied = 0;
+        while (copied < size) {
+            size_t chunk_size = std::min(size - copied, staging_available(*m_impl, staging_buffer, 16));
+            if (chunk_size == 0) {
+                flush(context);
+                continue;
+            }
+            size_t staging_offset = staging_allocate(staging_buffer, chunk_size, 16);
 
-        copy_buffer(context, buffer, staging_buffer, size, offset, 0);
+            flush_barriers(*context_impl);
 
-        submit(context);
-        wait(context);
-        begin(context);
+            VkBufferCopy buffer_copy{};
+            buffer_copy.srcOffset = offset + copied;
+            buffer_copy.dstOffset = staging_offset;
+            buffer_copy.size = chunk_size;
+            vkCmdCopyBuffer(context_impl->vk_command_buffer, buffer_impl->vk_buffer, staging_buffer.vk_buffer, 1,
+                            &buffer_copy);
 
-        read_buffer(context, staging_buffer, data, size);
+            staging_readback_barrier(*context_impl);
+            flush(context);
+            std::memcpy(dst + copied, staging_buffer.mapped + staging_offset, chunk_size);
 
-        context_impl->transient_resources.push_back(staging_buffer);
+            copied += chunk_size;
+        }
     }
 }
 
 void Device::copy_buffer(ContextHandle context, BufferHandle src, BufferHandle dst, size_t size, size_t src_offset,
                          size_t dst_offset)
 {
+    if (m_cpu)
+        return m_cpu->copy_buffer(context, src, dst, size, src_offset, dst_offset);
     ContextImpl *context_impl = m_impl->contexts[context];
     BufferImpl *src_impl = m_impl->buffers[src];
     BufferImpl *dst_impl = m_impl->buffers[dst];
@@ -1081,6 +2756,7 @@ void Device::copy_buffer(ContextHandle context, BufferHandle src, BufferHandle d
 
     transition_state(*m_impl, *context_impl, *src_impl, ResourceState::TransferSrc);
     transition_state(*m_impl, *context_impl, *dst_impl, ResourceState::TransferDst);
+    flush_barriers(*context_impl);
 
     VkBufferCopy buffer_copy{};
     buffer_copy.srcOffset = src_offset;
@@ -1090,86 +2766,260 @@ void Device::copy_buffer(ContextHandle context, BufferHandle src, BufferHandle d
     vkCmdCopyBuffer(context_impl->vk_command_buffer, src_impl->vk_buffer, dst_impl->vk_buffer, 1, &buffer_copy);
 }
 
+/// Single subresource addressed by a region.
+inline ImageSubresourceRange region_subresource(const ImageRegion &region)
+{
+    return {
+        .base_mip_level = region.mip_level,
+        .mip_level_count = 1,
+        .base_array_layer = region.array_layer,
+        .array_layer_count = 1,
+    };
+}
+
+/// Size in bytes of a tightly packed row of texel blocks of a region.
+inline size_t region_row_size(const ImageImpl &image, const ImageRegion &region)
+{
+    const ImageFormatInfo &info = IMAGE_FORMAT_INFO_MAP[static_cast<size_t>(image.desc.format)];
+    return size_t((region.width + info.block_extent - 1) / info.block_extent) * info.block_size;
+}
+
+/// Number of rows of texel blocks of a region.
+inline uint32_t region_row_count(const ImageImpl &image, const ImageRegion &region)
+{
+    const ImageFormatInfo &info = IMAGE_FORMAT_INFO_MAP[static_cast<size_t>(image.desc.format)];
+    return (region.height + info.block_extent - 1) / info.block_extent;
+}
+
+/**
+ * Copy of rows of texel blocks of a region.
+ * @param row_pitch Bytes between rows in the buffer, 0 for tightly packed rows.
+ */
+inline VkBufferImageCopy image_rows_copy(const ImageImpl &image, const ImageRegion &region, size_t buffer_offset,
+                                         size_t row_pitch, uint32_t first_row, uint32_t row_count)
+{
+    const ImageFormatInfo &info = IMAGE_FORMAT_INFO_MAP[static_cast<size_t>(image.desc.format)];
+    const uint32_t y = first_row * info.block_extent;
+    FR_ASSERT(row_pitch % info.block_size == 0);
+
+    VkBufferImageCopy copy{};
+    copy.bufferOffset = buffer_offset;
+    copy.bufferRowLength = uint32_t(row_pitch / info.block_size * info.block_extent);
+    copy.bufferImageHeight = 0;
+    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.imageSubresource.mipLevel = region.mip_level;
+    copy.imageSubresource.baseArrayLayer = region.array_layer;
+    copy.imageSubresource.layerCount = 1;
+    copy.imageOffset = {int32_t(region.x), int32_t(region.y + y), 0};
+    copy.imageExtent = {region.width, std::min(row_count * info.block_extent, region.height - y), 1};
+    return copy;
+}
+
 void Device::write_image(ContextHandle context, ImageHandle image, const void *data, size_t size)
 {
+    if (m_cpu)
+        return m_cpu->write_image(context, image, {}, data, 0);
+    ImageImpl *image_impl = m_impl->images[image];
+    if (!image_impl || size == 0)
+        return;
+
+    const ImageRegion full = resolve_region(image_impl->desc, {});
+    FR_ASSERT(size >= region_row_size(*image_impl, full) * region_row_count(*image_impl, full));
+    write_image(context, image, full, data);
+}
+
+void Device::write_image(ContextHandle context, ImageHandle image, const ImageRegion &region, const void *data,
+                         size_t row_pitch)
+{
+    if (m_cpu)
+        return m_cpu->write_image(context, image, region, data, row_pitch);
     ContextImpl *context_impl = m_impl->contexts[context];
     ImageImpl *image_impl = m_impl->images[image];
-    if (!context_impl || !image_impl || size == 0)
+    if (!context_impl || !image_impl)
         return;
 
     FR_ASSERT(data);
 
-    if (image_impl->desc.memory == MemoryType::Host) {
-        void *buffer_data;
-        VK_CHECK(vkMapMemory(m_impl->vk_device, image_impl->vk_device_memory, 0, size, 0, &buffer_data));
-        std::memcpy(buffer_data, data, size);
-        vkUnmapMemory(m_impl->vk_device, image_impl->vk_device_memory);
-    } else if (image_impl->desc.memory == MemoryType::Device) {
-        // create staging image
-        ImageHandle staging_image = create_image({
-            .width = image_impl->desc.width,
-            .height = image_impl->desc.height,
-            .format = image_impl->desc.format,
-            .usage = ResourceUsage::TransferSrc,
-            .memory = MemoryType::Host,
-        });
+    const ImageRegion resolved = resolve_region(image_impl->desc, region);
+    const ImageFormatInfo &info = IMAGE_FORMAT_INFO_MAP[static_cast<size_t>(image_impl->desc.format)];
+    const size_t row_size = region_row_size(*image_impl, resolved);
+    const uint32_t row_count = region_row_count(*image_impl, resolved);
+    if (row_pitch == 0)
+        row_pitch = row_size;
+    FR_ASSERT(row_pitch >= row_size);
+    const uint8_t *src = static_cast<const uint8_t *>(data);
+
+    if (image_impl->desc.memory != MemoryType::Device) {
+        // linear image, write the rows through the mapping
+        const VkSubresourceLayout &layout = image_impl->linear_layout;
+        const size_t offset = layout.offset + (resolved.y / info.block_extent) * layout.rowPitch +
+                              (resolved.x / info.block_extent) * info.block_size;
+        copy_rows(image_impl->allocation.mapped + offset, layout.rowPitch, src, row_pitch, row_size, row_count);
+        flush_memory(*m_impl, image_impl->allocation, offset, (row_count - 1) * layout.rowPitch + row_size);
+        return;
+    }
 
-        // TODO make stable pointer pools (pointer might be invalid after creating staging resource)
-        image_impl = m_impl->images[image];
+    StagingBuffer &staging_buffer = context_impl->staging_buffer;
+    const size_t alignment = std::lcm(size_t(info.block_size), size_t(16));
+    FR_ASSERT(row_size <= m_impl->desc.staging_buffer_size);
 
-        write_image(context, staging_image, data, size);
+    transition_state(*m_impl, *context_impl, *image_impl, ResourceState::TransferDst, region_subresource(resolved));
 
-        submit(context);
-        wait(context);
-        begin(context);
+    // copy in chunks of rows packed tightly in the staging buffer, flushing whenever it is exhausted
+    uint32_t row = 0;
+    while (row < row_count) {
+        uint32_t rows = uint32_t(
+            std::min(size_t(row_count - row), staging_available(*m_impl, staging_buffer, alignment) / row_size));
+        if (rows == 0) {
+            flush(context);
+            continue;
+        }
+        size_t staging_offset = staging_allocate(staging_buffer, rows * row_size, alignment);
+        copy_rows(staging_buffer.mapped + staging_offset, row_size, src + row * row_pitch, row_pitch, row_size, rows);
 
-        copy_image(context, staging_image, image, image_impl->desc.width, image_impl->desc.height);
+        flush_barriers(*context_impl);
+        VkBufferImageCopy copy = image_rows_copy(*image_impl, resolved, staging_offset, row_size, row, rows);
+        vkCmdCopyBufferToImage(context_impl->vk_command_buffer, staging_buffer.vk_buffer, image_impl->vk_image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
 
-        context_impl->transient_resources.push_back(staging_image);
+        row += rows;
     }
 }
 
 void Device::read_image(ContextHandle context, ImageHandle image, void *data, size_t size)
 {
+    if (m_cpu)
+        return m_cpu->read_image(context, image, {}, data, 0);
+    ImageImpl *image_impl = m_impl->images[image];
+    if (!image_impl || size == 0)
+        return;
+
+    const ImageRegion full = resolve_region(image_impl->desc, {});
+    FR_ASSERT(size >= region_row_size(*image_impl, full) * region_row_count(*image_impl, full));
+    read_image(context, image, full, data);
+}
+
+void Device::read_image(ContextHandle context, ImageHandle image, const ImageRegion &region, void *data,
+                        size_t row_pitch)
+{
+    if (m_cpu)
+        return m_cpu->read_image(context, image, region, data, row_pitch);
     ContextImpl *context_impl = m_impl->contexts[context];
     ImageImpl *image_impl = m_impl->images[image];
-    if (!context_impl || !image_impl || size == 0)
+    if (!context_impl || !image_impl)
         return;
 
     FR_ASSERT(data);
 
-    if (image_impl->desc.memory == MemoryType::Host) {
-        void *buffer_data;
-        VK_CHECK(vkMapMemory(m_impl->vk_device, image_impl->vk_device_memory, 0, size, 0, &buffer_data));
-        std::memcpy(data, buffer_data, size);
-        vkUnmapMemory(m_impl->vk_device, image_impl->vk_device_memory);
-    } else if (image_impl->desc.memory == MemoryType::Device) {
-        // create staging image
-        ImageHandle staging_image = create_image({
-            .width = image_impl->desc.width,
-            .height = image_impl->desc.height,
-            .format = image_impl->desc.format,
-            .usage = ResourceUsage::TransferDst,
-            .memory = MemoryType::Host,
-        });
+    const ImageRegion resolved = resolve_region(image_impl->desc, region);
+    const ImageFormatInfo &info = IMAGE_FORMAT_INFO_MAP[static_cast<size_t>(image_impl->desc.format)];
+    const size_t row_size = region_row_size(*image_impl, resolved);
+    const uint32_t row_count = region_row_count(*image_impl, resolved);
+    if (row_pitch == 0)
+        row_pitch = row_size;
+    FR_ASSERT(row_pitch >= row_size);
+    uint8_t *dst = static_cast<uint8_t *>(data);
+
+    if (image_impl->desc.memory != MemoryType::Device) {
+        // linear image, read the rows through the mapping
+        const VkSubresourceLayout &layout = image_impl->linear_layout;
+        const size_t offset = layout.offset + (resolved.y / info.block_extent) * layout.rowPitch +
+                              (resolved.x / info.block_extent) * info.block_size;
+        invalidate_memory(*m_impl, image_impl->allocation, offset, (row_count - 1) * layout.rowPitch + row_size);
+        copy_rows(dst, row_pitch, image_impl->allocation.mapped + offset, layout.rowPitch, row_size, row_count);
+        return;
+    }
 
-        // TODO make stable pointer pools (pointer might be invalid after creating staging resource)
-        image_impl = m_impl->images[image];
+    StagingBuffer &staging_buffer = context_impl->staging_buffer;
+    const size_t alignment = std::lcm(size_t(info.block_size), size_t(16));
+    FR_ASSERT(row_size <= m_impl->desc.staging_buffer_size);
 
-        copy_image(context, image, staging_image, image_impl->desc.width, image_impl->desc.height);
+    transition_state(*m_impl, *context_impl, *image_impl, ResourceState::TransferSrc, region_subresource(resolved));
 
-        submit(context);
-        wait(context);
-        begin(context);
+    // copy in chunks of rows, the data is only available on the host after the commands completed
+    uint32_t row = 0;
+    while (row < row_count) {
+        uint32_t rows = uint32_t(
+            std::min(size_t(row_count - row), staging_available(*m_impl, staging_buffer, alignment) / row_size));
+        if (rows == 0) {
+            flush(context);
+            continue;
+        }
+        size_t staging_offset = staging_allocate(staging_buffer, rows * row_size, alignment);
+
+        flush_barriers(*context_impl);
+        VkBufferImageCopy copy = image_rows_copy(*image_impl, resolved, staging_offset, row_size, row, rows);
+        vkCmdCopyImageToBuffer(context_impl->vk_command_buffer, image_impl->vk_image,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, staging_buffer.vk_buffer, 1, &copy);
 
-        read_image(context, staging_image, data, size);
+        staging_readback_barrier(*context_impl);
+        flush(context);
+        copy_rows(dst + row * row_pitch, row_pitch, staging_buffer.mapped + staging_offset, row_size, row_size, rows);
 
-        context_impl->transient_resources.push_back(staging_image);
+        row += rows;
     }
 }
 
+void Device::copy_buffer_to_image(ContextHandle context, BufferHandle src, ImageHandle dst, const ImageRegion &region,
+                                  size_t src_offset, size_t src_row_pitch)
+{
+    if (m_cpu)
+        return m_cpu->copy_buffer_to_image(context, src, dst, region, src_offset, src_row_pitch);
+    ContextImpl *context_impl = m_impl->contexts[context];
+    BufferImpl *src_impl = m_impl->buffers[src];
+    ImageImpl *dst_impl = m_impl->images[dst];
+    if (!context_impl || !src_impl || !dst_impl)
+        return;
+
+    const ImageRegion resolved = resolve_region(dst_impl->desc, region);
+    const size_t row_size = region_row_size(*dst_impl, resolved);
+    const uint32_t row_count = region_row_count(*dst_impl, resolved);
+    if (src_row_pitch == 0)
+        src_row_pitch = row_size;
+    FR_ASSERT(src_row_pitch >= row_size);
+    FR_ASSERT(src_offset + (row_count - 1) * src_row_pitch + row_size <= src_impl->desc.size);
+
+    transition_state(*m_impl, *context_impl, *src_impl, ResourceState::TransferSrc);
+    transition_state(*m_impl, *context_impl, *dst_impl, ResourceState::TransferDst, region_subresource(resolved));
+    flush_barriers(*context_impl);
+
+    VkBufferImageCopy copy = image_rows_copy(*dst_impl, resolved, src_offset, src_row_pitch, 0, row_count);
+    vkCmdCopyBufferToImage(context_impl->vk_command_buffer, src_impl->vk_buffer, dst_impl->vk_image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+}
+
+void Device::copy_image_to_buffer(ContextHandle context, ImageHandle src, BufferHandle dst, const ImageRegion &region,
+                                  size_t dst_offset, size_t dst_row_pitch)
+{
+    if (m_cpu)
+        return m_cpu->copy_image_to_buffer(context, src, dst, region, dst_offset, dst_row_pitch);
+    ContextImpl *context_impl = m_impl->contexts[context];
+    ImageImpl *src_impl = m_impl->images[src];
+    BufferImpl *dst_impl = m_impl->buffers[dst];
+    if (!context_impl || !src_impl || !dst_impl)
+        return;
+
+    const ImageRegion resolved = resolve_region(src_impl->desc, region);
+    const size_t row_size = region_row_size(*src_impl, resolved);
+    const uint32_t row_count = region_row_count(*src_impl, resolved);
+    if (dst_row_pitch == 0)
+        dst_row_pitch = row_size;
+    FR_ASSERT(dst_row_pitch >= row_size);
+    FR_ASSERT(dst_offset + (row_count - 1) * dst_row_pitch + row_size <= dst_impl->desc.size);
+
+    transition_state(*m_impl, *context_impl, *src_impl, ResourceState::TransferSrc, region_subresource(resolved));
+    transition_state(*m_impl, *context_impl, *dst_impl, ResourceState::TransferDst);
+    flush_barriers(*context_impl);
+
+    VkBufferImageCopy copy = image_rows_copy(*src_impl, resolved, dst_offset, dst_row_pitch, 0, row_count);
+    vkCmdCopyImageToBuffer(context_impl->vk_command_buffer, src_impl->vk_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           dst_impl->vk_buffer, 1, &copy);
+}
+
 void Device::copy_image(ContextHandle context, ImageHandle src, ImageHandle dst, uint32_t width, uint32_t height)
 {
+    if (m_cpu)
+        return m_cpu->copy_image(context, src, dst, width, height);
     ContextImpl *context_impl = m_impl->contexts[context];
     ImageImpl *src_impl = m_impl->images[src];
     ImageImpl *dst_impl = m_impl->images[dst];
@@ -1177,8 +3027,10 @@ void Device::copy_image(ContextHandle context, ImageHandle src, ImageHandle dst,
     if (!context_impl || !src_impl || !dst_impl || width == 0 || height == 0)
         return;
 
-    transition_state(*m_impl, *context_impl, *src_impl, ResourceState::TransferSrc);
-    transition_state(*m_impl, *context_impl, *dst_impl, ResourceState::TransferDst);
+    const ImageSubresourceRange first_subresource{.mip_level_count = 1, .array_layer_count = 1};
+    transition_state(*m_impl, *context_impl, *src_impl, ResourceState::TransferSrc, first_subresource);
+    transition_state(*m_impl, *context_impl, *dst_impl, ResourceState::TransferDst, first_subresource);
+    flush_barriers(*context_impl);
 
     VkImageCopy image_copy{};
     image_copy.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1193,72 +3045,383 @@ void Device::copy_image(ContextHandle context, ImageHandle src, ImageHandle dst,
                    dst_impl->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &image_copy);
 }
 
-void Device::dispatch(ContextHandle context, DispatchDesc desc)
+void Device::generate_mips(ContextHandle context, ImageHandle image)
 {
+    if (m_cpu)
+        return m_cpu->generate_mips(context, image);
     ContextImpl *context_impl = m_impl->contexts[context];
-    PipelineImpl *pipeline_impl = m_impl->pipelines[desc.pipeline];
-    if (!context_impl || !pipeline_impl)
+    ImageImpl *image_impl = m_impl->images[image];
+    if (!context_impl || !image_impl || image_impl->desc.mip_levels == 1)
         return;
 
-    FR_ASSERT(desc.group_count[0] > 0 && desc.group_count[1] > 0 && desc.group_count[2] > 0);
+    // blits are only supported on graphics queues
+    FR_ASSERT(m_impl->queues[static_cast<size_t>(context_impl->queue)].flags & VK_QUEUE_GRAPHICS_BIT);
+
+    const VkFormat format = IMAGE_FORMAT_MAP[static_cast<size_t>(image_impl->desc.format)];
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(m_impl->vk_physical_device, format, &format_properties);
+    FR_ASSERT(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
+    FR_ASSERT(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+    const VkFilter filter = format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+                                ? VK_FILTER_LINEAR
+                                : VK_FILTER_NEAREST;
+
+    const ImageDesc &desc = image_impl->desc;
+    for (uint32_t level = 1; level < desc.mip_levels; ++level) {
+        transition_state(*m_impl, *context_impl, *image_impl, ResourceState::TransferSrc,
+                         {.base_mip_level = level - 1, .mip_level_count = 1});
+        transition_state(*m_impl, *context_impl, *image_impl, ResourceState::TransferDst,
+                         {.base_mip_level = level, .mip_level_count = 1});
+        flush_barriers(*context_impl);
+
+        VkImageBlit blit{};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = desc.array_layers;
+        blit.srcOffsets[1] = {int32_t(std::max(desc.width >> (level - 1), 1u)),
+                              int32_t(std::max(desc.height >> (level - 1), 1u)), 1};
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = desc.array_layers;
+        blit.dstOffsets[1] = {int32_t(std::max(desc.width >> level, 1u)), int32_t(std::max(desc.height >> level, 1u)),
+                              1};
+        vkCmdBlitImage(context_impl->vk_command_buffer, image_impl->vk_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       image_impl->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, filter);
+    }
+}
+
+/// State in which a binding accesses its resource.
+inline ResourceState get_binding_state(DescriptorType type, bool image)
+{
+    switch (type) {
+        case DescriptorType::ConstantBuffer:
+            FR_ASSERT(!image);
+            return ResourceState::ConstantBuffer;
+        case DescriptorType::StructuredBuffer:
+        case DescriptorType::Buffer:
+            FR_ASSERT(!image);
+            return ResourceState::ShaderResource;
+        case DescriptorType::RWStructuredBuffer:
+        case DescriptorType::RWBuffer:
+            FR_ASSERT(!image);
+            return ResourceState::UnorderedAccess;
+        case DescriptorType::Texture:
+            FR_ASSERT(image);
+            return ResourceState::ShaderResource;
+        case DescriptorType::RWTexture:
+            FR_ASSERT(image);
+            return ResourceState::UnorderedAccess;
+        default:
+            FR_ASSERT(false);
+            return ResourceState::Undefined;
+    }
+}
+
+/// Queue the transitions of the resources accessed by a dispatch, recorded by the next flush_barriers().
+/// Call func(image, subresource, state) for the bindless images declared by a dispatch, bindless_mutex must be held.
+template <typename Func>
+inline void for_each_bindless_image(DeviceImpl &device, const DispatchDesc &desc, Func &&func)
+{
+    const std::span<const uint32_t> indices[] = {desc.bindless_textures, desc.bindless_rw_textures};
+    const ResourceState states[] = {ResourceState::ShaderResource, ResourceState::UnorderedAccess};
+    for (uint32_t binding : {BINDLESS_TEXTURE_BINDING, BINDLESS_RW_TEXTURE_BINDING}) {
+        const auto &slots = device.bindless_arrays[binding].slots;
+        for (uint32_t index : indices[binding]) {
+            FR_ASSERT(index < slots.size());
+            ImageImpl *image_impl = device.images[slots[index].image];
+            FR_ASSERT(image_impl);
+            func(*image_impl, slots[index].subresource, states[binding]);
+        }
+    }
+}
 
-    // transition resource state
-    FR_ASSERT(desc.binding_set.size() == pipeline_impl->desc.binding_layout.size());
+inline void transition_dispatch(DeviceImpl &device, ContextImpl &context, const PipelineImpl &pipeline,
+                                const DispatchDesc &desc)
+{
+    FR_ASSERT(desc.binding_set.size() == pipeline.desc.binding_layout.size());
     for (size_t i = 0; i < desc.binding_set.size(); ++i) {
         const auto &set_item = desc.binding_set[i];
-        const auto &layout_item = pipeline_impl->desc.binding_layout[i];
+        const auto &layout_item = pipeline.desc.binding_layout[i];
 
         FR_ASSERT(set_item.binding == layout_item.binding);
 
         if (auto buffer = std::get_if<BufferHandle>(&set_item.resource)) {
-            BufferImpl *buffer_impl = m_impl->buffers[*buffer];
+            BufferImpl *buffer_impl = device.buffers[*buffer];
             FR_ASSERT(buffer_impl);
-
-            switch (layout_item.type) {
-                case DescriptorType::ConstantBuffer:
-                    transition_state(*m_impl, *context_impl, *buffer_impl, ResourceState::ConstantBuffer);
-                    break;
-                case DescriptorType::StructuredBuffer:
-                case DescriptorType::Buffer:
-                    transition_state(*m_impl, *context_impl, *buffer_impl, ResourceState::ShaderResource);
-                    break;
-                case DescriptorType::RWStructuredBuffer:
-                case DescriptorType::RWBuffer:
-                    transition_state(*m_impl, *context_impl, *buffer_impl, ResourceState::UnorderedAccess);
-                    break;
-                default:
-                    FR_ASSERT(false);
-            }
+            transition_state(device, context, *buffer_impl, get_binding_state(layout_item.type, false));
         } else if (auto image = std::get_if<ImageHandle>(&set_item.resource)) {
-            ImageImpl *image_impl = m_impl->images[*image];
+            ImageImpl *image_impl = device.images[*image];
             FR_ASSERT(image_impl);
+            const ImageSubresourceRange range = get_binding_subresource(*image_impl, set_item, layout_item);
+            transition_state(device, context, *image_impl, get_binding_state(layout_item.type, true), range);
+        } else if (auto sampler = std::get_if<SamplerHandle>(&set_item.resource)) {
+            SamplerImpl *sampler_impl = device.samplers[*sampler];
+            FR_ASSERT(sampler_impl);
+            mark_used(sampler_impl->uses, context);
+        }
+    }
 
-            switch (layout_item.type) {
-                case DescriptorType::Texture:
-                    transition_state(*m_impl, *context_impl, *image_impl, ResourceState::ShaderResource);
-                    break;
-                case DescriptorType::RWTexture:
-                    transition_state(*m_impl, *context_impl, *image_impl, ResourceState::UnorderedAccess);
-                    break;
-                default:
-                    FR_ASSERT(false);
-            }
+    if (!desc.indirect_buffer.is_null()) {
+        BufferImpl *indirect_impl = device.buffers[desc.indirect_buffer];
+        FR_ASSERT(indirect_impl);
+        FR_ASSERT(desc.indirect_offset % 4 == 0);
+        FR_ASSERT(desc.indirect_offset + sizeof(VkDispatchIndirectCommand) <= indirect_impl->desc.size);
+        transition_state(device, context, *indirect_impl, ResourceState::IndirectArgument);
+    }
+
+    // only the bindless images the dispatch declares, not the whole arrays
+    FR_ASSERT(pipeline.desc.bindless || (desc.bindless_textures.empty() && desc.bindless_rw_textures.empty()));
+    if (!desc.bindless_textures.empty() || !desc.bindless_rw_textures.empty()) {
+        std::lock_guard<std::mutex> lock(device.bindless_mutex);
+        for_each_bindless_image(device, desc, [&](ImageImpl &image_impl, const ImageSubresourceRange &range,
+                                                  ResourceState state) {
+            transition_state(device, context, image_impl, state, range);
+        });
+    }
+}
+
+/// True if all subresources of an image range are in a state.
+inline bool has_state(const ImageImpl &image_impl, const ImageSubresourceRange &range, ResourceState state)
+{
+    for (uint32_t level = range.base_mip_level; level < range.base_mip_level + range.mip_level_count; ++level) {
+        for (uint32_t layer = range.base_array_layer; layer < range.base_array_layer + range.array_layer_count;
+             ++layer) {
+            if (image_impl.states[level * image_impl.desc.array_layers + layer] != state)
+                return false;
+        }
+    }
+    return true;
+}
+
+/// True if the resources bound by a dispatch are in the states it accesses them in.
+inline bool is_dispatch_ready(DeviceImpl &device, const PipelineImpl &pipeline, const DispatchDesc &desc)
+{
+    for (size_t i = 0; i < desc.binding_set.size(); ++i) {
+        const auto &set_item = desc.binding_set[i];
+        const auto &layout_item = pipeline.desc.binding_layout[i];
+
+        if (auto buffer = std::get_if<BufferHandle>(&set_item.resource)) {
+            if (device.buffers[*buffer]->state != get_binding_state(layout_item.type, false))
+                return false;
+        } else if (auto image = std::get_if<ImageHandle>(&set_item.resource)) {
+            const ImageImpl &image_impl = *device.images[*image];
+            const ImageSubresourceRange range = get_binding_subresource(image_impl, set_item, layout_item);
+            if (!has_state(image_impl, range, get_binding_state(layout_item.type, true)))
+                return false;
         }
     }
 
-    VkDescriptorSet vk_descriptor_set = create_descriptor_set(*m_impl, *context_impl, *pipeline_impl, desc.binding_set);
+    bool ready = true;
+    if (!desc.bindless_textures.empty() || !desc.bindless_rw_textures.empty()) {
+        std::lock_guard<std::mutex> lock(device.bindless_mutex);
+        for_each_bindless_image(
+            device, desc, [&](ImageImpl &image_impl, const ImageSubresourceRange &range, ResourceState state) {
+                ready = ready && has_state(image_impl, range, state);
+            });
+    }
+    return ready && (desc.indirect_buffer.is_null() ||
+                     device.buffers[desc.indirect_buffer]->state == ResourceState::IndirectArgument);
+}
 
-    vkCmdBindPipeline(context_impl->vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_impl->vk_pipeline);
-    vkCmdBindDescriptorSets(context_impl->vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
-                            pipeline_impl->vk_pipeline_layout, 0, 1, &vk_descriptor_set, 0, nullptr);
+/// Record a dispatch whose resources have been transitioned, binding the pipeline and descriptor sets if they
+/// differ from the ones bound by the previous dispatch.
+inline void record_dispatch(DeviceImpl &device, ContextImpl &context, const PipelineImpl &pipeline,
+                            VkDescriptorSet vk_descriptor_set, const DispatchDesc &desc)
+{
+    // descriptor sets bound for another pipeline layout are not compatible, rebind them with the pipeline
+    const bool pipeline_changed = context.bound_pipeline != pipeline.vk_pipeline;
+    if (pipeline_changed) {
+        vkCmdBindPipeline(context.vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.vk_pipeline);
+        context.bound_pipeline = pipeline.vk_pipeline;
+    }
+    if (pipeline_changed || context.bound_descriptor_set != vk_descriptor_set) {
+        VkDescriptorSet vk_descriptor_sets[] = {vk_descriptor_set, device.vk_bindless_set};
+        vkCmdBindDescriptorSets(context.vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                pipeline.vk_pipeline_layout, 0, pipeline.desc.bindless ? 2 : 1, vk_descriptor_sets,
+                                0, nullptr);
+        context.bound_descriptor_set = vk_descriptor_set;
+    }
 
     if (desc.push_constants_size > 0) {
         FR_ASSERT(desc.push_constants);
-        vkCmdPushConstants(context_impl->vk_command_buffer, pipeline_impl->vk_pipeline_layout,
-                           VK_SHADER_STAGE_COMPUTE_BIT, 0, desc.push_constants_size, desc.push_constants);
+        vkCmdPushConstants(context.vk_command_buffer, pipeline.vk_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           desc.push_constants_size, desc.push_constants);
+    }
+
+    if (!desc.indirect_buffer.is_null()) {
+        vkCmdDispatchIndirect(context.vk_command_buffer, device.buffers[desc.indirect_buffer]->vk_buffer,
+                              desc.indirect_offset);
+    } else {
+        FR_ASSERT(desc.group_count[0] > 0 && desc.group_count[1] > 0 && desc.group_count[2] > 0);
+        vkCmdDispatch(context.vk_command_buffer, desc.group_count[0], desc.group_count[1], desc.group_count[2]);
+    }
+}
+
+void Device::dispatch(ContextHandle context, const DispatchDesc &desc)
+{
+    if (m_cpu)
+        return m_cpu->dispatch(context, desc);
+    ContextImpl *context_impl = m_impl->contexts[context];
+    PipelineImpl *pipeline_impl = m_impl->pipelines[desc.pipeline];
+    if (!context_impl || !pipeline_impl)
+        return;
+
+    FR_ASSERT(m_impl->queues[static_cast<size_t>(context_impl->queue)].supported_stages &
+              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    transition_dispatch(*m_impl, *context_impl, *pipeline_impl, desc);
+    flush_barriers(*context_impl);
+
+    VkDescriptorSet vk_descriptor_set =
+        get_descriptor_set(*m_impl, *context_impl, desc.pipeline, *pipeline_impl, desc.binding_set);
+    record_dispatch(*m_impl, *context_impl, *pipeline_impl, vk_descriptor_set, desc);
+}
+
+void Device::dispatch_batch(ContextHandle context, std::span<const DispatchDesc> descs)
+{
+    if (m_cpu)
+        return m_cpu->dispatch_batch(context, descs);
+    ContextImpl *context_impl = m_impl->contexts[context];
+    if (!context_impl || descs.empty())
+        return;
+
+    FR_ASSERT(m_impl->queues[static_cast<size_t>(context_impl->queue)].supported_stages &
+              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    struct BatchItem {
+        const PipelineImpl *pipeline;
+        VkDescriptorSet vk_descriptor_set;
+        uint32_t index;
+    };
+    BatchItem *items = context_impl->scratch.allocate<BatchItem>(descs.size());
+    uint32_t item_count = 0;
+
+    // a single barrier for the whole batch
+    for (uint32_t i = 0; i < descs.size(); ++i) {
+        if (PipelineImpl *pipeline_impl = m_impl->pipelines[descs[i].pipeline]) {
+            transition_dispatch(*m_impl, *context_impl, *pipeline_impl, descs[i]);
+            items[item_count++] = {pipeline_impl, VK_NULL_HANDLE, i};
+        }
+    }
+    flush_barriers(*context_impl);
+
+    for (BatchItem &item : std::span(items, item_count)) {
+        const DispatchDesc &desc = descs[item.index];
+        FR_ASSERT(is_dispatch_ready(*m_impl, *item.pipeline, desc));
+        item.vk_descriptor_set =
+            get_descriptor_set(*m_impl, *context_impl, desc.pipeline, *item.pipeline, desc.binding_set);
+    }
+
+    // group dispatches sharing a pipeline and descriptor set, in submission order within a group
+    std::sort(items, items + item_count, [](const BatchItem &a, const BatchItem &b) {
+        if (a.pipeline->vk_pipeline != b.pipeline->vk_pipeline)
+            return a.pipeline->vk_pipeline < b.pipeline->vk_pipeline;
+        if (a.vk_descriptor_set != b.vk_descriptor_set)
+            return a.vk_descriptor_set < b.vk_descriptor_set;
+        return a.index < b.index;
+    });
+
+    for (const BatchItem &item : std::span(items, item_count))
+        record_dispatch(*m_impl, *context_impl, *item.pipeline, item.vk_descriptor_set, descs[item.index]);
+}
+
+void Device::begin_scope(ContextHandle context, std::string name)
+{
+    if (m_cpu)
+        return m_cpu->begin_scope(context, std::move(name));
+    ContextImpl *context_impl = m_impl->contexts[context];
+    if (!context_impl || context_impl->vk_query_pool == VK_NULL_HANDLE)
+        return;
+
+    FR_ASSERT(context_impl->is_recording);
+
+    // keep a query for the end of every open scope, scopes that don't fit are dropped
+    TimestampScope scope{
+        .name = std::move(name),
+        .depth = static_cast<uint32_t>(context_impl->open_scopes.size()),
+        .begin_query = NO_QUERY,
+        .end_query = NO_QUERY,
+    };
+    if (context_impl->query_count + context_impl->open_scopes.size() + 2 <= context_impl->query_capacity) {
+        scope.begin_query = context_impl->query_count++;
+        vkCmdWriteTimestamp(context_impl->vk_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            context_impl->vk_query_pool, scope.begin_query);
+    }
+
+    context_impl->open_scopes.push_back(context_impl->timestamp_scopes.size());
+    context_impl->timestamp_scopes.push_back(std::move(scope));
+}
+
+void Device::end_scope(ContextHandle context)
+{
+    if (m_cpu)
+        return m_cpu->end_scope(context);
+    ContextImpl *context_impl = m_impl->contexts[context];
+    if (!context_impl || context_impl->vk_query_pool == VK_NULL_HANDLE)
+        return;
+
+    FR_ASSERT(context_impl->is_recording);
+    FR_ASSERT(!context_impl->open_scopes.empty());
+
+    TimestampScope &scope = context_impl->timestamp_scopes[context_impl->open_scopes.back()];
+    context_impl->open_scopes.pop_back();
+    scope.closed = true;
+    if (scope.begin_query == NO_QUERY && !scope.begin_ticks)
+        return;  // dropped
+
+    scope.end_query = context_impl->query_count++;
+    vkCmdWriteTimestamp(context_impl->vk_command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        context_impl->vk_query_pool, scope.end_query);
+}
+
+std::vector<GpuTiming> Device::take_timings(ContextHandle context)
+{
+    if (m_cpu)
+        return m_cpu->take_timings(context);
+    ContextImpl *context_impl = m_impl->contexts[context];
+    if (!context_impl)
+        return {};
+
+    return std::exchange(context_impl->timings, {});
+}
+
+uint32_t Device::max_workgroup_invocations() const
+{
+    if (m_cpu)
+        return m_cpu->max_workgroup_invocations();
+    return m_impl->vk_properties.limits.maxComputeWorkGroupInvocations;
+}
+
+MemoryStats Device::memory_stats() const
+{
+    if (m_cpu)
+        return m_cpu->memory_stats();
+    MemoryStats stats;
+    size_t free_bytes = 0;
+    size_t largest_free_block = 0;
+
+    std::lock_guard<std::mutex> lock(m_impl->memory_mutex);
+
+    for (const auto &pool : m_impl->memory_pools) {
+        for (const auto &block : pool->blocks) {
+            stats.block_count++;
+            stats.resource_count += uint32_t(block->allocator.allocation_count());
+            stats.allocated_bytes += block->allocator.size();
+            stats.used_bytes += block->allocator.used_bytes();
+            free_bytes += block->allocator.free_bytes();
+            largest_free_block = std::max(largest_free_block, block->allocator.largest_free_block());
+        }
     }
 
-    vkCmdDispatch(context_impl->vk_command_buffer, desc.group_count[0], desc.group_count[1], desc.group_count[2]);
+    stats.allocation_count = stats.block_count + m_impl->dedicated_allocation_count;
+    stats.resource_count += m_impl->dedicated_allocation_count;
+    stats.allocated_bytes += m_impl->dedicated_allocation_bytes;
+    stats.used_bytes += m_impl->dedicated_allocation_bytes;
+    stats.fragmentation = free_bytes > 0 ? 1.f - float(largest_free_block) / float(free_bytes) : 0.f;
+
+    return stats;
 }
 
 FR_NAMESPACE_END
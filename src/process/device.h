@@ -2,8 +2,16 @@
 
 #include "core/defs.h"
 #include "core/pool.h"
+#include "core/small_vector.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <filesystem>
 #include <memory>
+#include <span>
+#include <string>
 #include <variant>
 #include <vector>
 
@@ -44,6 +52,8 @@ enum class ImageFormat : uint32_t {
     RGBA32Uint,
     RGBA32Int,
     RGBA32Float,
+
+    BC1Unorm,  ///< Block compressed RGB(A), 8 bytes per 4x4 block (see encode_bc1()).
 };
 
 enum class ResourceUsage : uint32_t {
@@ -53,6 +63,7 @@ enum class ResourceUsage : uint32_t {
     ShaderResource = (1 << 3),
     TransferDst = (1 << 4),
     TransferSrc = (1 << 5),
+    IndirectArgument = (1 << 6),  ///< Buffer holding the group counts of indirect dispatches.
 };
 FR_ENUM_FLAG_OPERATORS(ResourceUsage)
 
@@ -63,11 +74,13 @@ enum class ResourceState : uint32_t {
     ShaderResource,
     TransferDst,
     TransferSrc,
+    IndirectArgument,
 };
 
 enum class MemoryType : uint32_t {
-    Host,
+    Host,      ///< Host-visible and coherent, for uploads.
     Device,
+    Readback,  ///< Host-visible and cached, for reading results on the host. Can be non-coherent.
 };
 
 enum class DescriptorType : uint32_t {
@@ -102,7 +115,27 @@ enum class SamplerAddressMode : uint32_t {
     MirrorClampToEdge,
 };
 
+enum class QueueType : uint32_t {
+    Graphics,  ///< Supports all commands.
+    Compute,   ///< Asynchronous compute queue, falls back to the graphics queue.
+    Transfer,  ///< Dedicated copy queue, falls back to the compute or graphics queue. No dispatches.
+};
+
+/// Texel block layout of an image format.
+struct ImageFormatInfo {
+    uint32_t block_size;    ///< Size of a texel block in bytes.
+    uint32_t block_extent;  ///< Width and height of a texel block in pixels.
+};
+
+const ImageFormatInfo &get_image_format_info(ImageFormat format);
+
+enum class DeviceBackend : uint32_t {
+    Vulkan,  ///< GPU device.
+    Cpu,     ///< Host memory and C++ kernels (see register_cpu_kernel()), for machines without a GPU.
+};
+
 struct DeviceImpl;
+class CpuDevice;
 
 using ShaderHandle = Handle<struct ShaderTag>;
 using BufferHandle = Handle<struct BufferTag>;
@@ -114,7 +147,18 @@ using ContextHandle = Handle<struct ContextTag>;
 using ResourceHandle = std::variant<BufferHandle, ImageHandle, SamplerHandle>;
 
 struct DeviceDesc {
+    DeviceBackend backend{DeviceBackend::Vulkan};
     bool enable_validation_layers{false};
+    /// Size of the per-context staging buffer used by write/read_buffer and write/read_image.
+    size_t staging_buffer_size{32 * 1024 * 1024};
+    /// Size of the memory blocks buffers and images are sub-allocated from.
+    size_t memory_block_size{64 * 1024 * 1024};
+    /// File the pipeline cache is loaded from and saved to, empty to keep the cache in memory only.
+    std::filesystem::path pipeline_cache_path;
+    /// Capacity of each bindless image array, 0 to disable bindless mode (see Device::add_bindless_image()).
+    uint32_t bindless_image_count{0};
+    /// Number of worker threads of the CPU backend, 0 for one per hardware thread.
+    uint32_t cpu_thread_count{0};
 };
 
 struct ShaderDesc {
@@ -127,6 +171,8 @@ struct BufferDesc {
     size_t size = 0;
     ResourceUsage usage = ResourceUsage::Unknown;
     MemoryType memory = MemoryType::Device;
+    bool transient = false;  ///< Short-lived resource, allocated from separate memory pools.
+    ImageFormat format = ImageFormat::Unknown;  ///< Element format, required for Buffer/RWBuffer bindings.
 };
 
 struct ImageDesc {
@@ -135,6 +181,35 @@ struct ImageDesc {
     ImageFormat format = ImageFormat::Unknown;
     ResourceUsage usage = ResourceUsage::Unknown;
     MemoryType memory = MemoryType::Device;
+    bool transient = false;     ///< Short-lived resource, allocated from separate memory pools.
+    uint32_t mip_levels = 1;    ///< See mip_level_count() for a full chain. Device memory only.
+    uint32_t array_layers = 1;  ///< Array images are bound as Texture2DArray/RWTexture2DArray. Device memory only.
+};
+
+/// Number of mip levels of a full mip chain down to 1x1.
+inline uint32_t mip_level_count(uint32_t width, uint32_t height)
+{
+    return std::max(uint32_t(std::bit_width(std::max(width, height))), 1u);
+}
+
+/// Mip levels and array layers of an image, a zero count extends the range to the last level or layer.
+struct ImageSubresourceRange {
+    uint32_t base_mip_level{0};
+    uint32_t mip_level_count{0};
+    uint32_t base_array_layer{0};
+    uint32_t array_layer_count{0};
+
+    bool operator==(const ImageSubresourceRange &other) const = default;
+};
+
+/// Rectangle of an image in pixels, a zero width or height extends the region to the edge of the mip level.
+struct ImageRegion {
+    uint32_t x{0};
+    uint32_t y{0};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t mip_level{0};
+    uint32_t array_layer{0};
 };
 
 struct SamplerDesc {
@@ -157,14 +232,40 @@ using BindingLayout = std::vector<BindingLayoutItem>;
 struct BindingItem {
     uint32_t binding{0};
     ResourceHandle resource;
+    /// Bound part of an image, all levels and layers by default. RWTexture bindings use the base level only.
+    ImageSubresourceRange subresource{};
+
+    bool operator==(const BindingItem &other) const = default;
 };
 
-using BindingSet = std::vector<BindingItem>;
+/// Bindings of a dispatch, stored inline up to 8 bindings so building a DispatchDesc does not allocate.
+using BindingSet = SmallVector<BindingItem, 8>;
+
+/// Workgroup size of a compute shader (numthreads).
+using WorkgroupSize = std::array<uint32_t, 3>;
+
+/// Value of a shader specialization constant, declared in HLSL as [[vk::constant_id(id)]] const T name = default;
+struct SpecializationConstant {
+    uint32_t id{0};
+    uint32_t value{0};  ///< Bits of the 32-bit bool, int, uint or float value.
+
+    bool operator==(const SpecializationConstant &other) const = default;
+};
 
 struct PipelineDesc {
     ShaderHandle shader{ShaderHandle::null()};
     BindingLayout binding_layout;
     uint32_t push_constants_size = 0;
+    /// Bind the bindless image arrays as descriptor set 1, requires DeviceDesc::bindless_image_count > 0.
+    bool bindless = false;
+    /// Specialization constants of the shader, constants that are not listed keep their default value.
+    std::vector<SpecializationConstant> specialization_constants;
+    /**
+     * Workgroup size replacing the shader's numthreads, all zero to keep it. Must not exceed
+     * Device::max_workgroup_invocations() and the shader must derive its indices from SV_DispatchThreadID or
+     * SV_GroupThreadID rather than hard-coded sizes. Dispatch group counts have to be computed from it.
+     */
+    WorkgroupSize workgroup_size{};
 };
 
 struct DispatchDesc {
@@ -173,8 +274,67 @@ struct DispatchDesc {
     const void *push_constants;
     uint32_t push_constants_size;
     uint32_t group_count[3];
+    /**
+     * Read the group counts from a buffer when the dispatch executes instead of using group_count, e.g. written by
+     * a previous dispatch. The buffer holds 3 uint32_t (VkDispatchIndirectCommand) at indirect_offset and needs
+     * ResourceUsage::IndirectArgument.
+     */
+    BufferHandle indirect_buffer{BufferHandle::null()};
+    size_t indirect_offset{0};
+    /**
+     * Indices of the bindless images a dispatch of a bindless pipeline accesses (see Device::add_bindless_image()).
+     * Only these images are transitioned for the dispatch, other images of the arrays must not be accessed. The
+     * indices are read by dispatch() and do not need to outlive it.
+     */
+    std::span<const uint32_t> bindless_textures;
+    std::span<const uint32_t> bindless_rw_textures;
+};
+
+struct ContextDesc {
+    QueueType queue{QueueType::Graphics};
+    /// Record GPU timestamps for begin_scope()/end_scope(), ignored if the queue does not support timestamps.
+    bool enable_timestamps{false};
+    /// Maximum number of timestamp scopes per submission, further scopes are dropped.
+    uint32_t max_timestamp_scopes{256};
+};
+
+/// GPU execution time of a timestamp scope.
+struct GpuTiming {
+    std::string name;
+    double start_ms{0.0};     ///< Start relative to the first scope of the submission.
+    double duration_ms{0.0};
+    uint32_t depth{0};        ///< Nesting depth of the scope.
 };
 
+struct MemoryStats {
+    uint32_t allocation_count{0};  ///< Number of device memory allocations (blocks and dedicated allocations).
+    uint32_t block_count{0};
+    uint32_t resource_count{0};
+    size_t allocated_bytes{0};  ///< Total size of all device memory allocations.
+    size_t used_bytes{0};       ///< Bytes assigned to resources (including alignment padding).
+    float fragmentation{0.f};   ///< 1 - largest free range / free bytes, over all blocks.
+};
+
+/**
+ * Compute device.
+ *
+ * DeviceDesc::backend selects a Vulkan GPU device or the CPU backend, which keeps resources in host memory, runs
+ * copies with memcpy and executes registered C++ equivalents of the compute shaders on a thread pool. The CPU
+ * backend executes commands while they are recorded.
+ *
+ * Buffers, images and samplers can be destroyed right after recording the work that uses them, without waiting:
+ * the handle becomes invalid immediately, while the Vulkan objects and memory are released once every context
+ * submission that referenced the resource has completed (checked whenever a context retires its submissions).
+ *
+ * Threading contract:
+ *  - Creating and destroying shaders, buffers, images, samplers, pipelines and contexts is thread-safe.
+ *  - A context must only be used by one thread at a time (begin() to submit() and wait()/poll()), different
+ *    contexts can record and submit concurrently on different threads.
+ *  - A resource must only be recorded into by one context at a time and must not be destroyed concurrently.
+ *  - add_dependency() with value 0 reads the dependency's last submission, which must not be submitted
+ *    concurrently.
+ *  - memory_stats(), save_pipeline_cache() and the bindless functions can be called from any thread.
+ */
 class Device {
 public:
     Device(const DeviceDesc &desc = {});
@@ -193,28 +353,176 @@ public:
     void destroy_sampler(SamplerHandle sampler);
 
     PipelineHandle create_pipeline(const PipelineDesc &desc);
+    /// Create multiple pipelines, compiling them in parallel on worker threads. Creates none if any of them fails.
+    std::vector<PipelineHandle> create_pipelines(std::span<const PipelineDesc> descs);
     void destroy_pipeline(PipelineHandle pipeline);
 
-    ContextHandle create_context();
+    /**
+     * Write the pipeline cache to DeviceDesc::pipeline_cache_path.
+     * Also called when the device is destroyed.
+     * @return True if successful.
+     */
+    bool save_pipeline_cache();
+
+    /**
+     * Add an image to a bindless array, enabled by DeviceDesc::bindless_image_count.
+     *
+     * The arrays are persistent, update-after-bind descriptor arrays bound as set 1 of bindless pipelines:
+     *     [[vk::binding(0, 1)]] Texture2D textures[];
+     *     [[vk::binding(1, 1)]] RWTexture2D<float4> rw_textures[];
+     * Kernels index them with indices passed in push constants or a buffer, so a batch of images is processed by
+     * a single dispatch without building a descriptor set per image. A dispatch declares the indices it accesses
+     * in DispatchDesc::bindless_textures and bindless_rw_textures, only those images are transitioned.
+     *
+     * @param type Texture or RWTexture (which uses the base level of the subresource range only).
+     * @return Index of the image in the array.
+     */
+    uint32_t add_bindless_image(ImageHandle image, DescriptorType type, const ImageSubresourceRange &subresource = {});
+    /**
+     * Remove an image from a bindless array, the index is reused and must no longer be accessed by pending work.
+     * Destroying an image removes it from the arrays as well, its indices must not be removed again.
+     */
+    void remove_bindless_image(DescriptorType type, uint32_t index);
+
+    ContextHandle create_context(const ContextDesc &desc = {});
+    /// Destroy a context, waiting for its pending submissions first.
     void destroy_context(ContextHandle context);
 
+    /// True if contexts of the given type run on their own queue rather than sharing the graphics queue.
+    bool has_dedicated_queue(QueueType queue) const;
+
+    /// Start recording, waits for the previous submission of the context if it is still executing.
     void begin(ContextHandle context);
-    void submit(ContextHandle context);
-    void wait(ContextHandle context);
+
+    /**
+     * Submit the recorded commands.
+     * @return Timeline value signaled when the submission completes, see add_dependency() and wait_for_value().
+     */
+    uint64_t submit(ContextHandle context);
+
+    /**
+     * Wait for all submissions of a context and recycle its per-submission resources (staging, descriptor sets).
+     * @param timeout_ns Timeout in nanoseconds.
+     * @return False if the timeout expired.
+     */
+    bool wait(ContextHandle context, uint64_t timeout_ns = UINT64_MAX);
+
+    /**
+     * Wait for a single submission of a context.
+     * @param value Timeline value returned by submit().
+     * @param timeout_ns Timeout in nanoseconds.
+     * @return False if the timeout expired.
+     */
+    bool wait_for_value(ContextHandle context, uint64_t value, uint64_t timeout_ns = UINT64_MAX);
+
+    /// Non-blocking check if all submissions of a context completed, recycles its resources if so.
+    bool poll(ContextHandle context);
+
+    /// Timeline value of the last completed submission of a context.
+    uint64_t completed_value(ContextHandle context) const;
+
+    /**
+     * Make the next submission of a context wait on the GPU for a submission of another context, without
+     * blocking the CPU. Used to chain work across contexts and queues, e.g. upload -> process -> readback.
+     * @param context Context that waits.
+     * @param dependency Context that is waited on.
+     * @param value Timeline value returned by submit() on the dependency, 0 for its last submission.
+     */
+    void add_dependency(ContextHandle context, ContextHandle dependency, uint64_t value = 0);
+
+    /**
+     * Persistently mapped memory of a host or readback buffer, valid until the buffer is destroyed.
+     * Empty for device buffers. Host writes must be followed by flush_buffer() and host reads of GPU writes be
+     * preceded by invalidate_buffer(), both are no-ops for coherent memory.
+     */
+    std::span<uint8_t> map_buffer(BufferHandle buffer);
+    /// Make host writes to a mapped buffer range available to the device.
+    void flush_buffer(BufferHandle buffer, size_t offset = 0, size_t size = SIZE_MAX);
+    /// Make device writes to a mapped buffer range visible to the host, after the writing submission completed.
+    void invalidate_buffer(BufferHandle buffer, size_t offset = 0, size_t size = SIZE_MAX);
 
     void write_buffer(ContextHandle context, BufferHandle buffer, const void *data, size_t size, size_t offset = 0);
     void read_buffer(ContextHandle context, BufferHandle buffer, void *data, size_t size, size_t offset = 0);
     void copy_buffer(ContextHandle context, BufferHandle src, BufferHandle dst, size_t size, size_t src_offset = 0,
                      size_t dst_offset = 0);
 
+    /// Write/read mip level 0 of the first layer of an image.
     void write_image(ContextHandle context, ImageHandle image, const void *data, size_t size);
     void read_image(ContextHandle context, ImageHandle image, void *data, size_t size);
+
+    /**
+     * Write a region of an image, e.g. to update a single tile.
+     * Rows of block-compressed formats are rows of blocks, the region must be block aligned.
+     * @param row_pitch Bytes between rows in data, 0 for tightly packed rows.
+     */
+    void write_image(ContextHandle context, ImageHandle image, const ImageRegion &region, const void *data,
+                     size_t row_pitch = 0);
+    /**
+     * Read a region of an image, waits for the context's commands (see write_image()).
+     * @param row_pitch Bytes between rows in data, 0 for tightly packed rows.
+     */
+    void read_image(ContextHandle context, ImageHandle image, const ImageRegion &region, void *data,
+                    size_t row_pitch = 0);
+
+    /// Copy from a buffer (e.g. a mapped host buffer) to a region of an image without staging.
+    void copy_buffer_to_image(ContextHandle context, BufferHandle src, ImageHandle dst, const ImageRegion &region = {},
+                              size_t src_offset = 0, size_t src_row_pitch = 0);
+    /// Copy a region of an image to a buffer (e.g. a readback buffer) without staging.
+    void copy_image_to_buffer(ContextHandle context, ImageHandle src, BufferHandle dst, const ImageRegion &region = {},
+                              size_t dst_offset = 0, size_t dst_row_pitch = 0);
     void copy_image(ContextHandle context, ImageHandle src, ImageHandle dst, uint32_t width, uint32_t height);
 
-    void dispatch(ContextHandle context, DispatchDesc desc);
+    /**
+     * Generate mip levels 1 to n-1 of all layers from level 0 by successive linear downsampling.
+     * Requires a context on the graphics queue.
+     */
+    void generate_mips(ContextHandle context, ImageHandle image);
+
+    /**
+     * Record a compute dispatch, transitioning the bound resources. The pipeline and descriptor set are only bound
+     * if they differ from the previous dispatch of the context.
+     * Does not allocate once the context has recorded similar submissions: descriptor sets are cached per context
+     * and written from per-context scratch memory that is recycled when submissions retire.
+     */
+    void dispatch(ContextHandle context, const DispatchDesc &desc);
+
+    /**
+     * Record dispatches that do not depend on each other.
+     *
+     * The resources of all dispatches are transitioned by a single barrier, then the dispatches are recorded sorted
+     * by pipeline and descriptor set, so dispatches sharing them bind them once. A dispatch must not access a
+     * resource written by another dispatch of the batch: conflicting states are asserted, but UnorderedAccess
+     * bindings of the same resource in several dispatches are not ordered.
+     */
+    void dispatch_batch(ContextHandle context, std::span<const DispatchDesc> descs);
+
+    /**
+     * Open a named timestamp scope, the GPU time of the commands recorded until the matching end_scope() is
+     * measured. Scopes can be nested. No-op if timestamps are not enabled for the context.
+     */
+    void begin_scope(ContextHandle context, std::string name);
+    void end_scope(ContextHandle context);
+
+    /**
+     * Take the timings of the completed submissions, resolved by wait() or poll().
+     * Timings are also added to the GPU track of the global Profiler when it is enabled.
+     */
+    std::vector<GpuTiming> take_timings(ContextHandle context);
+
+    MemoryStats memory_stats() const;
+
+    /// Maximum number of invocations of a workgroup (product of the workgroup size).
+    uint32_t max_workgroup_invocations() const;
 
 private:
+    /// Submit and wait for the recorded commands and restart recording (recycles the staging buffer).
+    void flush(ContextHandle context);
+
+    /// Recycle per-submission resources of a context whose submissions all completed.
+    void retire(ContextHandle context);
+
     std::unique_ptr<DeviceImpl> m_impl;
+    std::unique_ptr<CpuDevice> m_cpu;  ///< Set for DeviceBackend::Cpu, all calls are forwarded to it.
 };
 
 FR_NAMESPACE_END
@@ -0,0 +1,74 @@
+#include "allocation_counter.h"
+#include "process/device.h"
+#include "shaders/shaders.h"
+
+#include <doctest/doctest.h>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("process");
+
+// Vulkan backend only, the CPU backend allocates a future per task. CI runs it on lavapipe where available.
+TEST_CASE("dispatch allocations" * doctest::skip(false || (FOTORITE_GITHUB_CI && !FOTORITE_GITHUB_CI_VULKAN)))
+{
+    static const size_t N = 1024;
+
+    Device device;
+
+    BufferHandle buffers[4];
+    for (BufferHandle &buffer : buffers) {
+        buffer = device.create_buffer({
+            .size = N * sizeof(float),
+            .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess,
+        });
+    }
+
+    ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+    ShaderHandle shader = device.create_shader({.code = blob.data(), .code_size = blob.size_bytes()});
+    PipelineHandle pipeline = device.create_pipeline({
+        .shader = shader,
+        .binding_layout{
+            {.binding = 0, .type = DescriptorType::StructuredBuffer},
+            {.binding = 1, .type = DescriptorType::StructuredBuffer},
+            {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+        },
+        .push_constants_size = 4,
+    });
+
+    ContextHandle context = device.create_context();
+
+    // The first submission warms up the caches, the next ones must not allocate: neither building the dispatch
+    // description nor recording it, including descriptor set cache misses after the context retired.
+    uint32_t push_constants = N;
+    size_t allocation_count = 0;
+    for (int submission = 0; submission < 3; ++submission) {
+        device.begin(context);
+        for (uint32_t i = 0; i < 16; ++i) {
+            AllocationCounter counter;
+            device.dispatch(context, {
+                                         .pipeline = pipeline,
+                                         .binding_set{
+                                             {.binding = 0, .resource = buffers[i % 4]},
+                                             {.binding = 1, .resource = buffers[(i + 1) % 4]},
+                                             {.binding = 2, .resource = buffers[(i + 2) % 4]},
+                                         },
+                                         .push_constants = &push_constants,
+                                         .push_constants_size = sizeof(push_constants),
+                                         .group_count{N / 256, 1, 1},
+                                     });
+            if (submission > 0)
+                allocation_count += counter.count();
+        }
+        device.submit(context);
+        device.wait(context);
+    }
+    CHECK_EQ(allocation_count, 0);
+
+    device.destroy_context(context);
+    device.destroy_pipeline(pipeline);
+    device.destroy_shader(shader);
+    for (BufferHandle buffer : buffers)
+        device.destroy_buffer(buffer);
+}
+
+TEST_SUITE_END();
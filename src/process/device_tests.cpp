@@ -1,5 +1,15 @@
 #include "process/device.h"
+#include "process/cpu_test_kernels.h"
+#include "process/workgroup_tuner.h"
 #include "shaders/shaders.h"
+#include "core/profiler.h"
+#include "core/timer.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
 
 #include <doctest/doctest.h>
 
@@ -7,11 +17,37 @@ using namespace fr;
 
 TEST_SUITE_BEGIN("process");
 
-TEST_CASE("Device" * doctest::skip(false || FOTORITE_GITHUB_CI))
+// Device tests run on every backend, the Vulkan backend needs a GPU and is skipped on CI.
+struct VulkanBackend {
+    static constexpr DeviceBackend value = DeviceBackend::Vulkan;
+};
+struct CpuBackend {
+    static constexpr DeviceBackend value = DeviceBackend::Cpu;
+};
+TYPE_TO_STRING(VulkanBackend);
+TYPE_TO_STRING(CpuBackend);
+
+#if FOTORITE_GITHUB_CI
+#define DEVICE_TEST_BACKENDS CpuBackend
+#else
+#define DEVICE_TEST_BACKENDS VulkanBackend, CpuBackend
+#endif
+
+/// Description of a device of the backend under test, registers the C++ kernels of the test shaders for the CPU.
+template <typename Backend>
+DeviceDesc test_device_desc(DeviceDesc desc = {})
 {
-    Device device({
+    if (Backend::value == DeviceBackend::Cpu)
+        register_test_kernels();
+    desc.backend = Backend::value;
+    return desc;
+}
+
+TEST_CASE_TEMPLATE("Device", Backend, DEVICE_TEST_BACKENDS)
+{
+    Device device(test_device_desc<Backend>({
         .enable_validation_layers = true,
-    });
+    }));
 
     SUBCASE("sampler")
     {
@@ -32,6 +68,47 @@ TEST_CASE("Device" * doctest::skip(false || FOTORITE_GITHUB_CI))
         device.destroy_buffer(buffer);
     }
 
+    SUBCASE("memory")
+    {
+        std::vector<BufferHandle> buffers;
+        for (int i = 0; i < 200; ++i) {
+            buffers.push_back(device.create_buffer({
+                .size = 1024,
+                .usage = ResourceUsage::ShaderResource,
+                .memory = i % 2 ? MemoryType::Host : MemoryType::Device,
+                .transient = i % 4 == 0,
+            }));
+        }
+        ImageHandle image = device.create_image({
+            .width = 256,
+            .height = 256,
+            .format = ImageFormat::RGBA8Unorm,
+            .usage = ResourceUsage::ShaderResource,
+        });
+
+        // Resources are sub-allocated from a few blocks, the CPU backend allocates each one separately.
+        MemoryStats stats = device.memory_stats();
+        CHECK_EQ(stats.resource_count, 201);
+        if (Backend::value == DeviceBackend::Vulkan)
+            CHECK_LE(stats.allocation_count, 6);
+        CHECK_GE(stats.used_bytes, 200 * 1024 + 256 * 256 * 4);
+        CHECK_LE(stats.used_bytes, stats.allocated_bytes);
+
+        for (BufferHandle buffer : buffers)
+            device.destroy_buffer(buffer);
+        device.destroy_image(image);
+
+        stats = device.memory_stats();
+        CHECK_EQ(stats.resource_count, 0);
+        CHECK_EQ(stats.used_bytes, 0);
+
+        // Empty blocks are kept, so create/destroy cycles do not allocate device memory.
+        const uint32_t block_count = stats.block_count;
+        for (int i = 0; i < 10; ++i)
+            device.destroy_buffer(device.create_buffer({.size = 1024, .usage = ResourceUsage::ShaderResource}));
+        CHECK_EQ(device.memory_stats().block_count, block_count);
+    }
+
     SUBCASE("shader")
     {
         auto blob = get_shader_blob(ShaderID::test_buffer_cs);
@@ -44,6 +121,74 @@ TEST_CASE("Device" * doctest::skip(false || FOTORITE_GITHUB_CI))
     }
 }
 
+TEST_CASE_TEMPLATE("staging", Backend, DEVICE_TEST_BACKENDS)
+{
+    // Small staging buffer to exercise chunked transfers.
+    Device device(test_device_desc<Backend>({
+        .enable_validation_layers = true,
+        .staging_buffer_size = 64 * 1024,
+    }));
+
+    ContextHandle context = device.create_context();
+
+    SUBCASE("buffer")
+    {
+        static const size_t N = 100000;
+        std::vector<uint32_t> src_data(N);
+        std::vector<uint32_t> dst_data(N, 0);
+        for (size_t i = 0; i < N; ++i)
+            src_data[i] = uint32_t(i * 7);
+
+        BufferHandle buffer = device.create_buffer({
+            .size = N * sizeof(uint32_t),
+            .usage = ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+            .memory = MemoryType::Device,
+        });
+
+        device.begin(context);
+        device.write_buffer(context, buffer, src_data.data(), N * sizeof(uint32_t));
+        device.read_buffer(context, buffer, dst_data.data(), N * sizeof(uint32_t));
+        device.submit(context);
+        device.wait(context);
+
+        CHECK(src_data == dst_data);
+
+        device.destroy_buffer(buffer);
+    }
+
+    SUBCASE("image")
+    {
+        static const uint32_t W = 256;
+        static const uint32_t H = 171;
+        std::vector<uint8_t> src_data(W * H * 4);
+        std::vector<uint8_t> dst_data(W * H * 4, 0);
+        for (size_t i = 0; i < src_data.size(); ++i)
+            src_data[i] = uint8_t(i * 13);
+
+        ImageHandle image = device.create_image({
+            .width = W,
+            .height = H,
+            .format = ImageFormat::RGBA8Unorm,
+            .usage = ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+            .memory = MemoryType::Device,
+        });
+
+        // Many small uploads reuse the staging buffer.
+        device.begin(context);
+        for (int i = 0; i < 10; ++i)
+            device.write_image(context, image, src_data.data(), src_data.size());
+        device.read_image(context, image, dst_data.data(), dst_data.size());
+        device.submit(context);
+        device.wait(context);
+
+        CHECK(src_data == dst_data);
+
+        device.destroy_image(image);
+    }
+
+    device.destroy_context(context);
+}
+
 TEST_CASE("compute buffer" * doctest::skip(true || FOTORITE_GITHUB_CI))
 {
     static const size_t N = 1024;
@@ -227,4 +372,1034 @@ TEST_CASE("compute image" * doctest::skip(true || FOTORITE_GITHUB_CI))
     device.destroy_image(dst_image);
 }
 
+TEST_CASE_TEMPLATE("queues", Backend, DEVICE_TEST_BACKENDS)
+{
+    static const size_t N = 4096;
+
+    Device device(test_device_desc<Backend>({
+        .enable_validation_layers = true,
+    }));
+    MESSAGE("dedicated compute queue: " << device.has_dedicated_queue(QueueType::Compute));
+    MESSAGE("dedicated transfer queue: " << device.has_dedicated_queue(QueueType::Transfer));
+
+    std::vector<float> input_data(N);
+    for (size_t i = 0; i < N; ++i)
+        input_data[i] = float(i);
+    std::vector<float> result_data(N);
+
+    BufferHandle input = device.create_buffer({
+        .size = N * sizeof(float),
+        .usage = ResourceUsage::ShaderResource | ResourceUsage::TransferDst,
+    });
+    BufferHandle result = device.create_buffer({
+        .size = N * sizeof(float),
+        .usage = ResourceUsage::UnorderedAccess | ResourceUsage::TransferSrc,
+    });
+
+    ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+    ShaderHandle shader = device.create_shader({
+        .code = blob.data(),
+        .code_size = blob.size_bytes(),
+    });
+    PipelineHandle pipeline = device.create_pipeline({
+        .shader = shader,
+        .binding_layout{
+            {.binding = 0, .type = DescriptorType::StructuredBuffer},
+            {.binding = 1, .type = DescriptorType::StructuredBuffer},
+            {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+        },
+        .push_constants_size = 4,
+    });
+
+    ContextHandle upload = device.create_context({.queue = QueueType::Transfer});
+    ContextHandle compute = device.create_context({.queue = QueueType::Compute});
+    ContextHandle readback = device.create_context({.queue = QueueType::Transfer});
+
+    // upload -> compute -> readback, ordered on the GPU by semaphores
+    device.begin(upload);
+    device.write_buffer(upload, input, input_data.data(), N * sizeof(float));
+    device.submit(upload);
+
+    device.add_dependency(compute, upload);
+    device.begin(compute);
+    uint32_t push_constants = N;
+    device.dispatch(compute, {
+                                 .pipeline = pipeline,
+                                 .binding_set{
+                                     {.binding = 0, .resource = input},
+                                     {.binding = 1, .resource = input},
+                                     {.binding = 2, .resource = result},
+                                 },
+                                 .push_constants = &push_constants,
+                                 .push_constants_size = sizeof(push_constants),
+                                 .group_count{N / 256, 1, 1},
+                             });
+    device.submit(compute);
+
+    device.add_dependency(readback, compute);
+    device.begin(readback);
+    device.read_buffer(readback, result, result_data.data(), N * sizeof(float));
+    device.submit(readback);
+
+    device.wait(readback);
+    device.wait(compute);
+    device.wait(upload);
+
+    for (size_t i = 0; i < N; ++i)
+        CHECK_EQ(result_data[i], 2.f * i);
+
+    device.destroy_context(upload);
+    device.destroy_context(compute);
+    device.destroy_context(readback);
+    device.destroy_pipeline(pipeline);
+    device.destroy_shader(shader);
+    device.destroy_buffer(input);
+    device.destroy_buffer(result);
+}
+
+TEST_CASE_TEMPLATE("timeline", Backend, DEVICE_TEST_BACKENDS)
+{
+    static const size_t N = 1024;
+
+    Device device(test_device_desc<Backend>());
+
+    BufferHandle buffers[2];
+    for (BufferHandle &buffer : buffers) {
+        buffer = device.create_buffer({
+            .size = N * sizeof(float),
+            .usage = ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+        });
+    }
+
+    std::vector<float> data(N, 1.f);
+    std::vector<float> result(N);
+
+    ContextHandle a = device.create_context({.queue = QueueType::Transfer});
+    ContextHandle b = device.create_context();
+    CHECK(device.poll(a));
+
+    // Several rounds of a -> b, b waits for a on the GPU only.
+    uint64_t values[3];
+    for (uint64_t &value : values) {
+        device.begin(a);
+        device.write_buffer(a, buffers[0], data.data(), N * sizeof(float));
+        uint64_t a_value = device.submit(a);
+
+        device.add_dependency(b, a, a_value);
+        device.begin(b);
+        device.copy_buffer(b, buffers[0], buffers[1], N * sizeof(float));
+        value = device.submit(b);
+    }
+    CHECK_LT(values[0], values[1]);
+    CHECK_LT(values[1], values[2]);
+
+    CHECK(device.wait_for_value(b, values[1], 5'000'000'000));
+    CHECK_GE(device.completed_value(b), values[1]);
+    CHECK(device.wait(b, 5'000'000'000));
+    CHECK_EQ(device.completed_value(b), values[2]);
+    CHECK(device.poll(b));
+    // Completed work never times out.
+    CHECK(device.wait_for_value(b, values[2], 0));
+
+    device.begin(b);
+    device.read_buffer(b, buffers[1], result.data(), N * sizeof(float));
+    device.submit(b);
+    CHECK(device.wait(b));
+    CHECK(device.wait(a));
+    CHECK_EQ(result, data);
+
+    device.destroy_context(a);
+    device.destroy_context(b);
+    for (BufferHandle buffer : buffers)
+        device.destroy_buffer(buffer);
+}
+
+TEST_CASE("deferred destruction" * doctest::skip(false || FOTORITE_GITHUB_CI))
+{
+    static const size_t N = 1024;
+
+    Device device;
+
+    const BufferDesc buffer_desc{
+        .size = N * sizeof(float),
+        .usage = ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+    };
+    BufferHandle src = device.create_buffer(buffer_desc);
+    BufferHandle dst = device.create_buffer(buffer_desc);
+
+    ContextHandle a = device.create_context({.queue = QueueType::Transfer});
+    ContextHandle b = device.create_context();
+
+    std::vector<float> data(N, 1.f);
+    std::vector<float> result(N);
+
+    device.begin(a);
+    device.write_buffer(a, src, data.data(), N * sizeof(float));
+    device.add_dependency(b, a, device.submit(a));
+
+    // src is referenced by both contexts and released right after recording.
+    device.begin(b);
+    device.copy_buffer(b, src, dst, N * sizeof(float));
+    device.destroy_buffer(src);
+    const uint32_t resource_count = device.memory_stats().resource_count;
+    device.submit(b);
+
+    CHECK(device.wait(a));
+    CHECK_EQ(device.memory_stats().resource_count, resource_count);
+    CHECK(device.wait(b));
+    CHECK_EQ(device.memory_stats().resource_count, resource_count - 1);
+
+    device.begin(b);
+    device.read_buffer(b, dst, result.data(), N * sizeof(float));
+    device.submit(b);
+    CHECK(device.wait(b));
+    CHECK_EQ(result, data);
+
+    // Unused resources are released immediately.
+    ImageHandle image = device.create_image(
+        {.width = 16, .height = 16, .format = ImageFormat::RGBA8Unorm, .usage = ResourceUsage::ShaderResource});
+    device.destroy_image(image);
+    CHECK_EQ(device.memory_stats().resource_count, resource_count - 1);
+
+    SUBCASE("destroy context after submit")
+    {
+        // The context is destroyed while its submission may still be running, it must finish using src first.
+        ContextHandle c = device.create_context();
+        BufferHandle temp = device.create_buffer(buffer_desc);
+        std::vector<float> temp_data(N, 2.f);
+        device.begin(c);
+        device.write_buffer(c, temp, temp_data.data(), N * sizeof(float));
+        device.copy_buffer(c, temp, dst, N * sizeof(float));
+        device.destroy_buffer(temp);
+        device.submit(c);
+        device.destroy_context(c);
+        CHECK_EQ(device.memory_stats().resource_count, resource_count - 1);
+
+        // Retiring another context must not release anything twice.
+        device.begin(b);
+        device.read_buffer(b, dst, result.data(), N * sizeof(float));
+        device.submit(b);
+        CHECK(device.wait(b));
+        CHECK_EQ(result, temp_data);
+    }
+
+    device.destroy_context(a);
+    device.destroy_context(b);
+    device.destroy_buffer(dst);
+}
+
+TEST_CASE_TEMPLATE("timestamps", Backend, DEVICE_TEST_BACKENDS)
+{
+    static const size_t N = 4 * 1024 * 1024;
+
+    Device device(test_device_desc<Backend>());
+
+    BufferHandle buffers[2];
+    for (BufferHandle &buffer : buffers) {
+        buffer = device.create_buffer({
+            .size = N,
+            .usage = ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+        });
+    }
+
+    Profiler &profiler = Profiler::global();
+    profiler.clear();
+    profiler.set_enabled(true);
+
+    ContextHandle context = device.create_context({.enable_timestamps = true, .max_timestamp_scopes = 2});
+    device.begin(context);
+    device.begin_scope(context, "frame");
+    device.begin_scope(context, "copy");
+    device.copy_buffer(context, buffers[0], buffers[1], N);
+    device.end_scope(context);
+    // Exceeds max_timestamp_scopes and is dropped.
+    device.begin_scope(context, "dropped");
+    device.end_scope(context);
+    device.submit(context);
+    CHECK(device.wait(context));
+
+    // "frame" is still open and is resolved by the next submission.
+    std::vector<GpuTiming> timings = device.take_timings(context);
+    REQUIRE_EQ(timings.size(), 1);
+    CHECK_EQ(timings[0].name, "copy");
+    CHECK_EQ(timings[0].depth, 1);
+    CHECK_GT(timings[0].duration_ms, 0.0);
+
+    device.begin(context);
+    device.copy_buffer(context, buffers[1], buffers[0], N);
+    device.end_scope(context);
+    device.submit(context);
+    CHECK(device.wait(context));
+
+    timings = device.take_timings(context);
+    REQUIRE_EQ(timings.size(), 1);
+    CHECK_EQ(timings[0].name, "frame");
+    CHECK_EQ(timings[0].depth, 0);
+    CHECK_GT(timings[0].duration_ms, 0.0);
+    CHECK(device.take_timings(context).empty());
+
+    profiler.set_enabled(false);
+    std::vector<ProfileEvent> events = profiler.events();
+    REQUIRE_EQ(events.size(), 2);
+    CHECK_EQ(events[0].category, Backend::value == DeviceBackend::Vulkan ? "gpu" : "cpu device");
+    CHECK_EQ(events[0].track, events[1].track);
+    profiler.clear();
+
+    // Without timestamps scopes are ignored.
+    ContextHandle untimed = device.create_context();
+    device.begin(untimed);
+    device.begin_scope(untimed, "ignored");
+    device.copy_buffer(untimed, buffers[0], buffers[1], N);
+    device.end_scope(untimed);
+    device.submit(untimed);
+    CHECK(device.wait(untimed));
+    CHECK(device.take_timings(untimed).empty());
+
+    device.destroy_context(context);
+    device.destroy_context(untimed);
+    for (BufferHandle buffer : buffers)
+        device.destroy_buffer(buffer);
+}
+
+TEST_CASE_TEMPLATE("threads", Backend, DEVICE_TEST_BACKENDS)
+{
+    static const int THREAD_COUNT = 8;
+    static const int ITERATION_COUNT = 20;
+    static const size_t N = 64 * 1024;
+
+    Device device(test_device_desc<Backend>());
+
+    // Every thread creates its own resources and context and records, submits and waits concurrently.
+    std::atomic<int> error_count{0};
+    auto worker = [&](int index) {
+        ContextHandle context = device.create_context({.queue = index % 2 ? QueueType::Compute : QueueType::Graphics});
+        std::vector<float> data(N);
+        std::vector<float> result(N);
+
+        for (int i = 0; i < ITERATION_COUNT; ++i) {
+            BufferHandle src = device.create_buffer({
+                .size = N * sizeof(float),
+                .usage = ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+            });
+            BufferHandle dst = device.create_buffer({
+                .size = N * sizeof(float),
+                .usage = ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+            });
+            std::fill(data.begin(), data.end(), float(index * ITERATION_COUNT + i));
+
+            device.begin(context);
+            device.write_buffer(context, src, data.data(), N * sizeof(float));
+            device.copy_buffer(context, src, dst, N * sizeof(float));
+            device.read_buffer(context, dst, result.data(), N * sizeof(float));
+            device.submit(context);
+            device.wait(context);
+
+            if (result != data)
+                error_count++;
+
+            device.destroy_buffer(src);
+            device.destroy_buffer(dst);
+        }
+
+        device.destroy_context(context);
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREAD_COUNT; ++i)
+        threads.emplace_back(worker, i);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    CHECK_EQ(error_count.load(), 0);
+    CHECK_EQ(device.memory_stats().resource_count, 0);
+}
+
+TEST_CASE_TEMPLATE("mapped buffers", Backend, DEVICE_TEST_BACKENDS)
+{
+    static const size_t N = 1024;
+
+    Device device(test_device_desc<Backend>());
+
+    BufferHandle upload = device.create_buffer({
+        .size = N * sizeof(float),
+        .usage = ResourceUsage::TransferSrc,
+        .memory = MemoryType::Host,
+    });
+    BufferHandle buffer = device.create_buffer({
+        .size = N * sizeof(float),
+        .usage = ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+    });
+    BufferHandle readback = device.create_buffer({
+        .size = N * sizeof(float),
+        .usage = ResourceUsage::TransferDst,
+        .memory = MemoryType::Readback,
+    });
+
+    CHECK(device.map_buffer(buffer).empty());
+
+    // The mapping is persistent, write straight into it.
+    std::span<uint8_t> upload_data = device.map_buffer(upload);
+    REQUIRE_EQ(upload_data.size(), N * sizeof(float));
+    CHECK_EQ(device.map_buffer(upload).data(), upload_data.data());
+    float *src = reinterpret_cast<float *>(upload_data.data());
+    for (size_t i = 0; i < N; ++i)
+        src[i] = float(i);
+    device.flush_buffer(upload);
+
+    ContextHandle context = device.create_context();
+    device.begin(context);
+    device.copy_buffer(context, upload, buffer, N * sizeof(float));
+    device.copy_buffer(context, buffer, readback, N * sizeof(float));
+    device.submit(context);
+    device.wait(context);
+
+    std::span<uint8_t> readback_data = device.map_buffer(readback);
+    REQUIRE_EQ(readback_data.size(), N * sizeof(float));
+    device.invalidate_buffer(readback);
+    const float *dst = reinterpret_cast<const float *>(readback_data.data());
+    CHECK_EQ(dst[0], 0.f);
+    CHECK_EQ(dst[N - 1], float(N - 1));
+    CHECK_EQ(std::memcmp(dst, src, N * sizeof(float)), 0);
+
+    // read_buffer on readback memory invalidates itself.
+    std::vector<float> result(N);
+    device.read_buffer(context, readback, result.data(), N * sizeof(float));
+    CHECK_EQ(result[N / 2], float(N / 2));
+
+    device.destroy_context(context);
+    device.destroy_buffer(upload);
+    device.destroy_buffer(buffer);
+    device.destroy_buffer(readback);
+}
+
+TEST_CASE_TEMPLATE("image regions", Backend, DEVICE_TEST_BACKENDS)
+{
+    static const uint32_t W = 64;
+    static const uint32_t H = 48;
+
+    Device device(test_device_desc<Backend>());
+
+    ImageHandle image = device.create_image({
+        .width = W,
+        .height = H,
+        .format = ImageFormat::RGBA8Unorm,
+        .usage = ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+    });
+
+    auto pixel = [](uint32_t x, uint32_t y) { return (y << 16) | x; };
+
+    ContextHandle context = device.create_context();
+    device.begin(context);
+
+    std::vector<uint32_t> zeros(W * H, 0);
+    device.write_image(context, image, zeros.data(), zeros.size() * sizeof(uint32_t));
+
+    // Update a tile from a larger source with its own row pitch.
+    const ImageRegion tile{.x = 8, .y = 4, .width = 16, .height = 8};
+    const uint32_t src_width = 20;
+    std::vector<uint32_t> src(src_width * tile.height);
+    for (uint32_t y = 0; y < tile.height; ++y) {
+        for (uint32_t x = 0; x < src_width; ++x)
+            src[y * src_width + x] = pixel(tile.x + x, tile.y + y);
+    }
+    device.write_image(context, image, tile, src.data(), src_width * sizeof(uint32_t));
+
+    std::vector<uint32_t> result(W * H);
+    device.read_image(context, image, result.data(), result.size() * sizeof(uint32_t));
+    bool match = true;
+    for (uint32_t y = 0; y < H; ++y) {
+        for (uint32_t x = 0; x < W; ++x) {
+            bool inside = x >= tile.x && x < tile.x + tile.width && y >= tile.y && y < tile.y + tile.height;
+            match = match && result[y * W + x] == (inside ? pixel(x, y) : 0);
+        }
+    }
+    CHECK(match);
+
+    // Region readback, extending to the right edge.
+    std::vector<uint32_t> region_result((W - 12) * 2);
+    device.read_image(context, image, {.x = 12, .y = 6, .height = 2}, region_result.data());
+    CHECK_EQ(region_result[0], pixel(12, 6));
+    CHECK_EQ(region_result[W - 12], pixel(12, 7));
+    CHECK_EQ(region_result[W - 12 - 1], 0);
+
+    // Buffer <-> image copies from mapped memory.
+    BufferHandle upload = device.create_buffer({
+        .size = 4 * 4 * sizeof(uint32_t),
+        .usage = ResourceUsage::TransferSrc,
+        .memory = MemoryType::Host,
+    });
+    BufferHandle readback = device.create_buffer({
+        .size = W * H * sizeof(uint32_t),
+        .usage = ResourceUsage::TransferDst,
+        .memory = MemoryType::Readback,
+    });
+    std::span<uint8_t> upload_data = device.map_buffer(upload);
+    std::vector<uint32_t> block(16, 7);
+    std::memcpy(upload_data.data(), block.data(), block.size() * sizeof(uint32_t));
+    device.flush_buffer(upload);
+
+    device.copy_buffer_to_image(context, upload, image, {.x = W - 4, .y = H - 4, .width = 4, .height = 4});
+    device.copy_image_to_buffer(context, image, readback);
+    device.submit(context);
+    device.wait(context);
+
+    device.invalidate_buffer(readback);
+    const uint32_t *readback_data = reinterpret_cast<const uint32_t *>(device.map_buffer(readback).data());
+    CHECK_EQ(readback_data[(H - 1) * W + W - 1], 7);
+    CHECK_EQ(readback_data[(H - 5) * W + W - 1], 0);
+    CHECK_EQ(readback_data[tile.y * W + tile.x], pixel(tile.x, tile.y));
+
+    device.destroy_context(context);
+    device.destroy_buffer(upload);
+    device.destroy_buffer(readback);
+    device.destroy_image(image);
+}
+
+TEST_CASE_TEMPLATE("mips", Backend, DEVICE_TEST_BACKENDS)
+{
+    static const uint32_t W = 64;
+    static const uint32_t H = 32;
+    static const uint32_t LAYERS = 2;
+
+    Device device(test_device_desc<Backend>());
+
+    const uint32_t mip_levels = mip_level_count(W, H);
+    CHECK_EQ(mip_levels, 7);
+
+    ImageHandle image = device.create_image({
+        .width = W,
+        .height = H,
+        .format = ImageFormat::RGBA8Unorm,
+        .usage = ResourceUsage::ShaderResource | ResourceUsage::TransferSrc | ResourceUsage::TransferDst,
+        .mip_levels = mip_levels,
+        .array_layers = LAYERS,
+    });
+
+    ContextHandle context = device.create_context();
+    device.begin(context);
+
+    // A constant color per layer is preserved by any downsampling filter.
+    const uint32_t colors[LAYERS] = {0xff204080, 0x80ff0010};
+    for (uint32_t layer = 0; layer < LAYERS; ++layer) {
+        std::vector<uint32_t> data(W * H, colors[layer]);
+        device.write_image(context, image, {.array_layer = layer}, data.data());
+    }
+    device.generate_mips(context, image);
+
+    uint32_t last_level[LAYERS] = {};
+    std::vector<uint32_t> level_1(W / 2 * H / 2);
+    for (uint32_t layer = 0; layer < LAYERS; ++layer)
+        device.read_image(context, image, {.mip_level = mip_levels - 1, .array_layer = layer}, &last_level[layer]);
+    device.read_image(context, image, {.mip_level = 1, .array_layer = 1}, level_1.data());
+    device.submit(context);
+    device.wait(context);
+
+    CHECK_EQ(last_level[0], colors[0]);
+    CHECK_EQ(last_level[1], colors[1]);
+    CHECK_EQ(level_1.front(), colors[1]);
+    CHECK_EQ(level_1.back(), colors[1]);
+
+    device.destroy_context(context);
+    device.destroy_image(image);
+}
+
+TEST_CASE_TEMPLATE("bindless", Backend, DEVICE_TEST_BACKENDS)
+{
+    static const uint32_t N = 64;
+
+    Device device(test_device_desc<Backend>({.bindless_image_count = 16}));
+
+    const ImageDesc input_desc{
+        .width = N,
+        .height = N,
+        .format = ImageFormat::RGBA32Float,
+        .usage = ResourceUsage::ShaderResource | ResourceUsage::TransferDst,
+    };
+    ImageHandle inputs[3] = {
+        device.create_image(input_desc),
+        device.create_image(input_desc),
+        device.create_image(input_desc),
+    };
+    ImageHandle output = device.create_image({
+        .width = N,
+        .height = N,
+        .format = ImageFormat::RGBA32Float,
+        .usage = ResourceUsage::UnorderedAccess | ResourceUsage::TransferSrc,
+    });
+
+    // Indices of removed images are reused, the arrays are indexed independently.
+    CHECK_EQ(device.add_bindless_image(inputs[0], DescriptorType::Texture), 0);
+    CHECK_EQ(device.add_bindless_image(inputs[1], DescriptorType::Texture), 1);
+    device.remove_bindless_image(DescriptorType::Texture, 0);
+    CHECK_EQ(device.add_bindless_image(inputs[2], DescriptorType::Texture), 0);
+    CHECK_EQ(device.add_bindless_image(output, DescriptorType::RWTexture), 0);
+
+    // Bindless pipelines still take regular bindings in set 0.
+    ShaderBlob blob = get_shader_blob(ShaderID::test_image_cs);
+    ShaderHandle shader = device.create_shader({
+        .code = blob.data(),
+        .code_size = blob.size_bytes(),
+    });
+    PipelineHandle pipeline = device.create_pipeline({
+        .shader = shader,
+        .binding_layout{
+            {.binding = 0, .type = DescriptorType::Texture},
+            {.binding = 1, .type = DescriptorType::RWTexture},
+        },
+        .push_constants_size = 8,
+        .bindless = true,
+    });
+
+    std::vector<float> data(N * N * 4, 1.f);
+    ContextHandle context = device.create_context();
+    device.begin(context);
+    device.write_image(context, inputs[1], data.data(), data.size() * sizeof(float));
+    uint32_t push_constants[2] = {N, N};
+    // Declared bindless images are transitioned with the dispatch. test_image.cs.hlsl does not index the set 1 arrays,
+    // so shader-side bindless indexing is only covered by the CPU backend tests until a shader using them is compiled.
+    const uint32_t textures[] = {0, 1};
+    const uint32_t rw_textures[] = {0};
+    device.dispatch(context, {
+                                 .pipeline = pipeline,
+                                 .binding_set{
+                                     {.binding = 0, .resource = inputs[1]},
+                                     {.binding = 1, .resource = output},
+                                 },
+                                 .push_constants = &push_constants,
+                                 .push_constants_size = sizeof(push_constants),
+                                 .group_count{N / 32, N / 32, 1},
+                                 .bindless_textures = textures,
+                                 .bindless_rw_textures = rw_textures,
+                             });
+    device.read_image(context, output, data.data(), data.size() * sizeof(float));
+    device.submit(context);
+    device.wait(context);
+
+    CHECK_EQ(data[0], 3.f);
+    CHECK_EQ(data.back(), 3.f);
+
+    // Destroying an image frees the indices still holding it.
+    device.destroy_image(inputs[2]);
+    CHECK_EQ(device.add_bindless_image(inputs[0], DescriptorType::Texture), 0);
+
+    device.destroy_context(context);
+    device.destroy_pipeline(pipeline);
+    device.destroy_shader(shader);
+    device.destroy_image(inputs[0]);
+    device.destroy_image(inputs[1]);
+    device.destroy_image(output);
+}
+
+TEST_CASE("pipeline cache" * doctest::skip(false || FOTORITE_GITHUB_CI))
+{
+    std::filesystem::path cache_path = std::filesystem::temp_directory_path() / "fotorite_test_pipeline_cache.bin";
+    std::filesystem::remove(cache_path);
+
+    ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+
+    auto create_pipelines = [&](Device &device) {
+        ShaderHandle shader = device.create_shader({
+            .code = blob.data(),
+            .code_size = blob.size_bytes(),
+        });
+        std::vector<PipelineDesc> descs(4);
+        for (size_t i = 0; i < descs.size(); ++i) {
+            descs[i] = {
+                .shader = shader,
+                .binding_layout{
+                    {.binding = 0, .type = DescriptorType::StructuredBuffer},
+                    {.binding = 1, .type = DescriptorType::StructuredBuffer},
+                    {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+                },
+                .push_constants_size = uint32_t(4 * (i + 1)),
+            };
+        }
+        std::vector<PipelineHandle> pipelines = device.create_pipelines(descs);
+        CHECK_EQ(pipelines.size(), descs.size());
+        for (PipelineHandle pipeline : pipelines) {
+            CHECK(pipeline);
+            device.destroy_pipeline(pipeline);
+        }
+        device.destroy_shader(shader);
+    };
+
+    // Saved when the device is destroyed.
+    {
+        Device device({.pipeline_cache_path = cache_path});
+        create_pipelines(device);
+    }
+    REQUIRE(std::filesystem::exists(cache_path));
+    CHECK_GT(std::filesystem::file_size(cache_path), 0);
+
+    // Loaded again.
+    {
+        Device device({.pipeline_cache_path = cache_path});
+        create_pipelines(device);
+        CHECK(device.save_pipeline_cache());
+    }
+
+    // Invalid data is discarded.
+    {
+        std::ofstream(cache_path, std::ios::binary | std::ios::trunc) << "not a pipeline cache";
+        Device device({.pipeline_cache_path = cache_path});
+        create_pipelines(device);
+    }
+
+    std::filesystem::remove(cache_path);
+}
+
+TEST_CASE_TEMPLATE("indirect and batched dispatch", Backend, DEVICE_TEST_BACKENDS)
+{
+    static const uint32_t N = 1024;
+
+    Device device(test_device_desc<Backend>());
+
+    const BufferDesc buffer_desc{
+        .size = N * sizeof(float),
+        .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess | ResourceUsage::TransferSrc |
+                 ResourceUsage::TransferDst,
+    };
+    BufferHandle input = device.create_buffer(buffer_desc);
+    BufferHandle results[3];
+    for (BufferHandle &result : results)
+        result = device.create_buffer(buffer_desc);
+    BufferHandle args = device.create_buffer({
+        .size = 3 * sizeof(uint32_t),
+        .usage = ResourceUsage::IndirectArgument | ResourceUsage::TransferDst,
+    });
+
+    ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+    ShaderHandle shader = device.create_shader({.code = blob.data(), .code_size = blob.size_bytes()});
+    PipelineHandle pipeline = device.create_pipeline({
+        .shader = shader,
+        .binding_layout{
+            {.binding = 0, .type = DescriptorType::StructuredBuffer},
+            {.binding = 1, .type = DescriptorType::StructuredBuffer},
+            {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+        },
+        .push_constants_size = 4,
+    });
+
+    uint32_t push_constants = N;
+    auto add = [&](BufferHandle result) {
+        return DispatchDesc{
+            .pipeline = pipeline,
+            .binding_set{
+                {.binding = 0, .resource = input},
+                {.binding = 1, .resource = input},
+                {.binding = 2, .resource = result},
+            },
+            .push_constants = &push_constants,
+            .push_constants_size = sizeof(push_constants),
+            .group_count{N / 256, 1, 1},
+        };
+    };
+
+    ContextHandle context = device.create_context();
+    std::vector<float> data(N, 1.f);
+    std::vector<float> zeros(N, 0.f);
+    const uint32_t group_count[3] = {2, 1, 1};
+
+    device.begin(context);
+    device.write_buffer(context, input, data.data(), N * sizeof(float));
+    device.write_buffer(context, results[0], zeros.data(), N * sizeof(float));
+    device.write_buffer(context, args, group_count, sizeof(group_count));
+
+    // The group counts are read on the GPU, only the first 2 groups run.
+    DispatchDesc indirect = add(results[0]);
+    indirect.indirect_buffer = args;
+    device.dispatch(context, indirect);
+
+    // Dispatches in mixed order, sorted and sharing the pipeline.
+    const DispatchDesc batch[] = {add(results[1]), add(results[2]), add(results[1])};
+    device.dispatch_batch(context, batch);
+
+    std::vector<float> result(N);
+    device.read_buffer(context, results[0], result.data(), N * sizeof(float));
+    device.submit(context);
+    device.wait(context);
+    CHECK_EQ(result[511], 2.f);
+    CHECK_EQ(result[512], 0.f);
+
+    for (BufferHandle buffer : {results[1], results[2]}) {
+        device.begin(context);
+        device.read_buffer(context, buffer, result.data(), N * sizeof(float));
+        device.submit(context);
+        device.wait(context);
+        CHECK_EQ(result[0], 2.f);
+        CHECK_EQ(result[N - 1], 2.f);
+    }
+
+    // A batch must not read what another of its dispatches writes.
+    DispatchDesc read_result = add(results[2]);
+    read_result.binding_set[0].resource = results[1];
+    const DispatchDesc conflict[] = {add(results[1]), read_result};
+    device.begin(context);
+    CHECK_THROWS(device.dispatch_batch(context, conflict));
+    device.submit(context);
+    device.wait(context);
+
+    device.destroy_context(context);
+    device.destroy_pipeline(pipeline);
+    device.destroy_shader(shader);
+    device.destroy_buffer(input);
+    for (BufferHandle buffer : results)
+        device.destroy_buffer(buffer);
+    device.destroy_buffer(args);
+}
+
+TEST_CASE_TEMPLATE("workgroup size", Backend, DEVICE_TEST_BACKENDS)
+{
+    static const uint32_t N = 1000;
+
+    Device device(test_device_desc<Backend>());
+
+    const BufferDesc buffer_desc{
+        .size = N * sizeof(float),
+        .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess | ResourceUsage::TransferSrc |
+                 ResourceUsage::TransferDst,
+    };
+    BufferHandle input = device.create_buffer(buffer_desc);
+    BufferHandle result = device.create_buffer(buffer_desc);
+
+    ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+    ShaderHandle shader = device.create_shader({.code = blob.data(), .code_size = blob.size_bytes()});
+    const PipelineDesc desc{
+        .shader = shader,
+        .binding_layout{
+            {.binding = 0, .type = DescriptorType::StructuredBuffer},
+            {.binding = 1, .type = DescriptorType::StructuredBuffer},
+            {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+        },
+        .push_constants_size = 4,
+    };
+
+    ContextHandle context = device.create_context();
+    std::vector<float> data(N, 1.f);
+    uint32_t push_constants = N;
+    {
+        PipelineVariants variants(device);
+
+        // The shader's numthreads(256, 1, 1) replaced by smaller and larger workgroups.
+        for (uint32_t size : {32u, 64u, 128u}) {
+            PipelineDesc variant_desc = desc;
+            variant_desc.workgroup_size = {size, 1, 1};
+            std::vector<float> zeros(N, 0.f);
+            std::vector<float> output(N);
+
+            device.begin(context);
+            device.write_buffer(context, input, data.data(), N * sizeof(float));
+            device.write_buffer(context, result, zeros.data(), N * sizeof(float));
+            device.dispatch(context, {
+                                         .pipeline = variants.get(variant_desc),
+                                         .binding_set{
+                                             {.binding = 0, .resource = input},
+                                             {.binding = 1, .resource = input},
+                                             {.binding = 2, .resource = result},
+                                         },
+                                         .push_constants = &push_constants,
+                                         .push_constants_size = sizeof(push_constants),
+                                         .group_count{(N + size - 1) / size, 1, 1},
+                                     });
+            device.read_buffer(context, result, output.data(), N * sizeof(float));
+            device.submit(context);
+            device.wait(context);
+            CHECK_EQ(output[0], 2.f);
+            CHECK_EQ(output[N - 1], 2.f);
+        }
+        CHECK_EQ(variants.size(), 3);
+    }
+
+    device.destroy_context(context);
+    device.destroy_shader(shader);
+    device.destroy_buffer(input);
+    device.destroy_buffer(result);
+}
+
+TEST_CASE("dispatch benchmark" * doctest::skip(true || FOTORITE_GITHUB_CI))
+{
+    static const size_t N = 1024;
+    static const int DISPATCH_COUNT = 2000;
+
+    Device device;
+
+    BufferHandle buffers[64];
+    for (BufferHandle &buffer : buffers) {
+        buffer = device.create_buffer({
+            .size = N * sizeof(float),
+            .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess,
+            .memory = MemoryType::Device,
+        });
+    }
+
+    ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+    ShaderHandle shader = device.create_shader({
+        .code = blob.data(),
+        .code_size = blob.size_bytes(),
+    });
+
+    PipelineHandle pipeline = device.create_pipeline({
+        .shader = shader,
+        .binding_layout{
+            {.binding = 0, .type = DescriptorType::StructuredBuffer},
+            {.binding = 1, .type = DescriptorType::StructuredBuffer},
+            {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+        },
+        .push_constants_size = 4,
+    });
+
+    ContextHandle context = device.create_context();
+
+    // Repeated binding sets hit the descriptor set cache, unique binding sets allocate and write a new set per
+    // dispatch (the cost of every dispatch without the cache). The first round of each warms up the context.
+    for (bool unique : {false, false, true, true}) {
+        Timer timer;
+        device.begin(context);
+        uint32_t push_constants = N;
+        for (int i = 0; i < DISPATCH_COUNT; ++i) {
+            int j = unique ? i : 0;
+            device.dispatch(context, {
+                                         .pipeline = pipeline,
+                                         .binding_set{
+                                             {.binding = 0, .resource = buffers[j % 64]},
+                                             {.binding = 1, .resource = buffers[(j / 64) % 64]},
+                                             {.binding = 2, .resource = buffers[63 - j % 64]},
+                                         },
+                                         .push_constants = &push_constants,
+                                         .push_constants_size = sizeof(push_constants),
+                                         .group_count{N / 256, 1, 1},
+                                     });
+        }
+        double record_time = timer.elapsed();
+        device.submit(context);
+        device.wait(context);
+
+        MESSAGE((unique ? "unique" : "repeated") << " binding sets: " << record_time / DISPATCH_COUNT * 1e6
+                                                 << "us per dispatch (CPU), " << DISPATCH_COUNT / record_time
+                                                 << " dispatches/s");
+    }
+
+    device.destroy_context(context);
+    device.destroy_pipeline(pipeline);
+    device.destroy_shader(shader);
+    for (BufferHandle buffer : buffers)
+        device.destroy_buffer(buffer);
+}
+
+TEST_CASE("pipeline cache benchmark" * doctest::skip(true || FOTORITE_GITHUB_CI))
+{
+    static const uint32_t PIPELINE_COUNT = 32;
+
+    std::filesystem::path cache_path = std::filesystem::temp_directory_path() / "fotorite_bench_pipeline_cache.bin";
+    std::filesystem::remove(cache_path);
+
+    ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+
+    // Cold: empty cache, serial and parallel compilation. Warm: cache loaded from disk.
+    for (const char *run : {"cold serial", "cold parallel", "warm parallel"}) {
+        bool parallel = std::strcmp(run, "cold serial") != 0;
+        if (std::strncmp(run, "cold", 4) == 0)
+            std::filesystem::remove(cache_path);
+
+        Timer timer;
+        Device device({.pipeline_cache_path = cache_path});
+        double device_time = timer.elapsed();
+
+        ShaderHandle shader = device.create_shader({
+            .code = blob.data(),
+            .code_size = blob.size_bytes(),
+        });
+        // Different push constant sizes give distinct pipelines.
+        std::vector<PipelineDesc> descs(PIPELINE_COUNT);
+        for (uint32_t i = 0; i < PIPELINE_COUNT; ++i) {
+            descs[i] = {
+                .shader = shader,
+                .binding_layout{
+                    {.binding = 0, .type = DescriptorType::StructuredBuffer},
+                    {.binding = 1, .type = DescriptorType::StructuredBuffer},
+                    {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+                },
+                .push_constants_size = 4 * (i + 1),
+            };
+        }
+
+        timer.reset();
+        std::vector<PipelineHandle> pipelines;
+        if (parallel) {
+            pipelines = device.create_pipelines(descs);
+        } else {
+            for (const PipelineDesc &desc : descs)
+                pipelines.push_back(device.create_pipeline(desc));
+        }
+        double compile_time = timer.elapsed();
+
+        MESSAGE(run << ": device " << device_time * 1e3 << "ms, " << PIPELINE_COUNT << " pipelines "
+                    << compile_time * 1e3 << "ms");
+
+        for (PipelineHandle pipeline : pipelines)
+            device.destroy_pipeline(pipeline);
+        device.destroy_shader(shader);
+    }
+
+    std::filesystem::remove(cache_path);
+}
+
+TEST_CASE("workgroup tuning benchmark" * doctest::skip(true || FOTORITE_GITHUB_CI))
+{
+    static const uint32_t N = 1 << 24;
+
+    Device device;
+
+    const BufferDesc buffer_desc{
+        .size = N * sizeof(float),
+        .usage = ResourceUsage::ShaderResource | ResourceUsage::UnorderedAccess,
+        .memory = MemoryType::Device,
+    };
+    BufferHandle buffers[3];
+    for (BufferHandle &buffer : buffers)
+        buffer = device.create_buffer(buffer_desc);
+
+    ShaderBlob blob = get_shader_blob(ShaderID::test_buffer_cs);
+    ShaderHandle shader = device.create_shader({.code = blob.data(), .code_size = blob.size_bytes()});
+    const PipelineDesc desc{
+        .shader = shader,
+        .binding_layout{
+            {.binding = 0, .type = DescriptorType::StructuredBuffer},
+            {.binding = 1, .type = DescriptorType::StructuredBuffer},
+            {.binding = 2, .type = DescriptorType::RWStructuredBuffer},
+        },
+        .push_constants_size = 4,
+    };
+
+    {
+        PipelineVariants variants(device);
+        WorkgroupTuner tuner(device, variants);
+
+        const WorkgroupSize candidates[] = {
+            {32, 1, 1}, {64, 1, 1}, {128, 1, 1}, {256, 1, 1}, {512, 1, 1}, {1024, 1, 1},
+        };
+        uint32_t push_constants = N;
+        auto record = [&](ContextHandle context, PipelineHandle pipeline, const WorkgroupSize &size) {
+            device.dispatch(context, {
+                                         .pipeline = pipeline,
+                                         .binding_set{
+                                             {.binding = 0, .resource = buffers[0]},
+                                             {.binding = 1, .resource = buffers[1]},
+                                             {.binding = 2, .resource = buffers[2]},
+                                         },
+                                         .push_constants = &push_constants,
+                                         .push_constants_size = sizeof(push_constants),
+                                         .group_count{N / size[0], 1, 1},
+                                     });
+        };
+        Timer timer;
+        const WorkgroupSize best = tuner.tune("test_buffer", desc, candidates, record);
+        MESSAGE("test_buffer: " << best[0] << " threads per workgroup, tuned in " << timer.elapsed() * 1e3 << "ms");
+    }
+
+    device.destroy_shader(shader);
+    for (BufferHandle buffer : buffers)
+        device.destroy_buffer(buffer);
+}
+
 TEST_SUITE_END();
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "device.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+FR_NAMESPACE_BEGIN
+
+// Image addressing shared by the Vulkan and CPU backends of Device.
+
+/// Size of a mip level in one dimension.
+inline uint32_t level_extent(uint32_t size, uint32_t level) { return std::max(size >> level, 1u); }
+
+/// Subresource range with zero counts resolved to the last level and layer of the image.
+inline ImageSubresourceRange resolve_subresource(const ImageDesc &desc, const ImageSubresourceRange &range)
+{
+    ImageSubresourceRange resolved = range;
+    if (resolved.mip_level_count == 0)
+        resolved.mip_level_count = desc.mip_levels - range.base_mip_level;
+    if (resolved.array_layer_count == 0)
+        resolved.array_layer_count = desc.array_layers - range.base_array_layer;
+    FR_ASSERT(resolved.base_mip_level + resolved.mip_level_count <= desc.mip_levels);
+    FR_ASSERT(resolved.base_array_layer + resolved.array_layer_count <= desc.array_layers);
+    return resolved;
+}
+
+/// Region with zero extents resolved to the edges of its mip level.
+inline ImageRegion resolve_region(const ImageDesc &desc, const ImageRegion &region)
+{
+    FR_ASSERT(region.mip_level < desc.mip_levels && region.array_layer < desc.array_layers);
+    const uint32_t width = level_extent(desc.width, region.mip_level);
+    const uint32_t height = level_extent(desc.height, region.mip_level);
+
+    ImageRegion resolved = region;
+    if (resolved.width == 0)
+        resolved.width = width - region.x;
+    if (resolved.height == 0)
+        resolved.height = height - region.y;
+
+    const ImageFormatInfo &info = get_image_format_info(desc.format);
+    FR_ASSERT(resolved.x + resolved.width <= width && resolved.y + resolved.height <= height);
+    // block-compressed regions must start on a block and end on a block or the level edge
+    FR_ASSERT(resolved.x % info.block_extent == 0 && resolved.y % info.block_extent == 0);
+    FR_ASSERT(resolved.width % info.block_extent == 0 || resolved.x + resolved.width == width);
+    FR_ASSERT(resolved.height % info.block_extent == 0 || resolved.y + resolved.height == height);
+    return resolved;
+}
+
+/// Copy rows between memory with different row pitches.
+inline void copy_rows(uint8_t *dst, size_t dst_row_pitch, const uint8_t *src, size_t src_row_pitch, size_t row_size,
+                      uint32_t row_count)
+{
+    if (dst_row_pitch == row_size && src_row_pitch == row_size) {
+        std::memcpy(dst, src, row_size * row_count);
+        return;
+    }
+    for (uint32_t row = 0; row < row_count; ++row)
+        std::memcpy(dst + row * dst_row_pitch, src + row * src_row_pitch, row_size);
+}
+
+FR_NAMESPACE_END
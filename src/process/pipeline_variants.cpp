@@ -0,0 +1,78 @@
+#include "pipeline_variants.h"
+
+#include <algorithm>
+#include <functional>
+
+FR_NAMESPACE_BEGIN
+
+inline void hash_combine(size_t &hash, size_t value) { hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2); }
+
+inline size_t hash_desc(const PipelineDesc &desc)
+{
+    size_t hash = std::hash<ShaderHandle>{}(desc.shader);
+    for (const BindingLayoutItem &item : desc.binding_layout) {
+        hash_combine(hash, item.binding);
+        hash_combine(hash, size_t(item.type));
+        hash_combine(hash, item.count);
+    }
+    hash_combine(hash, desc.push_constants_size);
+    hash_combine(hash, desc.bindless);
+    for (const SpecializationConstant &constant : desc.specialization_constants) {
+        hash_combine(hash, constant.id);
+        hash_combine(hash, constant.value);
+    }
+    for (uint32_t size : desc.workgroup_size)
+        hash_combine(hash, size);
+    return hash;
+}
+
+inline bool is_same_desc(const BindingLayoutItem &a, const BindingLayoutItem &b)
+{
+    return a.binding == b.binding && a.type == b.type && a.count == b.count;
+}
+
+inline bool is_same_desc(const PipelineDesc &a, const PipelineDesc &b)
+{
+    return a.shader == b.shader &&
+           std::equal(a.binding_layout.begin(), a.binding_layout.end(), b.binding_layout.begin(),
+                      b.binding_layout.end(),
+                      [](const auto &item_a, const auto &item_b) { return is_same_desc(item_a, item_b); }) &&
+           a.push_constants_size == b.push_constants_size && a.bindless == b.bindless &&
+           a.specialization_constants == b.specialization_constants && a.workgroup_size == b.workgroup_size;
+}
+
+PipelineVariants::PipelineVariants(Device &device) : m_device(device) {}
+
+PipelineVariants::~PipelineVariants() { clear(); }
+
+PipelineHandle PipelineVariants::get(const PipelineDesc &desc)
+{
+    const size_t hash = hash_desc(desc);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto [begin, end] = m_variants.equal_range(hash);
+    for (auto it = begin; it != end; ++it) {
+        if (is_same_desc(it->second.desc, desc))
+            return it->second.pipeline;
+    }
+
+    PipelineHandle pipeline = m_device.create_pipeline(desc);
+    m_variants.emplace(hash, Variant{desc, pipeline});
+    return pipeline;
+}
+
+size_t PipelineVariants::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_variants.size();
+}
+
+void PipelineVariants::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto &[hash, variant] : m_variants)
+        m_device.destroy_pipeline(variant.pipeline);
+    m_variants.clear();
+}
+
+FR_NAMESPACE_END
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "device.h"
+
+#include <mutex>
+#include <unordered_map>
+
+FR_NAMESPACE_BEGIN
+
+/**
+ * Cache of pipelines by description, e.g. the variants of a kernel with different specialization constants or
+ * workgroup sizes.
+ *
+ * A pipeline is created the first time its description is requested and shared by all later requests. The cache
+ * owns the pipelines and destroys them with it, they must not be used by pending submissions at that point.
+ * get() can be called from any thread, concurrent misses are created one after the other.
+ */
+class PipelineVariants {
+public:
+    explicit PipelineVariants(Device &device);
+    ~PipelineVariants();
+
+    /// Pipeline for a description, created on first use.
+    PipelineHandle get(const PipelineDesc &desc);
+
+    /// Number of cached pipelines.
+    size_t size() const;
+
+    /// Destroy all pipelines.
+    void clear();
+
+private:
+    PipelineVariants(const PipelineVariants &) = delete;
+    PipelineVariants &operator=(const PipelineVariants &) = delete;
+
+    struct Variant {
+        PipelineDesc desc;
+        PipelineHandle pipeline;
+    };
+
+    Device &m_device;
+    mutable std::mutex m_mutex;
+    std::unordered_multimap<size_t, Variant> m_variants;  ///< By hash of the description.
+};
+
+FR_NAMESPACE_END
@@ -0,0 +1,53 @@
+#include "process/pipeline_variants.h"
+#include "process/cpu_device.h"
+
+#include <doctest/doctest.h>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("process");
+
+TEST_CASE("pipeline variants")
+{
+    static const char kernel_code[] = "variants";
+    register_cpu_kernel(kernel_code, [](const CpuKernelArgs &args) {});
+
+    Device device({.backend = DeviceBackend::Cpu});
+    ShaderHandle shader = device.create_shader({.code = kernel_code, .code_size = sizeof(kernel_code)});
+    {
+        PipelineVariants variants(device);
+
+        PipelineDesc desc{
+            .shader = shader,
+            .binding_layout{{.binding = 0, .type = DescriptorType::RWStructuredBuffer}},
+        };
+        PipelineHandle pipeline = variants.get(desc);
+        CHECK_EQ(variants.get(desc), pipeline);
+
+        // every field selects a variant
+        desc.specialization_constants = {{.id = 0, .value = 1}};
+        PipelineHandle specialized = variants.get(desc);
+        CHECK_NE(specialized, pipeline);
+        desc.specialization_constants = {{.id = 0, .value = 2}};
+        CHECK_NE(variants.get(desc), specialized);
+        desc.workgroup_size = {64, 1, 1};
+        CHECK_NE(variants.get(desc), specialized);
+        desc.binding_layout[0].binding = 1;
+        CHECK_EQ(variants.size(), 4);
+        variants.get(desc);
+        CHECK_EQ(variants.size(), 5);
+
+        desc.binding_layout[0].binding = 0;
+        desc.specialization_constants = {{.id = 0, .value = 1}};
+        desc.workgroup_size = {};
+        CHECK_EQ(variants.get(desc), specialized);
+        CHECK_EQ(variants.size(), 5);
+
+        variants.clear();
+        CHECK_EQ(variants.size(), 0);
+        variants.get(desc);
+    }
+    device.destroy_shader(shader);
+}
+
+TEST_SUITE_END();
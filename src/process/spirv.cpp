@@ -0,0 +1,71 @@
+#include "spirv.h"
+
+#include <algorithm>
+
+FR_NAMESPACE_BEGIN
+
+static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+static constexpr uint32_t SPIRV_HEADER_SIZE = 5;
+
+static constexpr uint32_t OP_EXECUTION_MODE = 16;
+static constexpr uint32_t OP_DECORATE = 71;
+static constexpr uint32_t OP_EXECUTION_MODE_ID = 331;
+static constexpr uint32_t EXECUTION_MODE_LOCAL_SIZE = 17;
+static constexpr uint32_t EXECUTION_MODE_LOCAL_SIZE_ID = 38;
+static constexpr uint32_t DECORATION_BUILTIN = 11;
+static constexpr uint32_t BUILTIN_WORKGROUP_SIZE = 25;
+
+/// Call func(opcode, operands) for every instruction, stops early if it returns false.
+template <typename Word, typename Func>
+static bool for_each_instruction(std::span<Word> code, Func &&func)
+{
+    if (code.size() < SPIRV_HEADER_SIZE || code[0] != SPIRV_MAGIC)
+        return false;
+
+    for (size_t i = SPIRV_HEADER_SIZE; i < code.size();) {
+        const uint32_t word_count = code[i] >> 16;
+        const uint32_t opcode = code[i] & 0xffff;
+        if (word_count == 0 || i + word_count > code.size())
+            return false;
+        if (!func(opcode, code.subspan(i + 1, word_count - 1)))
+            return true;
+        i += word_count;
+    }
+    return true;
+}
+
+bool get_spirv_workgroup_size(std::span<const uint32_t> code, std::array<uint32_t, 3> &size)
+{
+    bool found = false;
+    for_each_instruction(code, [&](uint32_t opcode, std::span<const uint32_t> operands) {
+        // OpExecutionMode %entry_point LocalSize x y z
+        if (opcode == OP_EXECUTION_MODE && operands.size() == 5 && operands[1] == EXECUTION_MODE_LOCAL_SIZE) {
+            size = {operands[2], operands[3], operands[4]};
+            found = true;
+        }
+        return !found;
+    });
+    return found;
+}
+
+bool set_spirv_workgroup_size(std::span<uint32_t> code, const std::array<uint32_t, 3> &size)
+{
+    bool found = false;
+    bool overridden = false;
+    const bool valid = for_each_instruction(code, [&](uint32_t opcode, std::span<uint32_t> operands) {
+        if (opcode == OP_EXECUTION_MODE && operands.size() == 5 && operands[1] == EXECUTION_MODE_LOCAL_SIZE) {
+            std::copy(size.begin(), size.end(), operands.begin() + 2);
+            found = true;
+        } else if (opcode == OP_EXECUTION_MODE_ID && operands.size() >= 2 &&
+                   operands[1] == EXECUTION_MODE_LOCAL_SIZE_ID) {
+            overridden = true;
+        } else if (opcode == OP_DECORATE && operands.size() == 3 && operands[1] == DECORATION_BUILTIN &&
+                   operands[2] == BUILTIN_WORKGROUP_SIZE) {
+            overridden = true;
+        }
+        return true;
+    });
+    return valid && found && !overridden;
+}
+
+FR_NAMESPACE_END
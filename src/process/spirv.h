@@ -0,0 +1,26 @@
+#pragma once
+
+#include "core/defs.h"
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+FR_NAMESPACE_BEGIN
+
+/**
+ * Read the workgroup size declared by the LocalSize execution mode of a SPIR-V module.
+ * @return False if the code is not SPIR-V or declares no LocalSize.
+ */
+bool get_spirv_workgroup_size(std::span<const uint32_t> code, std::array<uint32_t, 3> &size);
+
+/**
+ * Replace the workgroup size of a SPIR-V module in place.
+ *
+ * HLSL numthreads cannot use specialization constants, so pipelines with another workgroup size are created from a
+ * patched copy of the module.
+ * @return False if the code declares no LocalSize or overrides it (LocalSizeId, WorkgroupSize built-in).
+ */
+bool set_spirv_workgroup_size(std::span<uint32_t> code, const std::array<uint32_t, 3> &size);
+
+FR_NAMESPACE_END
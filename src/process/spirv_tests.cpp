@@ -0,0 +1,42 @@
+#include "process/spirv.h"
+#include "shaders/shaders.h"
+
+#include <cstring>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("process");
+
+static std::vector<uint32_t> load_code(ShaderID shader_id)
+{
+    ShaderBlob blob = get_shader_blob(shader_id);
+    std::vector<uint32_t> code(blob.size() / sizeof(uint32_t));
+    std::memcpy(code.data(), blob.data(), code.size() * sizeof(uint32_t));
+    return code;
+}
+
+TEST_CASE("spirv workgroup size")
+{
+    std::array<uint32_t, 3> size{};
+    std::vector<uint32_t> code = load_code(ShaderID::test_buffer_cs);
+    CHECK(get_spirv_workgroup_size(code, size));
+    CHECK_EQ(size, (std::array<uint32_t, 3>{256, 1, 1}));
+
+    CHECK(set_spirv_workgroup_size(code, {64, 2, 1}));
+    CHECK(get_spirv_workgroup_size(code, size));
+    CHECK_EQ(size, (std::array<uint32_t, 3>{64, 2, 1}));
+
+    code = load_code(ShaderID::test_image_cs);
+    CHECK(get_spirv_workgroup_size(code, size));
+    CHECK_EQ(size, (std::array<uint32_t, 3>{32, 32, 1}));
+
+    // not SPIR-V
+    code[0] = 0;
+    CHECK_FALSE(get_spirv_workgroup_size(code, size));
+    CHECK_FALSE(set_spirv_workgroup_size(code, {64, 1, 1}));
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,139 @@
+#include "workgroup_tuner.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+FR_NAMESPACE_BEGIN
+
+WorkgroupTuner::WorkgroupTuner(Device &device, PipelineVariants &variants) : m_device(device), m_variants(variants) {}
+
+WorkgroupSize WorkgroupTuner::tune(const std::string &kernel, const PipelineDesc &desc,
+                                   std::span<const WorkgroupSize> candidates, const RecordFunc &record,
+                                   uint32_t iterations)
+{
+    FR_ASSERT(iterations > 0);
+
+    const uint32_t max_invocations = m_device.max_workgroup_invocations();
+    std::vector<WorkgroupSize> sizes;
+    std::vector<PipelineHandle> pipelines;
+    for (const WorkgroupSize &size : candidates) {
+        const uint64_t invocations = uint64_t(size[0]) * size[1] * size[2];
+        if (invocations == 0 || invocations > max_invocations)
+            continue;
+        PipelineDesc candidate_desc = desc;
+        candidate_desc.workgroup_size = size;
+        sizes.push_back(size);
+        pipelines.push_back(m_variants.get(candidate_desc));
+    }
+    FR_ASSERT(!sizes.empty());
+
+    ContextHandle context = m_device.create_context({.queue = QueueType::Compute, .enable_timestamps = true});
+
+    // round 0 warms up caches and clocks and is not timed
+    std::vector<std::vector<double>> times(sizes.size());
+    for (uint32_t round = 0; round <= iterations; ++round) {
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            m_device.begin(context);
+            m_device.begin_scope(context, kernel);
+            record(context, pipelines[i], sizes[i]);
+            m_device.end_scope(context);
+            m_device.submit(context);
+            m_device.wait(context);
+            const double cpu_ms =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            // GPU time of the outer scope, CPU time of the submission if timestamps are not supported
+            double ms = cpu_ms;
+            for (const GpuTiming &timing : m_device.take_timings(context)) {
+                if (timing.depth == 0) {
+                    ms = timing.duration_ms;
+                    break;
+                }
+            }
+            if (round > 0)
+                times[i].push_back(ms);
+        }
+    }
+
+    m_device.destroy_context(context);
+
+    size_t best = 0;
+    double best_ms = 0.0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        auto median = times[i].begin() + times[i].size() / 2;
+        std::nth_element(times[i].begin(), median, times[i].end());
+        if (i == 0 || *median < best_ms) {
+            best = i;
+            best_ms = *median;
+        }
+    }
+
+    m_best[kernel] = sizes[best];
+    return sizes[best];
+}
+
+std::optional<WorkgroupSize> WorkgroupTuner::best(const std::string &kernel) const
+{
+    auto it = m_best.find(kernel);
+    if (it == m_best.end())
+        return std::nullopt;
+    return it->second;
+}
+
+PipelineHandle WorkgroupTuner::pipeline(const std::string &kernel, const PipelineDesc &desc)
+{
+    auto it = m_best.find(kernel);
+    if (it == m_best.end())
+        return m_variants.get(desc);
+
+    PipelineDesc tuned_desc = desc;
+    tuned_desc.workgroup_size = it->second;
+    return m_variants.get(tuned_desc);
+}
+
+bool WorkgroupTuner::load(const std::filesystem::path &path)
+{
+    std::ifstream ifs(path);
+    if (!ifs.good())
+        return false;
+
+    // {"kernel": [x, y, z], ...}, nothing is added unless every entry is valid
+    auto j = nlohmann::json::parse(ifs, nullptr, false);
+    if (!j.is_object())
+        return false;
+    std::map<std::string, WorkgroupSize> loaded;
+    for (const auto &[kernel, size] : j.items()) {
+        if (!size.is_array() || size.size() != 3)
+            return false;
+        WorkgroupSize &loaded_size = loaded[kernel];
+        for (size_t i = 0; i < 3; ++i) {
+            if (!size[i].is_number_unsigned() || size[i].get<uint64_t>() == 0 || size[i].get<uint64_t>() > UINT32_MAX)
+                return false;
+            loaded_size[i] = size[i].get<uint32_t>();
+        }
+    }
+    for (auto &[kernel, size] : loaded)
+        m_best[kernel] = size;
+    return true;
+}
+
+bool WorkgroupTuner::save(const std::filesystem::path &path) const
+{
+    std::ofstream ofs(path);
+    if (!ofs.good())
+        return false;
+
+    nlohmann::json j = nlohmann::json::object();
+    for (const auto &[kernel, size] : m_best)
+        j[kernel] = size;
+    ofs << j.dump(4);
+    return true;
+}
+
+FR_NAMESPACE_END
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pipeline_variants.h"
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+
+FR_NAMESPACE_BEGIN
+
+/**
+ * Finds the fastest workgroup size of compute kernels on the running device.
+ *
+ * tune() creates a pipeline variant per candidate size (PipelineDesc::workgroup_size) and times the kernel with each
+ * of them in a timestamp scope, falling back to CPU time if the queue has no timestamps. Candidates are interleaved
+ * over the iterations after a warm-up round, and the one with the lowest median time is remembered for the kernel
+ * name. The results only hold for the device they were measured on, so saved files should be kept per device.
+ * Not thread-safe.
+ */
+class WorkgroupTuner {
+public:
+    /**
+     * Record one execution of the kernel with a pipeline of the given workgroup size, the group count has to be
+     * derived from the size. Called between Device::begin() and submit() of the tuning context.
+     */
+    using RecordFunc = std::function<void(ContextHandle context, PipelineHandle pipeline, const WorkgroupSize &size)>;
+
+    WorkgroupTuner(Device &device, PipelineVariants &variants);
+
+    /**
+     * Time a kernel with every candidate workgroup size and remember the fastest.
+     * Candidates exceeding Device::max_workgroup_invocations() are skipped. Pipelines of all candidates stay in the
+     * variant cache.
+     * @param kernel Name the result is remembered by.
+     * @param desc Pipeline of the kernel, its workgroup size is replaced by the candidates.
+     * @param iterations Number of timed executions per candidate.
+     * @return The fastest workgroup size.
+     */
+    WorkgroupSize tune(const std::string &kernel, const PipelineDesc &desc, std::span<const WorkgroupSize> candidates,
+                       const RecordFunc &record, uint32_t iterations = 5);
+
+    /// Tuned workgroup size of a kernel.
+    std::optional<WorkgroupSize> best(const std::string &kernel) const;
+
+    /// Pipeline of a kernel with its tuned workgroup size, or with desc.workgroup_size if it was not tuned.
+    PipelineHandle pipeline(const std::string &kernel, const PipelineDesc &desc);
+
+    /// Add the results of a file written by save(), replacing results of the same kernels. Adds nothing if the file
+    /// is invalid.
+    bool load(const std::filesystem::path &path);
+    bool save(const std::filesystem::path &path) const;
+
+private:
+    Device &m_device;
+    PipelineVariants &m_variants;
+    std::map<std::string, WorkgroupSize> m_best;
+};
+
+FR_NAMESPACE_END
@@ -0,0 +1,71 @@
+#include "process/workgroup_tuner.h"
+#include "process/cpu_device.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include <doctest/doctest.h>
+
+using namespace fr;
+
+TEST_SUITE_BEGIN("process");
+
+TEST_CASE("workgroup tuner")
+{
+    // Kernel that is only fast with 64x2 workgroups.
+    static const char kernel_code[] = "tuned";
+    register_cpu_kernel(kernel_code, [](const CpuKernelArgs &args) {
+        if (args.workgroup_size != WorkgroupSize{64, 2, 1})
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    });
+
+    Device device({.backend = DeviceBackend::Cpu});
+    ShaderHandle shader = device.create_shader({.code = kernel_code, .code_size = sizeof(kernel_code)});
+    const PipelineDesc desc{.shader = shader};
+    {
+        PipelineVariants variants(device);
+        WorkgroupTuner tuner(device, variants);
+        CHECK_FALSE(tuner.best("tuned"));
+        CHECK_EQ(tuner.pipeline("tuned", desc), variants.get(desc));
+
+        // the last candidate exceeds max_workgroup_invocations() and is skipped
+        const WorkgroupSize candidates[] = {{256, 1, 1}, {64, 2, 1}, {16, 16, 1}, {2048, 1, 1}};
+        uint32_t record_count = 0;
+        const WorkgroupSize best =
+            tuner.tune("tuned", desc, candidates,
+                       [&](ContextHandle context, PipelineHandle pipeline, const WorkgroupSize &size) {
+                           device.dispatch(context, {.pipeline = pipeline, .group_count{4, 1, 1}});
+                           ++record_count;
+                       },
+                       3);
+        CHECK_EQ(best, (WorkgroupSize{64, 2, 1}));
+        CHECK_EQ(tuner.best("tuned"), best);
+        CHECK_EQ(record_count, 3 * (3 + 1));
+        CHECK_EQ(variants.size(), 4);
+        CHECK_EQ(tuner.pipeline("tuned", desc), variants.get({.shader = shader, .workgroup_size = best}));
+
+        const std::filesystem::path path = std::filesystem::temp_directory_path() / "fotorite_workgroup_tuner.json";
+        CHECK(tuner.save(path));
+        WorkgroupTuner loaded(device, variants);
+        CHECK(loaded.load(path));
+        CHECK_EQ(loaded.best("tuned"), best);
+
+        // invalid entries reject the whole file without changing the loaded results
+        for (const char *json : {R"({"other": [8, 8, 1], "tuned": [1.5, 1, 1]})", R"({"tuned": [-1, 1, 1]})",
+                                 R"({"tuned": [0, 1, 1]})", R"({"tuned": [4294967296, 1, 1]})",
+                                 R"({"tuned": ["64", 1, 1]})"}) {
+            std::ofstream(path) << json;
+            CHECK_FALSE(loaded.load(path));
+            CHECK_EQ(loaded.best("tuned"), best);
+            CHECK_FALSE(loaded.best("other"));
+        }
+
+        std::filesystem::remove(path);
+        CHECK_FALSE(loaded.load(path));
+    }
+    device.destroy_shader(shader);
+}
+
+TEST_SUITE_END();